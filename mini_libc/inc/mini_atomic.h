@@ -0,0 +1,457 @@
+/**
+ * mini_atomic.h - aarch64原子操作
+ *
+ * 提供8/16/32/64/128位的load/store/exchange/CAS以及fetch_add/or/and，
+ * 每个操作都带显式内存序参数MINI_ATOMIC_*。
+ *
+ * ARMv8.1的LSE指令(CAS/SWP/LDADD/LDSET/LDCLR/CASP)在一条指令内完成读-改-写，
+ * 可以由互连直接在缓存所在处执行，多核竞争同一缓存行时比LL/SC循环扩展性好得多；
+ * LDXR/STXR循环在竞争下会反复失败重试。启动时根据AT_HWCAP的HWCAP_ATOMICS位
+ * 选择LSE或LL/SC，用-march=armv8.1-a及以上编译时(__ARM_FEATURE_ATOMICS)
+ * 直接使用LSE，不再判断。
+ *
+ * mini_atomic_wait_32/64用WFE等待值变化，供自旋锁代替忙等加yield。
+ *
+ * 对象大小为1/2/4/8字节时可以使用不带位宽后缀的泛型宏，如
+ * mini_atomic_load(&x, MINI_ATOMIC_ACQUIRE)；128位只有带_128后缀的函数。
+ */
+
+#ifndef _MINI_ATOMIC_H_
+#define _MINI_ATOMIC_H_
+
+#include "mini_lib.h"
+
+/* 内存序 */
+#define MINI_ATOMIC_RELAXED 0
+#define MINI_ATOMIC_ACQUIRE 1
+#define MINI_ATOMIC_RELEASE 2
+#define MINI_ATOMIC_ACQ_REL 3
+#define MINI_ATOMIC_SEQ_CST 4
+
+typedef unsigned __int128 mini_uint128_t;
+
+#ifdef __ARM_FEATURE_ATOMICS
+#define __MINI_HAVE_LSE 1
+#else
+/* 由__mini_libc_init根据AT_HWCAP设置 */
+extern int __mini_atomic_lse;
+#define __MINI_HAVE_LSE __mini_atomic_lse
+#endif
+
+/*
+ * 按内存序展开M(o, a, l, ...)：
+ * o为LSE指令的序后缀(a/l/al)，a、l分别是LL/SC加载(ldaxr)和存储(stlxr)的序后缀。
+ * ACQ_REL和SEQ_CST都用acquire+release，aarch64上这已经是顺序一致的。
+ */
+#define __MINI_ATOMIC_ORDERED(order, M, ...) \
+    switch (order) \
+    { \
+    case MINI_ATOMIC_RELAXED: M("",   "",  "",  __VA_ARGS__); break; \
+    case MINI_ATOMIC_ACQUIRE: M("a",  "a", "",  __VA_ARGS__); break; \
+    case MINI_ATOMIC_RELEASE: M("l",  "",  "l", __VA_ARGS__); break; \
+    default:                  M("al", "a", "l", __VA_ARGS__); break; \
+    }
+
+/* LSE读-改-写，ins为ldadd/ldset/ldclr/swp，old得到原值 */
+#define __MINI_LSE_RMW(o, a, l, ins, sz, r, p, v, old) \
+    asm volatile(".arch_extension lse\n\t" \
+                 ins o sz " %" r "2, %" r "0, %1" \
+                 : "=r"(old), "+Q"(*(p)) \
+                 : "r"(v) \
+                 : "memory")
+
+/* LL/SC读-改-写，op为add/orr/and */
+#define __MINI_LLSC_RMW(o, a, l, op, sz, r, p, v, old) \
+    do \
+    { \
+        unsigned long __tmp; \
+        unsigned int __fail; \
+        asm volatile("1: ld" a "xr" sz " %" r "0, %3\n\t" \
+                     op " %" r "1, %" r "0, %" r "4\n\t" \
+                     "st" l "xr" sz " %w2, %" r "1, %3\n\t" \
+                     "cbnz %w2, 1b" \
+                     : "=&r"(old), "=&r"(__tmp), "=&r"(__fail), "+Q"(*(p)) \
+                     : "r"(v) \
+                     : "memory"); \
+    } while (0)
+
+/* LL/SC交换 */
+#define __MINI_LLSC_SWP(o, a, l, sz, r, p, v, old) \
+    do \
+    { \
+        unsigned int __fail; \
+        asm volatile("1: ld" a "xr" sz " %" r "0, %2\n\t" \
+                     "st" l "xr" sz " %w1, %" r "3, %2\n\t" \
+                     "cbnz %w1, 1b" \
+                     : "=&r"(old), "=&r"(__fail), "+Q"(*(p)) \
+                     : "r"(v) \
+                     : "memory"); \
+    } while (0)
+
+/* LSE比较交换，cmp传入期望值，返回时为内存中的原值 */
+#define __MINI_LSE_CAS(o, a, l, sz, r, p, cmp, des) \
+    asm volatile(".arch_extension lse\n\t" \
+                 "cas" o sz " %" r "0, %" r "2, %1" \
+                 : "+r"(cmp), "+Q"(*(p)) \
+                 : "r"(des) \
+                 : "memory")
+
+/* LL/SC比较交换，语义同上 */
+#define __MINI_LLSC_CAS(o, a, l, sz, r, p, cmp, des) \
+    do \
+    { \
+        unsigned long __old; \
+        unsigned int __fail; \
+        asm volatile("1: ld" a "xr" sz " %" r "0, %2\n\t" \
+                     "cmp %" r "0, %" r "3\n\t" \
+                     "b.ne 2f\n\t" \
+                     "st" l "xr" sz " %w1, %" r "4, %2\n\t" \
+                     "cbnz %w1, 1b\n" \
+                     "2:" \
+                     : "=&r"(__old), "=&r"(__fail), "+Q"(*(p)) \
+                     : "r"(cmp), "r"(des) \
+                     : "memory", "cc"); \
+        cmp = __old; \
+    } while (0)
+
+/*
+ * LSE 128位比较交换，CASP要求两对寄存器都从偶数号开始，固定使用x0-x3
+ */
+#define __MINI_LSE_CASP(o, a, l, p, elo, ehi, dlo, dhi, olo, ohi) \
+    do \
+    { \
+        register uint64_t __x0 asm("x0") = elo; \
+        register uint64_t __x1 asm("x1") = ehi; \
+        register uint64_t __x2 asm("x2") = dlo; \
+        register uint64_t __x3 asm("x3") = dhi; \
+        asm volatile(".arch_extension lse\n\t" \
+                     "casp" o " %0, %1, %3, %4, %2" \
+                     : "+r"(__x0), "+r"(__x1), "+Q"(*(p)) \
+                     : "r"(__x2), "r"(__x3) \
+                     : "memory"); \
+        olo = __x0; \
+        ohi = __x1; \
+    } while (0)
+
+/*
+ * LL/SC 128位比较交换
+ *
+ * LDXP本身不保证两个64位一起原子地读出，比较失败时也要把读到的值STXP写回，
+ * 写回成功才说明读到的是一个完整的值。
+ */
+#define __MINI_LLSC_CASP(o, a, l, p, elo, ehi, dlo, dhi, olo, ohi) \
+    do \
+    { \
+        unsigned int __fail; \
+        asm volatile("1: ld" a "xp %0, %1, %3\n\t" \
+                     "cmp %0, %4\n\t" \
+                     "ccmp %1, %5, #0, eq\n\t" \
+                     "b.ne 2f\n\t" \
+                     "st" l "xp %w2, %6, %7, %3\n\t" \
+                     "cbnz %w2, 1b\n\t" \
+                     "b 3f\n" \
+                     "2: st" l "xp %w2, %0, %1, %3\n\t" \
+                     "cbnz %w2, 1b\n" \
+                     "3:" \
+                     : "=&r"(olo), "=&r"(ohi), "=&r"(__fail), "+Q"(*(p)) \
+                     : "r"(elo), "r"(ehi), "r"(dlo), "r"(dhi) \
+                     : "memory", "cc"); \
+    } while (0)
+
+/*
+ * 生成一种位宽的全部操作
+ * bits: 位宽后缀，T: 对象类型，R: 寄存器中的类型(不足32位按32位处理)
+ * sz: 指令的宽度后缀(b/h/空)，r: 寄存器前缀(w/x)
+ */
+#define __MINI_ATOMIC_DEFINE(bits, T, R, sz, r) \
+static inline T mini_atomic_load_##bits(const volatile T *p, int order) \
+{ \
+    R v; \
+    if (order == MINI_ATOMIC_RELAXED) \
+    { \
+        return *p; \
+    } \
+    asm volatile("ldar" sz " %" r "0, %1" : "=r"(v) : "Q"(*p) : "memory"); \
+    return (T)v; \
+} \
+\
+static inline void mini_atomic_store_##bits(volatile T *p, T v, int order) \
+{ \
+    if (order == MINI_ATOMIC_RELAXED) \
+    { \
+        *p = v; \
+        return; \
+    } \
+    asm volatile("stlr" sz " %" r "1, %0" : "=Q"(*p) : "r"((R)v) : "memory"); \
+} \
+\
+static inline T mini_atomic_exchange_##bits(volatile T *p, T v, int order) \
+{ \
+    R val = (R)v; \
+    R old; \
+    if (__MINI_HAVE_LSE) \
+    { \
+        __MINI_ATOMIC_ORDERED(order, __MINI_LSE_RMW, "swp", sz, r, p, val, old) \
+    } \
+    else \
+    { \
+        __MINI_ATOMIC_ORDERED(order, __MINI_LLSC_SWP, sz, r, p, val, old) \
+    } \
+    return (T)old; \
+} \
+\
+static inline int mini_atomic_cas_##bits(volatile T *p, T *expected, T desired, int order) \
+{ \
+    R cmp = (R)*expected; \
+    R des = (R)desired; \
+    if (__MINI_HAVE_LSE) \
+    { \
+        __MINI_ATOMIC_ORDERED(order, __MINI_LSE_CAS, sz, r, p, cmp, des) \
+    } \
+    else \
+    { \
+        __MINI_ATOMIC_ORDERED(order, __MINI_LLSC_CAS, sz, r, p, cmp, des) \
+    } \
+    if (cmp == (R)*expected) \
+    { \
+        return 1; \
+    } \
+    *expected = (T)cmp; \
+    return 0; \
+} \
+\
+static inline T mini_atomic_fetch_add_##bits(volatile T *p, T v, int order) \
+{ \
+    R val = (R)v; \
+    R old; \
+    if (__MINI_HAVE_LSE) \
+    { \
+        __MINI_ATOMIC_ORDERED(order, __MINI_LSE_RMW, "ldadd", sz, r, p, val, old) \
+    } \
+    else \
+    { \
+        __MINI_ATOMIC_ORDERED(order, __MINI_LLSC_RMW, "add", sz, r, p, val, old) \
+    } \
+    return (T)old; \
+} \
+\
+static inline T mini_atomic_fetch_or_##bits(volatile T *p, T v, int order) \
+{ \
+    R val = (R)v; \
+    R old; \
+    if (__MINI_HAVE_LSE) \
+    { \
+        __MINI_ATOMIC_ORDERED(order, __MINI_LSE_RMW, "ldset", sz, r, p, val, old) \
+    } \
+    else \
+    { \
+        __MINI_ATOMIC_ORDERED(order, __MINI_LLSC_RMW, "orr", sz, r, p, val, old) \
+    } \
+    return (T)old; \
+} \
+\
+static inline T mini_atomic_fetch_and_##bits(volatile T *p, T v, int order) \
+{ \
+    R val = (R)v; \
+    R clr = ~val; \
+    R old; \
+    if (__MINI_HAVE_LSE) \
+    { \
+        /* LSE没有按位与，用清除~v中置位的位(ldclr)实现 */ \
+        __MINI_ATOMIC_ORDERED(order, __MINI_LSE_RMW, "ldclr", sz, r, p, clr, old) \
+    } \
+    else \
+    { \
+        __MINI_ATOMIC_ORDERED(order, __MINI_LLSC_RMW, "and", sz, r, p, val, old) \
+    } \
+    return (T)old; \
+}
+
+__MINI_ATOMIC_DEFINE(8,  uint8_t,  uint32_t, "b", "w")
+__MINI_ATOMIC_DEFINE(16, uint16_t, uint32_t, "h", "w")
+__MINI_ATOMIC_DEFINE(32, uint32_t, uint32_t, "",  "w")
+__MINI_ATOMIC_DEFINE(64, uint64_t, uint64_t, "",  "x")
+
+/**
+ * 128位比较交换，对象必须16字节对齐
+ *
+ * @param expected: 期望值，失败时写回内存中的当前值
+ * @return: 成功返回1，失败返回0
+ */
+static inline int mini_atomic_cas_128(volatile mini_uint128_t *p, mini_uint128_t *expected,
+                                      mini_uint128_t desired, int order)
+{
+    uint64_t elo = (uint64_t)*expected;
+    uint64_t ehi = (uint64_t)(*expected >> 64);
+    uint64_t dlo = (uint64_t)desired;
+    uint64_t dhi = (uint64_t)(desired >> 64);
+    uint64_t olo, ohi;
+
+    if (__MINI_HAVE_LSE)
+    {
+        __MINI_ATOMIC_ORDERED(order, __MINI_LSE_CASP, p, elo, ehi, dlo, dhi, olo, ohi)
+    }
+    else
+    {
+        __MINI_ATOMIC_ORDERED(order, __MINI_LLSC_CASP, p, elo, ehi, dlo, dhi, olo, ohi)
+    }
+    if (olo == elo && ohi == ehi)
+    {
+        return 1;
+    }
+    *expected = ((mini_uint128_t)ohi << 64) | olo;
+    return 0;
+}
+
+/**
+ * 128位读取，通过比较交换实现，所以对象必须可写
+ */
+static inline mini_uint128_t mini_atomic_load_128(volatile mini_uint128_t *p, int order)
+{
+    mini_uint128_t v = 0;
+
+    mini_atomic_cas_128(p, &v, 0, order);
+    return v;
+}
+
+static inline mini_uint128_t mini_atomic_exchange_128(volatile mini_uint128_t *p, mini_uint128_t v, int order)
+{
+    mini_uint128_t old = mini_atomic_load_128(p, MINI_ATOMIC_RELAXED);
+
+    while (!mini_atomic_cas_128(p, &old, v, order))
+    {
+    }
+    return old;
+}
+
+static inline void mini_atomic_store_128(volatile mini_uint128_t *p, mini_uint128_t v, int order)
+{
+    mini_atomic_exchange_128(p, v, order);
+}
+
+static inline mini_uint128_t mini_atomic_fetch_add_128(volatile mini_uint128_t *p, mini_uint128_t v, int order)
+{
+    mini_uint128_t old = mini_atomic_load_128(p, MINI_ATOMIC_RELAXED);
+
+    while (!mini_atomic_cas_128(p, &old, old + v, order))
+    {
+    }
+    return old;
+}
+
+static inline mini_uint128_t mini_atomic_fetch_or_128(volatile mini_uint128_t *p, mini_uint128_t v, int order)
+{
+    mini_uint128_t old = mini_atomic_load_128(p, MINI_ATOMIC_RELAXED);
+
+    while (!mini_atomic_cas_128(p, &old, old | v, order))
+    {
+    }
+    return old;
+}
+
+static inline mini_uint128_t mini_atomic_fetch_and_128(volatile mini_uint128_t *p, mini_uint128_t v, int order)
+{
+    mini_uint128_t old = mini_atomic_load_128(p, MINI_ATOMIC_RELAXED);
+
+    while (!mini_atomic_cas_128(p, &old, old & v, order))
+    {
+    }
+    return old;
+}
+
+/**
+ * 内存屏障，ACQUIRE只需要排序之前的读
+ */
+static inline void mini_atomic_fence(int order)
+{
+    if (order == MINI_ATOMIC_ACQUIRE)
+    {
+        asm volatile("dmb ishld" : : : "memory");
+    }
+    else if (order != MINI_ATOMIC_RELAXED)
+    {
+        asm volatile("dmb ish" : : : "memory");
+    }
+}
+
+/*
+ * 等待*p不再等于old，返回新值(acquire)
+ *
+ * 用于自旋等待，代替反复读加yield：LDAXR在缓存行上设置独占监视器后WFE让核心休眠，
+ * 其他核心写这一缓存行会清除监视器并产生唤醒事件，所以写入方不需要SEV。
+ * 开头的SEVL让第一次WFE立即返回，之后才真正读值。
+ * 内核开启的事件流(通常100us)保证即使错过事件也会定期醒来。
+ */
+#define __MINI_ATOMIC_WAIT_DEFINE(bits, T, r) \
+static inline T mini_atomic_wait_##bits(const volatile T *p, T old) \
+{ \
+    T v; \
+    asm volatile("sevl\n" \
+                 "1:  wfe\n" \
+                 "    ldaxr %" r "0, %1\n" \
+                 "    cmp %" r "0, %" r "2\n" \
+                 "    b.eq 1b\n" \
+                 : "=&r"(v) : "Q"(*p), "r"(old) : "memory", "cc"); \
+    return v; \
+}
+
+__MINI_ATOMIC_WAIT_DEFINE(32, uint32_t, "w")
+__MINI_ATOMIC_WAIT_DEFINE(64, uint64_t, "x")
+
+/*
+ * 泛型接口，按*p的大小(1/2/4/8字节)选择对应位宽的实现
+ * 参数先显式转换为对应位宽，未被选中的分支不会产生截断警告
+ */
+#define mini_atomic_load(p, order) __extension__ ({ \
+    __typeof__(*(p)) __ret; \
+    switch (sizeof(*(p))) \
+    { \
+    case 1: __ret = (__typeof__(*(p)))mini_atomic_load_8((volatile uint8_t *)(p), order); break; \
+    case 2: __ret = (__typeof__(*(p)))mini_atomic_load_16((volatile uint16_t *)(p), order); break; \
+    case 4: __ret = (__typeof__(*(p)))mini_atomic_load_32((volatile uint32_t *)(p), order); break; \
+    default: __ret = (__typeof__(*(p)))mini_atomic_load_64((volatile uint64_t *)(p), order); break; \
+    } \
+    __ret; })
+
+#define __MINI_ATOMIC_RMW(p, call, v, order) __extension__ ({ \
+    __typeof__(*(p)) __ret; \
+    switch (sizeof(*(p))) \
+    { \
+    case 1: __ret = (__typeof__(*(p)))call##_8((volatile uint8_t *)(p), (uint8_t)(v), order); break; \
+    case 2: __ret = (__typeof__(*(p)))call##_16((volatile uint16_t *)(p), (uint16_t)(v), order); break; \
+    case 4: __ret = (__typeof__(*(p)))call##_32((volatile uint32_t *)(p), (uint32_t)(v), order); break; \
+    default: __ret = (__typeof__(*(p)))call##_64((volatile uint64_t *)(p), (uint64_t)(v), order); break; \
+    } \
+    __ret; })
+
+#define mini_atomic_exchange(p, v, order)   __MINI_ATOMIC_RMW(p, mini_atomic_exchange, v, order)
+#define mini_atomic_fetch_add(p, v, order)  __MINI_ATOMIC_RMW(p, mini_atomic_fetch_add, v, order)
+#define mini_atomic_fetch_sub(p, v, order)  __MINI_ATOMIC_RMW(p, mini_atomic_fetch_add, -(v), order)
+#define mini_atomic_fetch_or(p, v, order)   __MINI_ATOMIC_RMW(p, mini_atomic_fetch_or, v, order)
+#define mini_atomic_fetch_and(p, v, order)  __MINI_ATOMIC_RMW(p, mini_atomic_fetch_and, v, order)
+
+#define mini_atomic_store(p, v, order) \
+    do \
+    { \
+        switch (sizeof(*(p))) \
+        { \
+        case 1: mini_atomic_store_8((volatile uint8_t *)(p), (uint8_t)(v), order); break; \
+        case 2: mini_atomic_store_16((volatile uint16_t *)(p), (uint16_t)(v), order); break; \
+        case 4: mini_atomic_store_32((volatile uint32_t *)(p), (uint32_t)(v), order); break; \
+        default: mini_atomic_store_64((volatile uint64_t *)(p), (uint64_t)(v), order); break; \
+        } \
+    } while (0)
+
+/* expected指向与*p同类型的期望值，失败时写回当前值 */
+#define mini_atomic_cas(p, expected, desired, order) __extension__ ({ \
+    int __ok; \
+    switch (sizeof(*(p))) \
+    { \
+    case 1: __ok = mini_atomic_cas_8((volatile uint8_t *)(p), (uint8_t *)(expected), (uint8_t)(desired), order); break; \
+    case 2: __ok = mini_atomic_cas_16((volatile uint16_t *)(p), (uint16_t *)(expected), (uint16_t)(desired), order); break; \
+    case 4: __ok = mini_atomic_cas_32((volatile uint32_t *)(p), (uint32_t *)(expected), (uint32_t)(desired), order); break; \
+    default: __ok = mini_atomic_cas_64((volatile uint64_t *)(p), (uint64_t *)(expected), (uint64_t)(desired), order); break; \
+    } \
+    __ok; })
+
+#endif
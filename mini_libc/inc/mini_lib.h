@@ -2,12 +2,35 @@
 #define _MINI_LIB_H_
 
 #define AT_FDCWD		-100
+#define AT_SYMLINK_NOFOLLOW 0x100
 #define O_RDONLY 00000000
 #define O_WRONLY 00000001
 #define O_RDWR 00000002
 #define O_CREAT 00000100
 #define O_TRUNC 00001000
 #define O_APPEND 00002000
+#define O_NONBLOCK 00004000
+#define O_DSYNC 00010000        /* 每次写入等数据落盘后返回 */
+#define O_DIRECT 00200000       /* 绕过页缓存，aarch64取值 */
+#define O_CLOEXEC 02000000
+
+/* fcntl命令 */
+#define F_GETFD 1
+#define F_SETFD 2
+#define F_GETFL 3
+#define F_SETFL 4
+#define F_ADD_SEALS 1033    /* memfd封印，封印后对应操作被禁止 */
+#define F_GET_SEALS 1034
+#define F_SEAL_SEAL     0x0001  /* 禁止再添加封印 */
+#define F_SEAL_SHRINK   0x0002  /* 禁止缩小 */
+#define F_SEAL_GROW     0x0004  /* 禁止增大 */
+#define F_SEAL_WRITE    0x0008  /* 禁止写入 */
+
+#define FD_CLOEXEC 1
+
+/* memfd_create标志位 */
+#define MFD_CLOEXEC         0x0001
+#define MFD_ALLOW_SEALING   0x0002
 
 #define UINT_MAX 0xffffffffffffffffUL
 
@@ -38,7 +61,12 @@ typedef unsigned int socklen_t;
 typedef unsigned long uint64_t;
 typedef unsigned short uint16_t;
 typedef unsigned int uint32_t;
+typedef unsigned char uint8_t;
+typedef int int32_t;
 typedef long int64_t;
+typedef long off_t;
+typedef unsigned int uid_t;
+typedef unsigned int gid_t;
 
 // 变长参数相关定义
 #define va_list __builtin_va_list
@@ -50,6 +78,20 @@ typedef long int64_t;
 #define LOG_LEVEL_DEBUG 0
 #define LOG_LEVEL_INFO  1
 #define LOG_LEVEL_ERROR 2
+#define LOG_LEVEL_NONE  3   // 关闭全部日志
+
+/*
+ * 编译期最低日志级别：低于该级别的LOG_xxx调用点在预处理阶段被整体移除，
+ * 不生成任何代码和数据，参数表达式也不会被求值。
+ * 可通过 -DLOG_COMPILE_LEVEL=n 覆盖，定义了NDEBUG的发布版本默认移除DEBUG日志。
+ */
+#ifndef LOG_COMPILE_LEVEL
+#ifdef NDEBUG
+#define LOG_COMPILE_LEVEL LOG_LEVEL_INFO
+#else
+#define LOG_COMPILE_LEVEL LOG_LEVEL_DEBUG
+#endif
+#endif
 
 // mmap相关常量定义
 #define PROT_READ  0x1
@@ -61,9 +103,17 @@ typedef long int64_t;
 #define MAP_GROWSDOWN 0x0100            /* Stack grows down.  */
 #define MAP_HUGETLB   0x40000          /* Create huge page mapping.  */
 #define MAP_FIXED     0x10              /* Interpret addr exactly.  */
+#define MAP_POPULATE  0x8000            /* Populate (prefault) pagetables.  */
 #define MAP_FILE     0
 #define MAP_ANON     MAP_ANONYMOUS
 #define MAP_FAILED ((void *)-1)
+
+/* madvise建议 */
+#define MADV_NORMAL     0   /* 默认预读 */
+#define MADV_RANDOM     1   /* 随机访问，关闭预读 */
+#define MADV_SEQUENTIAL 2   /* 顺序访问，加大预读并尽早回收 */
+#define MADV_WILLNEED   3   /* 即将访问，立即异步预读 */
+#define MADV_DONTNEED   4   /* 不再需要，丢弃这些页 */
 #define NULL ((void*)0)
 
 /* clone标志位 */
@@ -86,14 +136,70 @@ typedef long int64_t;
 typedef unsigned int socklen_t;
 
 /* 协议族 */
+#define AF_UNIX     1
+#define AF_LOCAL    AF_UNIX
 #define AF_INET     2
 
 /* Socket类型 */
 #define SOCK_STREAM 1
 #define SOCK_DGRAM  2
+#define SOCK_SEQPACKET 5    /* 保留消息边界的可靠连接(AF_UNIX) */
+
+/* socket/accept4 附加标志 */
+#define SOCK_NONBLOCK O_NONBLOCK
+#define SOCK_CLOEXEC  O_CLOEXEC
 
 /* 特殊IP地址 */
 #define INADDR_ANY ((unsigned long)0x00000000)
+#define INADDR_LOOPBACK ((unsigned long)0x7f000001)   /* 127.0.0.1，使用前需htonl */
+
+/* 协议号 */
+#define IPPROTO_IP  0
+#define IPPROTO_TCP 6
+#define IPPROTO_UDP 17
+
+/* setsockopt/getsockopt 层级 */
+#define SOL_SOCKET  1
+#define SOL_UDP     17
+
+/* SOL_SOCKET 选项 */
+#define SO_REUSEADDR    2
+#define SO_SNDBUF       7
+#define SO_RCVBUF       8
+#define SO_PASSCRED     16      /* 接收SCM_CREDENTIALS */
+#define SO_PEERCRED     17      /* 读取对端进程凭证 */
+#define SO_REUSEPORT    15
+
+#define SO_ZEROCOPY     60
+
+/* IPPROTO_IP/IPPROTO_IPV6 层选项 */
+#define SOL_IP          0
+#define SOL_IPV6        41
+#define IP_RECVERR      11
+#define IPV6_RECVERR    25
+
+/* IPPROTO_TCP 选项 */
+#define TCP_NODELAY     1
+
+/* SOL_UDP 选项 */
+#define UDP_SEGMENT     103     /* 发送端GSO：按该大小切分为多个数据报 */
+#define UDP_GRO         104     /* 接收端GRO：合并后的数据报附带分段大小 */
+
+/* send/recv 标志位 */
+#define MSG_PEEK        0x2
+#define MSG_CTRUNC      0x8
+#define MSG_TRUNC       0x20
+#define MSG_DONTWAIT    0x40
+#define MSG_NOSIGNAL    0x4000
+#define MSG_MORE        0x8000
+#define MSG_WAITFORONE  0x10000
+#define MSG_ERRQUEUE    0x2000      /* 从socket错误队列读取(零拷贝完成通知) */
+#define MSG_ZEROCOPY    0x4000000   /* 零拷贝发送，需先设置SO_ZEROCOPY */
+#define MSG_CMSG_CLOEXEC 0x40000000 /* 接收到的SCM_RIGHTS fd设置O_CLOEXEC */
+
+/* SOL_SOCKET 控制消息类型 */
+#define SCM_RIGHTS      1           /* 传递文件描述符 */
+#define SCM_CREDENTIALS 2           /* 传递进程凭证 */
 
 // 网络相关结构体定义
 struct sockaddr
@@ -115,18 +221,220 @@ struct sockaddr_in
     char           sin_zero[8];
 };
 
+/* AF_UNIX地址，sun_path[0]为0时表示抽象命名空间，不在文件系统中创建节点 */
+#define UNIX_PATH_MAX   108
+
+struct sockaddr_un
+{
+    unsigned short sun_family;
+    char           sun_path[UNIX_PATH_MAX];
+};
+
+/* SO_PEERCRED/SCM_CREDENTIALS 携带的进程凭证 */
+struct ucred
+{
+    pid_t pid;
+    uid_t uid;
+    gid_t gid;
+};
+
+/* sendmsg/recvmsg 消息头 */
+struct msghdr
+{
+    void *msg_name;             /* 对端地址，可为NULL */
+    socklen_t msg_namelen;      /* 地址长度 */
+    struct iovec *msg_iov;      /* 数据向量 */
+    size_t msg_iovlen;          /* 向量个数 */
+    void *msg_control;          /* 辅助数据(控制消息)缓冲区 */
+    size_t msg_controllen;      /* 辅助数据长度 */
+    int msg_flags;              /* recvmsg返回的标志 */
+};
+
+/* sendmmsg/recvmmsg 批量消息 */
+struct mmsghdr
+{
+    struct msghdr msg_hdr;
+    unsigned int msg_len;       /* 本条消息实际收发的字节数 */
+};
+
+/* 控制消息头 */
+struct cmsghdr
+{
+    size_t cmsg_len;            /* 包含头部的总长度 */
+    int cmsg_level;             /* 协议层，如SOL_SOCKET/SOL_UDP */
+    int cmsg_type;              /* 协议相关类型 */
+};
+
+#define CMSG_ALIGN(len)     (((len) + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1))
+#define CMSG_SPACE(len)     (CMSG_ALIGN(sizeof(struct cmsghdr)) + CMSG_ALIGN(len))
+#define CMSG_LEN(len)       (CMSG_ALIGN(sizeof(struct cmsghdr)) + (len))
+#define CMSG_DATA(cmsg)     ((unsigned char *)((struct cmsghdr *)(cmsg) + 1))
+#define CMSG_FIRSTHDR(mhdr) \
+    ((mhdr)->msg_controllen >= sizeof(struct cmsghdr) ? \
+     (struct cmsghdr *)(mhdr)->msg_control : (struct cmsghdr *)NULL)
+#define CMSG_NXTHDR(mhdr, cmsg) cmsg_nxthdr((mhdr), (cmsg))
+
+/* 错误队列中的扩展错误信息(IP_RECVERR/IPV6_RECVERR控制消息) */
+struct sock_extended_err
+{
+    uint32_t ee_errno;
+    uint8_t  ee_origin;
+    uint8_t  ee_type;
+    uint8_t  ee_code;
+    uint8_t  ee_pad;
+    uint32_t ee_info;           /* 零拷贝通知：完成区间起始序号 */
+    uint32_t ee_data;           /* 零拷贝通知：完成区间结束序号(含) */
+};
+
+#define SO_EE_ORIGIN_ZEROCOPY       5
+#define SO_EE_CODE_ZEROCOPY_COPIED  1   /* 内核最终还是拷贝了数据 */
+
 struct timespec 
 {
     long tv_sec;    /* 秒 */
     long tv_nsec;   /* 纳秒 */
 };
 
+struct itimerspec
+{
+    struct timespec it_interval;    /* 周期 */
+    struct timespec it_value;       /* 首次到期时间 */
+};
+
+struct timeval
+{
+    long tv_sec;    /* 秒 */
+    long tv_usec;   /* 微秒 */
+};
+
+/* 时钟 */
+#define CLOCK_REALTIME              0
+#define CLOCK_MONOTONIC             1
+#define CLOCK_PROCESS_CPUTIME_ID    2
+#define CLOCK_THREAD_CPUTIME_ID     3
+#define CLOCK_MONOTONIC_RAW         4
+#define CLOCK_REALTIME_COARSE       5
+#define CLOCK_MONOTONIC_COARSE      6
+#define CLOCK_BOOTTIME              7
+
+/* 辅助向量(auxv)类型，内核在进程栈上环境变量之后传入 */
+#define AT_NULL         0
+#define AT_PHDR         3       /* 程序头表地址 */
+#define AT_PHENT        4       /* 程序头表项大小 */
+#define AT_PHNUM        5       /* 程序头表项个数 */
+#define AT_PAGESZ       6       /* 页大小 */
+#define AT_BASE         7       /* 动态链接器基址 */
+#define AT_ENTRY        9       /* 程序入口 */
+#define AT_HWCAP        16      /* CPU特性位 */
+#define HWCAP_ATOMICS   (1 << 8)    /* AT_HWCAP中的LSE原子指令位 */
+#define AT_CLKTCK       17
+#define AT_RANDOM       25      /* 16字节随机数地址 */
+#define AT_HWCAP2       26
+#define AT_SYSINFO_EHDR 33      /* vDSO的ELF头地址 */
+
+/* epoll相关定义 */
+#define EPOLL_CLOEXEC   O_CLOEXEC
+#define EPOLL_CTL_ADD   1
+#define EPOLL_CTL_DEL   2
+#define EPOLL_CTL_MOD   3
+
+#define EPOLLIN         0x00000001
+#define EPOLLPRI        0x00000002
+#define EPOLLOUT        0x00000004
+#define EPOLLERR        0x00000008
+#define EPOLLHUP        0x00000010
+#define EPOLLRDHUP      0x00002000
+#define EPOLLEXCLUSIVE  (1U << 28)
+#define EPOLLONESHOT    (1U << 30)
+#define EPOLLET         (1U << 31)  /* 边沿触发 */
+
+typedef union epoll_data
+{
+    void *ptr;
+    int fd;
+    uint32_t u32;
+    uint64_t u64;
+} epoll_data_t;
+
+/* aarch64上不是packed结构，大小16字节 */
+struct epoll_event
+{
+    uint32_t events;
+    epoll_data_t data;
+};
+
+/* poll事件 */
+#define POLLIN          0x001
+#define POLLPRI         0x002
+#define POLLOUT         0x004
+#define POLLERR         0x008
+#define POLLHUP         0x010
+#define POLLNVAL        0x020
+
+struct pollfd
+{
+    int fd;
+    short events;               /* 关心的事件 */
+    short revents;              /* 返回的就绪事件 */
+};
+
+/* eventfd/timerfd标志位 */
+#define EFD_SEMAPHORE       1
+#define EFD_CLOEXEC         O_CLOEXEC
+#define EFD_NONBLOCK        O_NONBLOCK
+#define TFD_CLOEXEC         O_CLOEXEC
+#define TFD_NONBLOCK        O_NONBLOCK
+#define TFD_TIMER_ABSTIME   1
+
 /* pthread相关定义 */
 typedef unsigned long pthread_t;
 typedef struct pthread_attr_t {
-    int dummy;  // 暂时不支持线程属性
+    size_t stacksize;   // 线程栈大小，不含保护页和TLS
+    size_t guardsize;   // 栈底保护页大小
+    int detachstate;    // PTHREAD_CREATE_*
 } pthread_attr_t;
 
+#define PTHREAD_STACK_MIN   16384
+#define PTHREAD_CREATE_JOINABLE 0
+#define PTHREAD_CREATE_DETACHED 1
+
+/* 分散/聚集I/O向量 */
+struct iovec
+{
+    void *iov_base;     /* 缓冲区起始地址 */
+    size_t iov_len;     /* 缓冲区长度 */
+};
+
+/* splice/tee/vmsplice 标志位 */
+#define SPLICE_F_MOVE       1   /* 尽量移动页而不是复制 */
+#define SPLICE_F_NONBLOCK   2   /* 管道操作不阻塞 */
+#define SPLICE_F_MORE       4   /* 后续还有数据，提示socket合并发送 */
+#define SPLICE_F_GIFT       8   /* vmsplice：把用户页交给内核 */
+
+/* fallocate模式 */
+#define FALLOC_FL_KEEP_SIZE     0x01    /* 只分配磁盘空间，不改变文件长度 */
+#define FALLOC_FL_PUNCH_HOLE    0x02    /* 释放区间占用的空间，需配合KEEP_SIZE */
+
+/* sync_file_range标志位 */
+#define SYNC_FILE_RANGE_WAIT_BEFORE 1   /* 先等待区间内已在进行的回写完成 */
+#define SYNC_FILE_RANGE_WRITE       2   /* 对区间内的脏页发起回写，不等待完成 */
+#define SYNC_FILE_RANGE_WAIT_AFTER  4   /* 等待本次发起的回写完成 */
+
+/* posix_fadvise建议 */
+#define POSIX_FADV_NORMAL       0
+#define POSIX_FADV_RANDOM       1
+#define POSIX_FADV_SEQUENTIAL   2
+#define POSIX_FADV_WILLNEED     3
+#define POSIX_FADV_DONTNEED     4   /* 丢弃区间内的干净页 */
+#define POSIX_FADV_NOREUSE      5
+
+/* preadv2/pwritev2 标志位 */
+#define RWF_HIPRI   0x00000001  /* 高优先级请求，轮询完成 */
+#define RWF_DSYNC   0x00000002  /* 单次写入的O_DSYNC语义 */
+#define RWF_SYNC    0x00000004  /* 单次写入的O_SYNC语义 */
+#define RWF_NOWAIT  0x00000008  /* 数据不在页缓存中时不阻塞，返回EAGAIN */
+#define RWF_APPEND  0x00000010  /* 单次写入的O_APPEND语义 */
+
 /* 错误码定义 */
 #define EINVAL      22      /* Invalid argument */
 #define EAGAIN      11      /* Try again */
@@ -134,6 +442,33 @@ typedef struct pthread_attr_t {
 #define ESRCH       3       /* No such process */
 #define EINTR       4       /* 系统调用被中断 */
 #define EDEADLK     35      /* Resource deadlock would occur */
+#define EWOULDBLOCK EAGAIN  /* Operation would block */
+#define EBADF       9       /* Bad file number */
+#define EEXIST      17      /* File exists */
+#define ENOENT      2       /* No such file or directory */
+#define EMFILE      24      /* Too many open files */
+#define ECONNABORTED 103    /* Software caused connection abort */
+#define ENOSYS      38      /* Function not implemented */
+#define EPIPE       32      /* Broken pipe */
+#define ENOBUFS     105     /* No buffer space available */
+#define ENOPROTOOPT 92      /* Protocol not available */
+#define ETIMEDOUT   110     /* Connection timed out */
+#define EOPNOTSUPP  95      /* Operation not supported */
+#define EBUSY       16      /* Device or resource busy */
+#define EPERM       1       /* Operation not permitted */
+#define EADDRINUSE  98      /* Address already in use */
+#define ECONNREFUSED 111    /* Connection refused */
+
+/* futex操作码，或上FUTEX_PRIVATE_FLAG表示只在本进程内使用，内核可跳过共享映射查找 */
+#define FUTEX_WAIT          0
+#define FUTEX_WAKE          1
+#define FUTEX_CMP_REQUEUE   4   /* 唤醒val个，再把最多val2个等待者转移到uaddr2，*uaddr需等于val3 */
+#define FUTEX_WAIT_BITSET   9   /* 等待时带一个位掩码(val3) */
+#define FUTEX_WAKE_BITSET   10  /* 只唤醒位掩码有交集的等待者 */
+#define FUTEX_PRIVATE_FLAG  128
+#define FUTEX_CLOCK_REALTIME 256    /* FUTEX_WAIT_BITSET的超时是CLOCK_REALTIME绝对时间 */
+#define FUTEX_BITSET_MATCH_ANY 0xffffffff
+#define FUTEX_WAKE_ALL      0x7fffffff  /* FUTEX_WAKE唤醒全部等待者 */
 
 /* 互斥锁相关定义 */
 typedef struct pthread_mutex_t {
@@ -141,33 +476,108 @@ typedef struct pthread_mutex_t {
      * 内存布局:
      * +------------------------+ <-- 64字节对齐
      * |          lock         |     4字节
-     * |         (0/1)         |
+     * |        (0/1/2)        |
      * +------------------------+
      * |         owner         |     4字节
      * |    (线程ID/0表示无)    |
      * +------------------------+
+     * |         spins         |     4字节
+     * +------------------------+
      * |                       |
-     * |        padding        |     56字节填充
+     * |        padding        |     52字节填充
      * |                       |
      * +------------------------+ <-- 总64字节
      * - lock: 占用4字节,使用64字节对齐以避免伪共享
      *   - 值为0表示锁未被持有
-     *   - 值为1表示锁已被持有
+     *   - 值为1表示锁已被持有,没有等待者
+     *   - 值为2表示锁已被持有,可能有线程在futex上等待
      * - owner: 占用4字节,紧跟在lock后面
      *   - 值为0表示无持有者
      *   - 非0值表示持有锁的线程ID
+     * - spins: 最近竞争时自旋成功所用次数的平均值,自旋失败时衰减,决定下次自旋上限
      * 
-     * 总大小: 8字节,但由于64字节对齐,实际占用64字节
+     * 总大小: 12字节,但由于64字节对齐,实际占用64字节
      */
     volatile int lock __attribute__((aligned(64)));  // 避免伪共享
     volatile int owner;
+    int spins;
 } pthread_mutex_t;
 
 typedef struct pthread_mutexattr_t {
     int type;
 } pthread_mutexattr_t;
 
-#define PTHREAD_MUTEX_INITIALIZER { 0, 0 }
+#define PTHREAD_MUTEX_INITIALIZER { 0, 0, 0 }
+
+typedef struct pthread_cond_t {
+    volatile int seq;           // 每次signal/broadcast加1，等待者在其上futex等待
+    volatile int waiters;       // 等待者数量，为0时signal/broadcast不进入内核
+    pthread_mutex_t *mutex;     // 等待者使用的互斥锁，broadcast把等待者转移到它的futex上
+} pthread_cond_t;
+
+typedef struct pthread_condattr_t {
+    int dummy;  // 暂时不支持条件变量属性，超时总是基于CLOCK_REALTIME
+} pthread_condattr_t;
+
+#define PTHREAD_COND_INITIALIZER { 0, 0, NULL }
+
+/* 读写锁偏好 */
+#define PTHREAD_RWLOCK_PREFER_READER_NP 0   /* 有读者持有时新读者直接进入，写者可能饥饿 */
+#define PTHREAD_RWLOCK_PREFER_WRITER_NP 1   /* 有写者等待时新读者也要等待 */
+
+typedef struct pthread_rwlock_t {
+    /*
+     * state各位含义:
+     * - bit 31: 写锁已被持有
+     * - bit 30: 有写者在等待
+     * - bit 29: 有读者在等待
+     * - bit 0-28: 持有读锁的读者数
+     * 读者和写者都在state上futex等待，用不同的bitset区分，可以只唤醒其中一类
+     */
+    volatile unsigned int state __attribute__((aligned(64)));  // 避免伪共享
+    int writer;     // 持有写锁的线程ID，0表示无
+    int kind;       // PTHREAD_RWLOCK_PREFER_*
+} pthread_rwlock_t;
+
+typedef struct pthread_rwlockattr_t {
+    int kind;
+} pthread_rwlockattr_t;
+
+#define PTHREAD_RWLOCK_INITIALIZER { 0, 0, PTHREAD_RWLOCK_PREFER_READER_NP }
+
+typedef struct pthread_spinlock_t {
+    /*
+     * 票号自旋锁:
+     * - bit 0-15: owner，当前可以进入的票号
+     * - bit 16-31: next，下一个发出的票号
+     * 两者相等表示未被持有。按取票顺序进入，不会饥饿
+     */
+    volatile unsigned int ticket __attribute__((aligned(64)));  // 避免伪共享
+} pthread_spinlock_t;
+
+#define PTHREAD_PROCESS_PRIVATE 0
+#define PTHREAD_PROCESS_SHARED  1
+
+/*
+ * MCS队列锁
+ *
+ * 每个等待者带一个自己的mcs_node排在队尾，只在自己节点的locked上自旋，
+ * 解锁时由持有者直接把锁交给队列中的下一个节点。等待者再多，
+ * 每次交接也只涉及两个线程的缓存行。节点在加锁到解锁期间必须保持有效，
+ * 通常放在调用者的栈上。
+ */
+struct mcs_node
+{
+    struct mcs_node *volatile next;     // 队列中的下一个等待者
+    volatile int locked;                // 1表示还在等待，前驱解锁时清0
+} __attribute__((aligned(64)));
+
+struct mcs_lock
+{
+    struct mcs_node *volatile tail __attribute__((aligned(64)));  // 队尾节点，NULL表示未被持有
+};
+
+#define MCS_LOCK_INITIALIZER { NULL }
 
 // 字符串操作函数声明
 int strlen(const char *s);
@@ -175,12 +585,213 @@ char *itoa(long num, char *str, int radix, unsigned char sign_flag);
 void *memcpy(void *dest, const void *src, size_t n);
 int strcmp(const char *s1, const char *s2);
 int strncmp(const char *s1, const char *s2, size_t n);
+void *memchr(const void *s, int c, size_t n);
+/* fstat返回的文件元数据(aarch64布局) */
+struct stat
+{
+    unsigned long st_dev;
+    unsigned long st_ino;
+    unsigned int st_mode;       /* 文件类型和权限 */
+    unsigned int st_nlink;
+    uid_t st_uid;
+    gid_t st_gid;
+    unsigned long st_rdev;
+    unsigned long __pad1;
+    off_t st_size;              /* 文件字节数 */
+    int st_blksize;             /* 文件系统建议的I/O块大小 */
+    int __pad2;
+    long st_blocks;             /* 占用的512字节块数 */
+    struct timespec st_atim;
+    struct timespec st_mtim;
+    struct timespec st_ctim;
+    unsigned int __unused4;
+    unsigned int __unused5;
+};
+
+#define S_IFMT      0170000
+#define S_IFREG     0100000
+#define S_IFDIR     0040000
+#define S_IFSOCK    0140000
+#define S_ISREG(m)  (((m) & S_IFMT) == S_IFREG)
+#define S_ISDIR(m)  (((m) & S_IFMT) == S_IFDIR)
+#define S_ISSOCK(m) (((m) & S_IFMT) == S_IFSOCK)
+
 // 文件操作函数声明
 int write(int fd, const void *buf, int count);
 ssize_t read(int fd, void *buf, size_t count);
 int open(const char *pathname, int flags, int mode);
 int close(int fd);
-int lseek(int fd, int offset, int whence);
+int fcntl(int fd, int cmd, long arg);
+int set_nonblocking(int fd);
+off_t lseek(int fd, off_t offset, int whence);
+int ftruncate(int fd, off_t length);
+int unlink(const char *pathname);
+int memfd_create(const char *name, unsigned int flags);
+int fstat(int fd, struct stat *st);
+int lstat(const char *pathname, struct stat *st);
+// 分散/聚集与定位I/O函数声明，失败返回-1并设置mini_errno
+ssize_t readv(int fd, const struct iovec *iov, int iovcnt);
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt);
+ssize_t pread64(int fd, void *buf, size_t count, off_t offset);
+ssize_t pwrite64(int fd, const void *buf, size_t count, off_t offset);
+ssize_t preadv2(int fd, const struct iovec *iov, int iovcnt, off_t offset, int flags);
+ssize_t pwritev2(int fd, const struct iovec *iov, int iovcnt, off_t offset, int flags);
+// 落盘与预分配函数声明，失败返回-1并设置mini_errno
+int fsync(int fd);
+int fdatasync(int fd);
+int sync_file_range(int fd, off_t offset, off_t nbytes, unsigned int flags);
+int fallocate(int fd, int mode, off_t offset, off_t len);
+int posix_fadvise(int fd, off_t offset, off_t len, int advice);
+// 零拷贝传输函数声明，失败返回-1并设置mini_errno
+int pipe2(int pipefd[2], int flags);
+ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count);
+ssize_t splice(int fd_in, off_t *off_in, int fd_out, off_t *off_out, size_t len, unsigned int flags);
+ssize_t tee(int fd_in, int fd_out, size_t len, unsigned int flags);
+ssize_t vmsplice(int fd, const struct iovec *iov, unsigned long nr_segs, unsigned int flags);
+
+/*
+ * 文件区域到socket的零拷贝流
+ *
+ * 优先使用sendfile；内核不支持该fd组合时退化为 文件->管道->socket 的splice。
+ * socket可以是非阻塞的：发送缓冲区满时file_stream_send返回0，
+ * 已读入管道但尚未发出的数据保存在管道中，等socket可写后继续调用即可。
+ */
+struct file_stream
+{
+    int sock;           /* 目标socket */
+    int file_fd;        /* 源文件 */
+    off_t offset;       /* 下一个要读取的文件偏移 */
+    size_t remaining;   /* 尚未从文件读出的字节数 */
+    int pipefd[2];      /* splice路径使用的中转管道，未使用时为-1 */
+    size_t in_pipe;     /* 管道中尚未发出的字节数 */
+    size_t sent;        /* 已发送到socket的字节数 */
+};
+
+int file_stream_init(struct file_stream *fs, int sock, int file_fd, off_t offset, size_t count);
+int file_stream_send(struct file_stream *fs);
+void file_stream_close(struct file_stream *fs);
+
+/*
+ * 带缓冲的读取器
+ *
+ * 每次系统调用尽量读满缓冲区，按行/按定长记录取数据时只在用户态查找和拷贝。
+ * 缓冲区大小可调，大的缓冲区减少系统调用次数，小的缓冲区占用更少的缓存。
+ */
+#define BUF_READER_DEFAULT_SIZE (64 * 1024)
+
+struct buf_reader
+{
+    int fd;
+    char *buf;          /* mmap得到的缓冲区 */
+    size_t cap;         /* 缓冲区容量，页对齐 */
+    size_t pos;         /* 下一个未消费字节 */
+    size_t end;         /* 有效数据结尾 */
+    int eof;            /* 已读到文件末尾 */
+};
+
+int buf_reader_init(struct buf_reader *r, int fd, size_t buf_size);
+void buf_reader_destroy(struct buf_reader *r);
+ssize_t buf_read(struct buf_reader *r, void *dst, size_t len);
+ssize_t buf_getdelim(struct buf_reader *r, char **lineptr, size_t *n, int delim);
+ssize_t buf_getline(struct buf_reader *r, char **lineptr, size_t *n);
+ssize_t buf_read_record(struct buf_reader *r, void *rec, size_t size);
+const void *buf_next_record(struct buf_reader *r, size_t size);
+
+/*
+ * 只读映射整个文件，data/len即文件内容，不需要任何read拷贝
+ */
+#define MAPPED_FILE_SEQUENTIAL  0x1     /* madvise(MADV_SEQUENTIAL) */
+#define MAPPED_FILE_WILLNEED    0x2     /* madvise(MADV_WILLNEED) */
+#define MAPPED_FILE_POPULATE    0x4     /* MAP_POPULATE，映射时就建立全部页表 */
+
+struct mapped_file
+{
+    const char *data;   /* 文件内容，空文件为NULL */
+    size_t len;         /* 文件字节数 */
+};
+
+int mapped_file_open(struct mapped_file *mf, const char *path, int flags);
+void mapped_file_close(struct mapped_file *mf);
+
+/*
+ * O_DIRECT直接I/O
+ *
+ * 数据在用户缓冲区和设备之间直接传输，不进入页缓存。内存地址、文件偏移、
+ * 长度都必须按DIO_ALIGN对齐，dio_file负责把任意的读写请求整理成对齐的I/O，
+ * 文件结尾不足一个对齐块的部分关闭O_DIRECT后走普通缓冲写。
+ */
+#define DIO_ALIGN               4096
+#define DIO_DEFAULT_BUF_SIZE    (1024 * 1024)
+
+/* 对齐缓冲区池，缓冲区大小相同，空闲缓冲区串成链表，非线程安全 */
+struct dio_pool
+{
+    char *base;         /* 整块mmap区域 */
+    size_t buf_size;    /* 每个缓冲区大小，DIO_ALIGN的倍数 */
+    int count;          /* 缓冲区总数 */
+    int nfree;          /* 空闲缓冲区数 */
+    void *free_list;    /* 空闲链表，链接指针存在缓冲区开头 */
+};
+
+struct dio_file
+{
+    int fd;
+    int direct;         /* 是否成功以O_DIRECT打开，文件系统不支持时为0 */
+    off_t offset;       /* dio_write/dio_read的下一个文件偏移 */
+    char *buf;          /* 对齐的中转缓冲区 */
+    size_t buf_size;
+    size_t fill;        /* 写方向：中转缓冲区中待写出的字节数 */
+};
+
+int dio_pool_init(struct dio_pool *pool, size_t buf_size, int count);
+void *dio_pool_get(struct dio_pool *pool);
+void dio_pool_put(struct dio_pool *pool, void *buf);
+void dio_pool_destroy(struct dio_pool *pool);
+
+int dio_open(struct dio_file *f, const char *path, int flags, int mode, size_t buf_size);
+ssize_t dio_write(struct dio_file *f, const void *data, size_t len);
+ssize_t dio_pread(struct dio_file *f, void *dst, size_t len, off_t offset);
+ssize_t dio_read(struct dio_file *f, void *dst, size_t len);
+int dio_close(struct dio_file *f);
+
+/*
+ * 只追加的持久化日志(预写日志)
+ *
+ * 追加只写入页缓存，append_log_sync等待数据落盘；多个线程同时sync时
+ * 由一个线程代表大家执行一次fdatasync(group commit)。
+ */
+#define APPEND_LOG_DEFAULT_PREALLOC     (64 * 1024 * 1024)
+#define APPEND_LOG_DEFAULT_WRITEBACK    (1024 * 1024)
+
+struct append_log_config
+{
+    size_t prealloc_size;   /* 每次fallocate预分配的大小，0表示默认值 */
+    size_t writeback_size;  /* 积累多少未回写数据后用sync_file_range启动回写，0表示默认值 */
+    int drop_cache;         /* 非0时把已落盘的数据从页缓存中丢弃 */
+};
+
+struct append_log
+{
+    pthread_mutex_t lock;       /* 串行化追加 */
+    int fd;
+    struct append_log_config cfg;
+    off_t written;              /* 已写入页缓存的末尾，也是下一条记录的偏移 */
+    off_t alloc_end;            /* 已预分配到的位置 */
+    off_t kicked;               /* 已启动回写的位置 */
+    off_t synced;               /* 已落盘的位置 */
+    off_t dropped;              /* 已从页缓存丢弃的位置 */
+    volatile int syncing;       /* 是否有线程正在执行fdatasync */
+    volatile int sync_seq;      /* futex字，每完成一次fdatasync加1 */
+    volatile int waiters;       /* 等待sync_seq变化的线程数 */
+    unsigned long syncs;        /* fdatasync次数 */
+    unsigned long commits;      /* append_log_sync调用次数 */
+};
+
+int append_log_open(struct append_log *log, const char *path, const struct append_log_config *cfg);
+off_t append_log_append(struct append_log *log, const void *data, size_t len);
+int append_log_sync(struct append_log *log, off_t lsn);
+int append_log_close(struct append_log *log);
+
 // 打印函数声明
 int printf(const char *format, ...);
 int vsprintf(char *buf, const char *format, va_list args);
@@ -194,30 +805,257 @@ int brk(void *end_data);
 void *sbrk(long increment);
 void *mmap(void *addr, long size, int prot, int flags, int fd, long offset);
 int munmap(void *addr, long size);
+int madvise(void *addr, size_t len, int advice);
+int mprotect(void *addr, size_t len, int prot);
 void* malloc(size_t size);
 void free(void* ptr);
 void* memset(void* s, int c, size_t n);
 
+/* waitpid选项与退出状态解析 */
+#define WNOHANG         1
+#define WEXITSTATUS(s)  (((s) >> 8) & 0xff)
+#define WIFEXITED(s)    (((s) & 0x7f) == 0)
+
+// 启动与辅助向量函数声明
+extern char **environ;
+void __mini_libc_init(long *sp);
+unsigned long getauxval(unsigned long type);
+
+// 时间函数声明，优先走vDSO，不可用时退回系统调用
+int clock_gettime(int clk_id, struct timespec *tp);
+int clock_getres(int clk_id, struct timespec *res);
+int gettimeofday(struct timeval *tv, void *tz);
+void vdso_init(unsigned long base);
+void *vdso_sym(const char *version, const char *name);
+
+/**
+ * 读取通用定时器虚拟计数值(CNTVCT_EL0)，用户态直接访问，约几纳秒
+ * 不保证与前面的指令有序，测量很短的代码段时用cycles_read_ordered
+ */
+static inline uint64_t cycles_read(void)
+{
+    uint64_t ticks;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+}
+
+/**
+ * 先用ISB等待前面的指令执行完再读计数值
+ */
+static inline uint64_t cycles_read_ordered(void)
+{
+    uint64_t ticks;
+    asm volatile("isb\n\tmrs %0, cntvct_el0" : "=r"(ticks) : : "memory");
+    return ticks;
+}
+
+/**
+ * 读取固件声明的计数器频率(CNTFRQ_EL0)，单位Hz
+ */
+static inline uint64_t cycles_freq(void)
+{
+    uint64_t freq;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(freq));
+    return freq;
+}
+
+uint64_t cycles_calibrate(void);
+uint64_t cycles_to_ns(uint64_t cycles);
+
 // 进程操作函数声明
 int fork(void);
 pid_t getpid(void);
+uid_t getuid(void);
+gid_t getgid(void);
+pid_t waitpid(pid_t pid, int *status, int options);
 int clone(int (*fn)(void *), void *stack, int flags, void *arg, ...);
+int atexit(void (*func)(void));
+void exit(int status) __attribute__((noreturn));
+void _exit(int status) __attribute__((noreturn));
 
 // Socket操作函数声明
 int socket(int domain, int type, int protocol);
+int socketpair(int domain, int type, int protocol, int sv[2]);
 int connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen);
 int bind(int sockfd, const struct sockaddr *addr, socklen_t addrlen);
 int listen(int sockfd, int backlog);
 int accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen);
+int accept4(int sockfd, struct sockaddr *addr, socklen_t *addrlen, int flags);
 ssize_t send(int sockfd, const void *buf, size_t len, int flags);
 ssize_t recv(int sockfd, void *buf, size_t len, int flags);
 unsigned short htons(unsigned short hostshort);
+unsigned short ntohs(unsigned short netshort);
+uint32_t htonl(uint32_t hostlong);
+ssize_t sendto(int sockfd, const void *buf, size_t len, int flags,
+               const struct sockaddr *dest_addr, socklen_t addrlen);
+ssize_t recvfrom(int sockfd, void *buf, size_t len, int flags,
+                 struct sockaddr *src_addr, socklen_t *addrlen);
+ssize_t sendmsg(int sockfd, const struct msghdr *msg, int flags);
+ssize_t recvmsg(int sockfd, struct msghdr *msg, int flags);
+int sendmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags);
+int recvmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags,
+             struct timespec *timeout);
+int setsockopt(int sockfd, int level, int optname, const void *optval, socklen_t optlen);
+int getsockopt(int sockfd, int level, int optname, void *optval, socklen_t *optlen);
+struct cmsghdr *cmsg_nxthdr(struct msghdr *msg, struct cmsghdr *cmsg);
+
+// UDP GSO/GRO辅助函数声明
+int udp_enable_gro(int sockfd);
+int udp_set_segment_size(int sockfd, int gso_size);
+void udp_cmsg_put_segment(struct msghdr *msg, void *cbuf, size_t cbuf_len, uint16_t gso_size);
+int udp_cmsg_get_gro(struct msghdr *msg);
+
+// AF_UNIX辅助函数声明，abstract非0时使用抽象命名空间
+#define UNIX_MAX_FDS    16      /* 单条消息最多传递的fd数 */
+socklen_t unix_addr_init(struct sockaddr_un *addr, const char *name, int abstract);
+int unix_listen(const char *name, int abstract, int type, int backlog);
+int unix_connect(const char *name, int abstract, int type);
+ssize_t unix_send_fds(int sockfd, const void *buf, size_t len, const int *fds, int nfds);
+ssize_t unix_recv_fds(int sockfd, void *buf, size_t len, int *fds, int *nfds);
+int unix_enable_passcred(int sockfd);
+ssize_t unix_send_creds(int sockfd, const void *buf, size_t len);
+ssize_t unix_recv_creds(int sockfd, void *buf, size_t len, struct ucred *cred);
+int unix_peer_cred(int sockfd, struct ucred *cred);
+
+/* 零拷贝发送器，一个socket对应一个 */
+#define ZC_WINDOW       1024        /* 最多同时在途的零拷贝发送次数 */
+#define ZC_ID_NONE      0xffffffffu /* 本次发送走了拷贝路径，缓冲区可立即复用 */
+
+struct zc_sender
+{
+    int sock;
+    int enabled;                    /* 当前是否使用MSG_ZEROCOPY */
+    size_t min_size;                /* 小于该长度的发送直接拷贝 */
+    uint32_t next_id;               /* 下一次零拷贝发送的序号，与内核计数一致 */
+    uint32_t completed;             /* 小于该序号的发送都已完成 */
+    uint64_t done_bits[ZC_WINDOW / 64]; /* 乱序完成的序号位图 */
+    unsigned long zc_completions;   /* 真正零拷贝完成的发送次数 */
+    unsigned long copied_completions; /* 内核回退为拷贝的发送次数 */
+};
+
+// 零拷贝发送函数声明
+int zc_sender_init(struct zc_sender *zs, int sock);
+ssize_t zc_send(struct zc_sender *zs, const void *buf, size_t len, int flags, uint32_t *id);
+int zc_reap(struct zc_sender *zs);
+int zc_buffer_reusable(struct zc_sender *zs, uint32_t id);
+int zc_wait(struct zc_sender *zs, uint32_t id, int timeout_ms);
+int zc_flush(struct zc_sender *zs, int timeout_ms);
+
+/* CPU亲和性 */
+#define CPU_SETSIZE     1024
+
+typedef struct
+{
+    unsigned long bits[CPU_SETSIZE / 64];
+} cpu_set_t;
+
+#define CPU_ZERO(set)       memset((set), 0, sizeof(cpu_set_t))
+#define CPU_SET(cpu, set)   ((set)->bits[(cpu) / 64] |= 1UL << ((cpu) % 64))
+#define CPU_CLR(cpu, set)   ((set)->bits[(cpu) / 64] &= ~(1UL << ((cpu) % 64)))
+#define CPU_ISSET(cpu, set) (((set)->bits[(cpu) / 64] >> ((cpu) % 64)) & 1)
+#define CPU_COUNT(set)      cpu_set_count(set)
+
+// 调度相关函数声明，pid为0表示调用线程
+int sched_setaffinity(pid_t pid, size_t cpusetsize, const cpu_set_t *mask);
+int sched_getaffinity(pid_t pid, size_t cpusetsize, cpu_set_t *mask);
+int sched_yield(void);
+int cpu_set_count(const cpu_set_t *set);
+int get_nprocs(void);
+
+// epoll/eventfd/timerfd函数声明，失败返回-1并设置mini_errno
+int epoll_create1(int flags);
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event);
+int epoll_pwait(int epfd, struct epoll_event *events, int maxevents, int timeout, const void *sigmask);
+int poll(struct pollfd *fds, unsigned long nfds, int timeout);
+int eventfd(unsigned int initval, int flags);
+int timerfd_create(int clockid, int flags);
+int timerfd_settime(int fd, int flags, const struct itimerspec *new_value, struct itimerspec *old_value);
+int timerfd_gettime(int fd, struct itimerspec *curr_value);
+
+/*
+ * 事件循环(reactor)
+ *
+ * 基于epoll的单线程事件循环：fd读写回调、基于timerfd的定时器、
+ * 监听socket的批量accept。处理器表按fd下标预先mmap，注册/注销不调用malloc，
+ * 每个线程可以各自运行一个事件循环。
+ */
+struct event_loop;
+
+/* fd就绪回调，events为EPOLLIN/EPOLLOUT等就绪事件 */
+typedef void (*event_io_cb)(struct event_loop *loop, int fd, uint32_t events, void *arg);
+/* 定时器回调，expirations为自上次回调以来到期的次数 */
+typedef void (*event_timer_cb)(struct event_loop *loop, int timer_fd, uint64_t expirations, void *arg);
+/* 新连接回调，conn_fd已设置为非阻塞和CLOEXEC */
+typedef void (*event_accept_cb)(struct event_loop *loop, int conn_fd, void *arg);
+
+struct event_loop *event_loop_create(int max_fds);
+void event_loop_destroy(struct event_loop *loop);
+int event_loop_add_fd(struct event_loop *loop, int fd, uint32_t events, event_io_cb cb, void *arg);
+int event_loop_mod_fd(struct event_loop *loop, int fd, uint32_t events);
+int event_loop_del_fd(struct event_loop *loop, int fd);
+int event_loop_add_timer(struct event_loop *loop, long initial_ms, long interval_ms,
+                         event_timer_cb cb, void *arg);
+int event_loop_del_timer(struct event_loop *loop, int timer_fd);
+int event_loop_add_listener(struct event_loop *loop, int listen_fd, event_accept_cb cb, void *arg);
+int event_loop_run(struct event_loop *loop);
+void event_loop_stop(struct event_loop *loop);
+
+/* SO_REUSEPORT多线程服务器：每个worker独占一个监听socket和事件循环 */
+struct server_config
+{
+    unsigned short port;            /* 监听端口 */
+    int workers;                    /* worker数，0表示每个可用CPU一个 */
+    int backlog;                    /* 每个监听socket的backlog，0取默认值 */
+    int pin_cpus;                   /* 非0时把worker绑定到各自的CPU */
+    int tcp_nodelay;                /* 非0时关闭Nagle算法 */
+    int sndbuf;                     /* SO_SNDBUF，0表示内核默认 */
+    int rcvbuf;                     /* SO_RCVBUF，0表示内核默认 */
+    int max_fds;                    /* 每个事件循环的fd上限，0取默认值 */
+    event_accept_cb on_accept;      /* 新连接回调，在所属worker线程中执行 */
+    /* worker事件循环启动前的回调(可为NULL)，可在此添加定时器等 */
+    void (*on_worker_start)(struct event_loop *loop, int worker_id, void *arg);
+    void *arg;                      /* 传给回调的用户参数 */
+};
+
+struct server_worker
+{
+    struct server *srv;
+    int id;
+    int cpu;                        /* 绑定的CPU，-1表示不绑定 */
+    int listen_fd;
+    struct event_loop *loop;
+    pthread_t thread;
+};
+
+struct server
+{
+    struct server_config cfg;
+    int nworkers;
+    struct server_worker *workers;
+};
+
+// 服务器函数声明
+int server_start(struct server *srv, const struct server_config *cfg);
+void server_stop(struct server *srv);
+void server_wait(struct server *srv);
 
 
 // pthread函数声明
 int pthread_create(pthread_t *thread, const pthread_attr_t *attr,
                   void *(*start_routine)(void*), void *arg);
 int pthread_join(pthread_t thread, void **retval);
+int pthread_detach(pthread_t thread);
+void pthread_exit(void *retval) __attribute__((noreturn));
+pthread_t pthread_self(void);
+int pthread_attr_init(pthread_attr_t *attr);
+int pthread_attr_destroy(pthread_attr_t *attr);
+int pthread_attr_setstacksize(pthread_attr_t *attr, size_t stacksize);
+int pthread_attr_getstacksize(const pthread_attr_t *attr, size_t *stacksize);
+int pthread_attr_setguardsize(pthread_attr_t *attr, size_t guardsize);
+int pthread_attr_getguardsize(const pthread_attr_t *attr, size_t *guardsize);
+int pthread_attr_setdetachstate(pthread_attr_t *attr, int detachstate);
+int pthread_attr_getdetachstate(const pthread_attr_t *attr, int *detachstate);
+int pthread_stack_cache_limit(int count);
 
 // 互斥锁相关函数声明
 int futex(volatile int *uaddr, int futex_op, int val,
@@ -225,6 +1063,89 @@ int futex(volatile int *uaddr, int futex_op, int val,
 int pthread_mutex_init(pthread_mutex_t *mutex, const pthread_mutexattr_t *attr);
 int pthread_mutex_lock(pthread_mutex_t *mutex);
 int pthread_mutex_unlock(pthread_mutex_t *mutex);
+void pthread_mutex_profile_dump(void);     // 需用-DMINI_LOCK_PROFILE编译
+void pthread_mutex_profile_reset(void);
+
+// 条件变量相关函数声明
+int pthread_cond_init(pthread_cond_t *cond, const pthread_condattr_t *attr);
+int pthread_cond_destroy(pthread_cond_t *cond);
+int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex);
+int pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex,
+                           const struct timespec *abstime);
+int pthread_cond_signal(pthread_cond_t *cond);
+int pthread_cond_broadcast(pthread_cond_t *cond);
+void __mini_mutex_lock_contended(pthread_mutex_t *mutex);
+
+// 读写锁相关函数声明
+int pthread_rwlockattr_init(pthread_rwlockattr_t *attr);
+int pthread_rwlockattr_destroy(pthread_rwlockattr_t *attr);
+int pthread_rwlockattr_setkind_np(pthread_rwlockattr_t *attr, int pref);
+int pthread_rwlockattr_getkind_np(const pthread_rwlockattr_t *attr, int *pref);
+int pthread_rwlock_init(pthread_rwlock_t *rwlock, const pthread_rwlockattr_t *attr);
+int pthread_rwlock_destroy(pthread_rwlock_t *rwlock);
+int pthread_rwlock_rdlock(pthread_rwlock_t *rwlock);
+int pthread_rwlock_tryrdlock(pthread_rwlock_t *rwlock);
+int pthread_rwlock_wrlock(pthread_rwlock_t *rwlock);
+int pthread_rwlock_trywrlock(pthread_rwlock_t *rwlock);
+int pthread_rwlock_unlock(pthread_rwlock_t *rwlock);
+
+// 自旋锁相关函数声明
+int pthread_spin_init(pthread_spinlock_t *lock, int pshared);
+int pthread_spin_destroy(pthread_spinlock_t *lock);
+int pthread_spin_lock(pthread_spinlock_t *lock);
+int pthread_spin_trylock(pthread_spinlock_t *lock);
+int pthread_spin_unlock(pthread_spinlock_t *lock);
+void mcs_lock_init(struct mcs_lock *lock);
+void mcs_lock_acquire(struct mcs_lock *lock, struct mcs_node *node);
+int mcs_lock_tryacquire(struct mcs_lock *lock, struct mcs_node *node);
+void mcs_lock_release(struct mcs_lock *lock, struct mcs_node *node);
+
+/*
+ * 线程描述符与线程局部存储(TLS)
+ *
+ * 每个线程的描述符紧挨在线程指针TPIDR_EL0下方，线程指针之上是16字节的TCB
+ * 和可执行文件PT_TLS段的副本(aarch64采用variant I布局)：
+ *
+ *   [struct mini_thread][TCB 16字节][.tdata | .tbss]
+ *                       ^TPIDR_EL0
+ *
+ * 编译器按这个布局访问__thread变量，线程自身的数据用一条mrs指令即可取到。
+ * mini_libc自身不使用__thread(动态库版本没有TLS重定位支持)，
+ * 而是把每线程数据放在描述符里。
+ */
+struct mini_thread
+{
+    struct mini_thread *self;   /* 指向自身 */
+    int tid;                    /* 内核线程ID，创建时由内核写入 */
+    int err;                    /* 本线程的mini_errno */
+    void *map_base;             /* 描述符所在映射(线程为栈映射)，主线程为NULL */
+    size_t map_size;
+    size_t guard_size;          /* 栈映射底部保护页大小 */
+    void *result;               /* 线程返回值，pthread_join在tid清零后读取 */
+    int detach_state;           /* 可join/已分离/正在退出 */
+    void *pool_worker;          /* 线程池工作线程的私有数据，其他线程为NULL */
+} __attribute__((aligned(16)));
+
+/**
+ * 取当前线程的描述符
+ */
+static inline struct mini_thread *mini_thread_self(void)
+{
+    char *tp;
+    // 线程指针在线程生命周期内不变，不加volatile以便编译器合并多次读取
+    asm("mrs %0, tpidr_el0" : "=r"(tp));
+    return (struct mini_thread *)(tp - sizeof(struct mini_thread));
+}
+
+// TLS初始化函数声明
+void __mini_tls_init(void);
+size_t __mini_tls_area_size(void);
+struct mini_thread *__mini_tls_setup(void *base, size_t size);
+void *__mini_thread_tp(struct mini_thread *t);
+
+// 最近一次失败的系统调用的错误码(正值)，每个线程各有一份
+#define mini_errno (mini_thread_self()->err)
+int *__mini_errno_location(void);
 
 // 添加错误码定义
 #define MINI_EBUSY    1
@@ -234,13 +1155,510 @@ int pthread_mutex_unlock(pthread_mutex_t *mutex);
 // 系统调用声明
 int gettid(void);
 
+/*
+ * 工作窃取线程池
+ *
+ * 每个工作线程有一个Chase-Lev双端队列：自己在底部压入和弹出(LIFO，缓存热)，
+ * 空闲线程从其他队列的顶部窃取(FIFO，窃取到的通常是较大的任务)。
+ * 找不到任务的线程短暂自旋后在futex上休眠，有新任务时才唤醒。
+ *
+ * 任务由调用者提供(通常在栈上)，spawn之后必须sync，sync返回前任务对象要保持有效。
+ * 非工作线程提交的任务进入共享的注入队列，sync时在futex上等待完成。
+ */
+#define THREAD_POOL_MAX_WORKERS 64
+
+struct pool_task
+{
+    void (*fn)(void *arg);
+    void *arg;
+    volatile int state;         /* 0未完成，1已完成，2未完成且有线程在futex上等待 */
+    struct pool_task *next;     /* 注入队列链接 */
+};
+
+struct pool_worker;
+
+struct thread_pool
+{
+    struct pool_worker *workers;    /* 工作线程数据，一次mmap分配 */
+    size_t workers_size;
+    int nworkers;
+    volatile int work_seq __attribute__((aligned(64)));  /* 有新任务时加1，休眠的线程在其上等待 */
+    volatile int sleepers;      /* 在work_seq上休眠的线程数 */
+    volatile int searching;     /* 正在自旋窃取的线程数，不为0时提交任务不需要唤醒 */
+    volatile int stop;
+    pthread_mutex_t inject_lock;
+    struct pool_task *inject_head;
+    struct pool_task *inject_tail;
+    volatile int inject_count;
+};
+
+typedef void (*pool_for_fn)(void *arg, long begin, long end);
+typedef long (*pool_reduce_fn)(void *arg, long begin, long end);
+typedef long (*pool_combine_fn)(void *arg, long a, long b);
+
+// 线程池函数声明，失败返回-1并设置mini_errno
+int thread_pool_init(struct thread_pool *pool, int nthreads);
+void thread_pool_destroy(struct thread_pool *pool);
+void thread_pool_spawn(struct thread_pool *pool, struct pool_task *task, void (*fn)(void *), void *arg);
+void thread_pool_sync(struct thread_pool *pool, struct pool_task *task);
+void parallel_for(struct thread_pool *pool, long begin, long end, long grain,
+                  pool_for_fn fn, void *arg);
+long parallel_reduce(struct thread_pool *pool, long begin, long end, long grain, long identity,
+                     pool_reduce_fn fn, pool_combine_fn combine, void *arg);
+
+/*
+ * io_uring 相关定义
+ *
+ * 与内核ABI(include/uapi/linux/io_uring.h)保持一致，
+ * 在此基础上提供一个不依赖glibc的精简版liburing接口。
+ */
+
+/* io_uring_setup 标志位 */
+#define IORING_SETUP_IOPOLL     (1U << 0)   /* 轮询完成 */
+#define IORING_SETUP_SQPOLL     (1U << 1)   /* 内核线程轮询提交队列 */
+#define IORING_SETUP_SQ_AFF     (1U << 2)   /* sq_thread_cpu 有效 */
+#define IORING_SETUP_CQSIZE     (1U << 3)   /* cq_entries 有效 */
+
+/* io_uring_params.features */
+#define IORING_FEAT_SINGLE_MMAP (1U << 0)   /* SQ/CQ 环共用一次mmap */
+
+/* 环的mmap偏移 */
+#define IORING_OFF_SQ_RING      0ULL
+#define IORING_OFF_CQ_RING      0x8000000ULL
+#define IORING_OFF_SQES         0x10000000ULL
+
+/* io_uring_enter 标志位 */
+#define IORING_ENTER_GETEVENTS  (1U << 0)
+#define IORING_ENTER_SQ_WAKEUP  (1U << 1)
+
+/* sq_ring->flags */
+#define IORING_SQ_NEED_WAKEUP   (1U << 0)   /* SQPOLL线程已休眠，需要唤醒 */
+
+/* sqe->flags */
+#define IOSQE_FIXED_FILE        (1U << 0)   /* fd 为已注册文件的下标 */
+#define IOSQE_IO_DRAIN          (1U << 1)
+#define IOSQE_IO_LINK           (1U << 2)
+
+/* io_uring_register 操作码 */
+#define IORING_REGISTER_BUFFERS     0
+#define IORING_UNREGISTER_BUFFERS   1
+#define IORING_REGISTER_FILES       2
+#define IORING_UNREGISTER_FILES     3
+
+/* 请求操作码 */
+enum
+{
+    IORING_OP_NOP = 0,
+    IORING_OP_READV,
+    IORING_OP_WRITEV,
+    IORING_OP_FSYNC,
+    IORING_OP_READ_FIXED,
+    IORING_OP_WRITE_FIXED,
+    IORING_OP_POLL_ADD,
+    IORING_OP_POLL_REMOVE,
+    IORING_OP_SYNC_FILE_RANGE,
+    IORING_OP_SENDMSG,
+    IORING_OP_RECVMSG,
+    IORING_OP_TIMEOUT,
+    IORING_OP_TIMEOUT_REMOVE,
+    IORING_OP_ACCEPT,
+    IORING_OP_ASYNC_CANCEL,
+    IORING_OP_LINK_TIMEOUT,
+    IORING_OP_CONNECT,
+    IORING_OP_FALLOCATE,
+    IORING_OP_OPENAT,
+    IORING_OP_CLOSE,
+    IORING_OP_FILES_UPDATE,
+    IORING_OP_STATX,
+    IORING_OP_READ,
+    IORING_OP_WRITE,
+    IORING_OP_FADVISE,
+    IORING_OP_MADVISE,
+    IORING_OP_SEND,
+    IORING_OP_RECV,
+};
+
+/* 提交队列项(64字节) */
+struct io_uring_sqe
+{
+    uint8_t  opcode;        /* 操作码 IORING_OP_xxx */
+    uint8_t  flags;         /* IOSQE_xxx */
+    uint16_t ioprio;
+    int32_t  fd;            /* 文件描述符或已注册文件下标 */
+    union
+    {
+        uint64_t off;       /* 文件偏移 */
+        uint64_t addr2;
+    };
+    uint64_t addr;          /* 缓冲区地址/路径 */
+    uint32_t len;           /* 缓冲区长度 */
+    union
+    {
+        int      rw_flags;
+        uint32_t fsync_flags;
+        uint32_t msg_flags;
+        uint32_t accept_flags;
+        uint32_t open_flags;
+    };
+    uint64_t user_data;     /* 原样带回到完成项 */
+    union
+    {
+        uint16_t buf_index; /* 已注册缓冲区下标 */
+        uint16_t buf_group;
+    } __attribute__((packed));
+    uint16_t personality;
+    int32_t  splice_fd_in;
+    uint64_t __pad2[2];
+};
+
+/* 完成队列项 */
+struct io_uring_cqe
+{
+    uint64_t user_data;     /* 对应sqe的user_data */
+    int32_t  res;           /* 结果，<0 为 -errno */
+    uint32_t flags;
+};
+
+struct io_sqring_offsets
+{
+    uint32_t head;
+    uint32_t tail;
+    uint32_t ring_mask;
+    uint32_t ring_entries;
+    uint32_t flags;
+    uint32_t dropped;
+    uint32_t array;
+    uint32_t resv1;
+    uint64_t resv2;
+};
+
+struct io_cqring_offsets
+{
+    uint32_t head;
+    uint32_t tail;
+    uint32_t ring_mask;
+    uint32_t ring_entries;
+    uint32_t overflow;
+    uint32_t cqes;
+    uint32_t flags;
+    uint32_t resv1;
+    uint64_t resv2;
+};
+
+struct io_uring_params
+{
+    uint32_t sq_entries;
+    uint32_t cq_entries;
+    uint32_t flags;
+    uint32_t sq_thread_cpu;
+    uint32_t sq_thread_idle;    /* SQPOLL线程空闲多少毫秒后休眠 */
+    uint32_t features;
+    uint32_t wq_fd;
+    uint32_t resv[3];
+    struct io_sqring_offsets sq_off;
+    struct io_cqring_offsets cq_off;
+};
+
+/* 用户态视角的提交队列，k前缀的成员指向与内核共享的环 */
+struct io_uring_sq
+{
+    volatile uint32_t *khead;
+    volatile uint32_t *ktail;
+    uint32_t *kring_mask;
+    uint32_t *kring_entries;
+    volatile uint32_t *kflags;
+    uint32_t *kdropped;
+    uint32_t *array;
+    struct io_uring_sqe *sqes;
+
+    uint32_t sqe_head;      /* 已取出但尚未提交给内核的第一个sqe */
+    uint32_t sqe_tail;      /* 下一个可取出的sqe */
+
+    size_t ring_sz;
+    void *ring_ptr;
+};
+
+/* 用户态视角的完成队列 */
+struct io_uring_cq
+{
+    volatile uint32_t *khead;
+    volatile uint32_t *ktail;
+    uint32_t *kring_mask;
+    uint32_t *kring_entries;
+    uint32_t *koverflow;
+    struct io_uring_cqe *cqes;
+
+    size_t ring_sz;
+    void *ring_ptr;
+};
+
+struct io_uring
+{
+    struct io_uring_sq sq;
+    struct io_uring_cq cq;
+    uint32_t flags;         /* io_uring_setup 标志位 */
+    int ring_fd;
+};
+
+// io_uring函数声明，失败时返回负的错误码(-errno)，与liburing一致
+int io_uring_setup(uint32_t entries, struct io_uring_params *p);
+int io_uring_enter(int fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags);
+int io_uring_register(int fd, uint32_t opcode, const void *arg, uint32_t nr_args);
+int io_uring_queue_init(uint32_t entries, struct io_uring *ring, uint32_t flags);
+int io_uring_queue_init_params(uint32_t entries, struct io_uring *ring, struct io_uring_params *p);
+void io_uring_queue_exit(struct io_uring *ring);
+struct io_uring_sqe *io_uring_get_sqe(struct io_uring *ring);
+int io_uring_submit(struct io_uring *ring);
+int io_uring_submit_and_wait(struct io_uring *ring, uint32_t wait_nr);
+int io_uring_peek_cqe(struct io_uring *ring, struct io_uring_cqe **cqe_ptr);
+int io_uring_wait_cqe(struct io_uring *ring, struct io_uring_cqe **cqe_ptr);
+void io_uring_cqe_seen(struct io_uring *ring, struct io_uring_cqe *cqe);
+int io_uring_register_buffers(struct io_uring *ring, const struct iovec *iovecs, uint32_t nr_iovecs);
+int io_uring_unregister_buffers(struct io_uring *ring);
+int io_uring_register_files(struct io_uring *ring, const int *files, uint32_t nr_files);
+int io_uring_unregister_files(struct io_uring *ring);
+
+/* 通用sqe填充 */
+static inline void io_uring_prep_rw(int op, struct io_uring_sqe *sqe, int fd,
+                                    const void *addr, uint32_t len, uint64_t offset)
+{
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = (uint8_t)op;
+    sqe->fd = fd;
+    sqe->off = offset;
+    sqe->addr = (uint64_t)addr;
+    sqe->len = len;
+}
+
+static inline void io_uring_prep_nop(struct io_uring_sqe *sqe)
+{
+    io_uring_prep_rw(IORING_OP_NOP, sqe, -1, NULL, 0, 0);
+}
+
+static inline void io_uring_prep_read(struct io_uring_sqe *sqe, int fd,
+                                      void *buf, uint32_t nbytes, uint64_t offset)
+{
+    io_uring_prep_rw(IORING_OP_READ, sqe, fd, buf, nbytes, offset);
+}
+
+static inline void io_uring_prep_write(struct io_uring_sqe *sqe, int fd,
+                                       const void *buf, uint32_t nbytes, uint64_t offset)
+{
+    io_uring_prep_rw(IORING_OP_WRITE, sqe, fd, buf, nbytes, offset);
+}
+
+/* 使用io_uring_register_buffers注册过的缓冲区，buf_index为注册时的下标 */
+static inline void io_uring_prep_read_fixed(struct io_uring_sqe *sqe, int fd, void *buf,
+                                            uint32_t nbytes, uint64_t offset, int buf_index)
+{
+    io_uring_prep_rw(IORING_OP_READ_FIXED, sqe, fd, buf, nbytes, offset);
+    sqe->buf_index = (uint16_t)buf_index;
+}
+
+static inline void io_uring_prep_write_fixed(struct io_uring_sqe *sqe, int fd, const void *buf,
+                                             uint32_t nbytes, uint64_t offset, int buf_index)
+{
+    io_uring_prep_rw(IORING_OP_WRITE_FIXED, sqe, fd, buf, nbytes, offset);
+    sqe->buf_index = (uint16_t)buf_index;
+}
+
+static inline void io_uring_prep_send(struct io_uring_sqe *sqe, int sockfd,
+                                      const void *buf, size_t len, int flags)
+{
+    io_uring_prep_rw(IORING_OP_SEND, sqe, sockfd, buf, (uint32_t)len, 0);
+    sqe->msg_flags = (uint32_t)flags;
+}
+
+static inline void io_uring_prep_recv(struct io_uring_sqe *sqe, int sockfd,
+                                      void *buf, size_t len, int flags)
+{
+    io_uring_prep_rw(IORING_OP_RECV, sqe, sockfd, buf, (uint32_t)len, 0);
+    sqe->msg_flags = (uint32_t)flags;
+}
+
+static inline void io_uring_prep_accept(struct io_uring_sqe *sqe, int fd,
+                                        struct sockaddr *addr, socklen_t *addrlen, int flags)
+{
+    io_uring_prep_rw(IORING_OP_ACCEPT, sqe, fd, addr, 0, (uint64_t)addrlen);
+    sqe->accept_flags = (uint32_t)flags;
+}
+
+static inline void io_uring_prep_openat(struct io_uring_sqe *sqe, int dfd,
+                                        const char *path, int flags, int mode)
+{
+    io_uring_prep_rw(IORING_OP_OPENAT, sqe, dfd, path, (uint32_t)mode, 0);
+    sqe->open_flags = (uint32_t)flags;
+}
+
+static inline void io_uring_prep_close(struct io_uring_sqe *sqe, int fd)
+{
+    io_uring_prep_rw(IORING_OP_CLOSE, sqe, fd, NULL, 0, 0);
+}
+
+static inline void io_uring_sqe_set_data(struct io_uring_sqe *sqe, void *data)
+{
+    sqe->user_data = (uint64_t)data;
+}
+
+static inline void *io_uring_cqe_get_data(const struct io_uring_cqe *cqe)
+{
+    return (void *)cqe->user_data;
+}
+
+/*
+ * 日志模块
+ *
+ * 每个模块拥有独立的运行期日志级别，调用点只需读取一次level并比较，
+ * 即一次可预测的分支。模块对象统一放在 mini_log_modules 段中，
+ * 按名字调整级别时由链接器生成的 __start/__stop 符号遍历。
+ *
+ * 使用方法：
+ *   - 在某个.c文件中 LOG_MODULE_DEFINE(net) 定义模块
+ *   - 在使用该模块的.c文件中，包含本头文件之前 #define LOG_MODULE net
+ *   - 未定义LOG_MODULE的文件归属 default 模块
+ */
+struct log_module
+{
+    volatile int level;     // 当前生效的最低级别
+    int overridden;         // 是否被log_set_module_level单独设置过
+    const char *name;       // 模块名
+};
+
+/*
+ * 日志调用点静态描述符
+ *
+ * 每个LOG_xxx调用点展开出一个静态实例，文件名、函数名、行号在编译期确定，
+ * 去掉路径的文件名在该调用点首次输出时计算一次并缓存。
+ */
+struct log_site
+{
+    struct log_module *module;  // 所属模块
+    const char *file;           // __FILE__ 完整路径
+    const char *basename;       // 缓存的文件名，首次输出前为NULL
+    const char *func;           // 函数名
+    int line;                   // 行号
+    int level;                  // 日志级别
+};
+
+/*
+ * 调用点限流/采样状态
+ *
+ * 每个限流或采样调用点一个静态实例，只通过原子操作更新，无锁。
+ * window 高32位为当前时间窗口编号，低32位为该窗口内已输出条数，
+ * 用一次CAS同时完成"窗口切换+令牌补满"。
+ */
+struct log_ratelimit
+{
+    volatile unsigned long window;      // (窗口编号 << 32) | 窗口内已输出条数
+    volatile unsigned int suppressed;   // 自上次输出以来被抑制的条数
+    volatile unsigned int seq;          // 采样序号
+};
+
+#define LOG_MODULE_SECTION "mini_log_modules"
+
+#define LOG_MODULE_DEFINE(mod) \
+    struct log_module log_module_##mod \
+    __attribute__((used, section(LOG_MODULE_SECTION), aligned(8))) = { LOG_LEVEL_DEBUG, 0, #mod }
+
+#ifndef LOG_MODULE
+#define LOG_MODULE default
+#endif
+
+#define __LOG_MODULE_SYM_(mod) log_module_##mod
+#define __LOG_MODULE_SYM(mod)  __LOG_MODULE_SYM_(mod)
+#define __LOG_MODULE_VAR       __LOG_MODULE_SYM(LOG_MODULE)
+
+extern struct log_module __LOG_MODULE_VAR;
+
 // 日志相关函数声明
 void set_log_level(int level);
+int log_set_module_level(const char *name, int level);
 void log_output(int level, const char *file, const char *func, int line, const char *fmt, ...);
+void log_site_output(struct log_site *site, const char *fmt, ...);
+int log_ratelimit_pass(struct log_site *site, struct log_ratelimit *rl,
+                       unsigned int burst, unsigned int interval_ms);
+int log_sample_pass(struct log_ratelimit *rl, unsigned int one_in_n);
+
+/*
+ * 调用点展开：静态描述符 + 一次模块级别比较，
+ * 通过检查后才进入log_site_output做格式化。
+ */
+#define __LOG_AT(lvl, fmt, ...)                                             \
+    do                                                                      \
+    {                                                                       \
+        static struct log_site __log_site = {                               \
+            &__LOG_MODULE_VAR, __FILE__, NULL, __func__, __LINE__, (lvl)    \
+        };                                                                  \
+        if ((lvl) >= __LOG_MODULE_VAR.level)                                \
+        {                                                                   \
+            log_site_output(&__log_site, fmt, ##__VA_ARGS__);               \
+        }                                                                   \
+    } while (0)
+
+/*
+ * 限流调用点：每个调用点每interval_ms毫秒最多输出burst条，
+ * 被抑制的条数在下一次恢复输出时以"suppressed K messages"汇总打印。
+ */
+#define __LOG_AT_RATELIMIT(lvl, burst, interval_ms, fmt, ...)              \
+    do                                                                      \
+    {                                                                       \
+        static struct log_site __log_site = {                               \
+            &__LOG_MODULE_VAR, __FILE__, NULL, __func__, __LINE__, (lvl)    \
+        };                                                                  \
+        static struct log_ratelimit __log_rl;                               \
+        if ((lvl) >= __LOG_MODULE_VAR.level &&                              \
+            log_ratelimit_pass(&__log_site, &__log_rl, (burst), (interval_ms))) \
+        {                                                                   \
+            log_site_output(&__log_site, fmt, ##__VA_ARGS__);               \
+        }                                                                   \
+    } while (0)
+
+/*
+ * 采样调用点：平均每one_in_n条输出一条，按调用点独立采样。
+ */
+#define __LOG_AT_SAMPLED(lvl, one_in_n, fmt, ...)                           \
+    do                                                                      \
+    {                                                                       \
+        static struct log_site __log_site = {                               \
+            &__LOG_MODULE_VAR, __FILE__, NULL, __func__, __LINE__, (lvl)    \
+        };                                                                  \
+        static struct log_ratelimit __log_rl;                               \
+        if ((lvl) >= __LOG_MODULE_VAR.level &&                              \
+            log_sample_pass(&__log_rl, (one_in_n)))                         \
+        {                                                                   \
+            log_site_output(&__log_site, fmt, ##__VA_ARGS__);               \
+        }                                                                   \
+    } while (0)
+
+// 日志宏定义，低于LOG_COMPILE_LEVEL的级别展开为空语句
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(fmt, ...) __LOG_AT(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG_RATELIMIT(burst, ms, fmt, ...) __LOG_AT_RATELIMIT(LOG_LEVEL_DEBUG, burst, ms, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG_SAMPLED(n, fmt, ...) __LOG_AT_SAMPLED(LOG_LEVEL_DEBUG, n, fmt, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(fmt, ...) do { } while (0)
+#define LOG_DEBUG_RATELIMIT(burst, ms, fmt, ...) do { } while (0)
+#define LOG_DEBUG_SAMPLED(n, fmt, ...) do { } while (0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(fmt, ...)  __LOG_AT(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define LOG_INFO_RATELIMIT(burst, ms, fmt, ...) __LOG_AT_RATELIMIT(LOG_LEVEL_INFO, burst, ms, fmt, ##__VA_ARGS__)
+#define LOG_INFO_SAMPLED(n, fmt, ...) __LOG_AT_SAMPLED(LOG_LEVEL_INFO, n, fmt, ##__VA_ARGS__)
+#else
+#define LOG_INFO(fmt, ...)  do { } while (0)
+#define LOG_INFO_RATELIMIT(burst, ms, fmt, ...) do { } while (0)
+#define LOG_INFO_SAMPLED(n, fmt, ...) do { } while (0)
+#endif
 
-// 日志宏定义
-#define LOG_DEBUG(fmt, ...) log_output(LOG_LEVEL_DEBUG, __FILE__, __func__, __LINE__, fmt, ##__VA_ARGS__)
-#define LOG_INFO(fmt, ...)  log_output(LOG_LEVEL_INFO, __FILE__, __func__, __LINE__, fmt, ##__VA_ARGS__)
-#define LOG_ERROR(fmt, ...) log_output(LOG_LEVEL_ERROR, __FILE__, __func__, __LINE__, fmt, ##__VA_ARGS__)
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(fmt, ...) __LOG_AT(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#define LOG_ERROR_RATELIMIT(burst, ms, fmt, ...) __LOG_AT_RATELIMIT(LOG_LEVEL_ERROR, burst, ms, fmt, ##__VA_ARGS__)
+#define LOG_ERROR_SAMPLED(n, fmt, ...) __LOG_AT_SAMPLED(LOG_LEVEL_ERROR, n, fmt, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(fmt, ...) do { } while (0)
+#define LOG_ERROR_RATELIMIT(burst, ms, fmt, ...) do { } while (0)
+#define LOG_ERROR_SAMPLED(n, fmt, ...) do { } while (0)
+#endif
 
 #endif
\ No newline at end of file
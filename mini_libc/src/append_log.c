@@ -0,0 +1,257 @@
+/**
+ * append_log.c - 预分配、提前回写、批量落盘的只追加日志
+ *
+ * 直接对O_APPEND文件write再fsync有几处延迟不可控：
+ * - 每次追加都扩展文件，文件系统要分配块并修改元数据，fsync时一并提交日志
+ * - 脏页全部攒到fsync时才回写，一次fsync要等待的数据量没有上限
+ * - 每个提交者各自fsync，并发提交时设备被一串串小的刷新请求占满
+ *
+ * 这里的做法：
+ * - fallocate(FALLOC_FL_KEEP_SIZE)按大块提前预分配，追加只写入已分配的块
+ * - 每积累writeback_size字节就用sync_file_range异步启动回写，
+ *   fdatasync时剩下的脏页始终有界
+ * - group commit：同一时刻只有一个线程执行fdatasync，它覆盖开始时已写入的全部数据，
+ *   其他提交者在futex上等待，醒来后多数已经落盘，不需要再各自fdatasync
+ * - 已落盘的数据用posix_fadvise(DONTNEED)从页缓存丢弃，日志不会挤掉热数据
+ */
+
+#include "mini_lib.h"
+#include "mini_atomic.h"
+
+#define APPEND_LOG_PAGE     4096
+
+/**
+ * 打开或创建日志文件，新记录追加在现有内容之后
+ *
+ * @param log: 日志对象
+ * @param path: 文件路径
+ * @param cfg: 配置，NULL表示全部使用默认值
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int append_log_open(struct append_log *log, const char *path, const struct append_log_config *cfg)
+{
+    struct stat st;
+
+    memset(log, 0, sizeof(*log));
+    pthread_mutex_init(&log->lock, NULL);
+    if (cfg != NULL)
+    {
+        log->cfg = *cfg;
+    }
+    if (log->cfg.prealloc_size == 0)
+    {
+        log->cfg.prealloc_size = APPEND_LOG_DEFAULT_PREALLOC;
+    }
+    if (log->cfg.writeback_size == 0)
+    {
+        log->cfg.writeback_size = APPEND_LOG_DEFAULT_WRITEBACK;
+    }
+
+    log->fd = open(path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (log->fd < 0)
+    {
+        mini_errno = -log->fd;
+        return -1;
+    }
+
+    if (fstat(log->fd, &st) < 0)
+    {
+        int err = mini_errno;
+        close(log->fd);
+        mini_errno = err;
+        return -1;
+    }
+
+    log->written = st.st_size;
+    log->alloc_end = st.st_size;
+    log->kicked = st.st_size;
+    log->synced = st.st_size;
+    log->dropped = st.st_size & ~(off_t)(APPEND_LOG_PAGE - 1);
+    return 0;
+}
+
+/**
+ * 保证end之后还有至少半个预分配块的空间，调用者持有log->lock
+ *
+ * 提前扩展使得真正写到这些块时不再需要分配；
+ * 文件系统不支持fallocate时只记录位置，追加照常进行。
+ */
+static void append_log_prealloc(struct append_log *log, off_t end)
+{
+    off_t want = end + (off_t)(log->cfg.prealloc_size / 2);
+
+    if (want <= log->alloc_end)
+    {
+        return;
+    }
+
+    want = log->alloc_end + log->cfg.prealloc_size;
+    if (want < end)
+    {
+        want = end + log->cfg.prealloc_size;
+    }
+    if (fallocate(log->fd, FALLOC_FL_KEEP_SIZE, log->alloc_end, want - log->alloc_end) < 0 &&
+        mini_errno != EOPNOTSUPP)
+    {
+        LOG_ERROR("append log fd %d: fallocate failed, errno=%d", log->fd, mini_errno);
+    }
+    log->alloc_end = want;
+}
+
+/**
+ * 追加一条记录
+ *
+ * 数据写入页缓存后即返回，需要持久化时用返回值调用append_log_sync。
+ *
+ * @return: 成功返回记录结尾在日志中的偏移(LSN)，失败返回-1并设置mini_errno
+ */
+off_t append_log_append(struct append_log *log, const void *data, size_t len)
+{
+    const char *p = (const char *)data;
+    size_t left = len;
+    off_t offset, end;
+
+    pthread_mutex_lock(&log->lock);
+
+    offset = log->written;
+    end = offset + len;
+    append_log_prealloc(log, end);
+
+    while (left > 0)
+    {
+        ssize_t n = pwrite64(log->fd, p, left, offset);
+        if (n < 0)
+        {
+            int err;
+
+            if (mini_errno == EINTR)
+            {
+                continue;
+            }
+            // 已写入的部分不计入日志，下一条记录会覆盖它
+            err = mini_errno;
+            pthread_mutex_unlock(&log->lock);
+            mini_errno = err;
+            return -1;
+        }
+        p += n;
+        left -= n;
+        offset += n;
+    }
+    mini_atomic_store(&log->written, end, MINI_ATOMIC_RELEASE);
+
+    // 攒够一批就异步启动回写，把回写分摊到追加过程中
+    if (end - log->kicked >= (off_t)log->cfg.writeback_size)
+    {
+        sync_file_range(log->fd, log->kicked, end - log->kicked, SYNC_FILE_RANGE_WRITE);
+        log->kicked = end;
+    }
+
+    pthread_mutex_unlock(&log->lock);
+    return end;
+}
+
+/**
+ * 执行一次fdatasync，覆盖开始时已写入页缓存的全部数据
+ *
+ * 只由拿到syncing的线程调用，dropped只在这里修改。
+ */
+static int append_log_do_sync(struct append_log *log)
+{
+    off_t target = mini_atomic_load(&log->written, MINI_ATOMIC_ACQUIRE);
+
+    if (fdatasync(log->fd) < 0)
+    {
+        return -1;
+    }
+    log->syncs++;
+    mini_atomic_store(&log->synced, target, MINI_ATOMIC_RELEASE);
+
+    if (log->cfg.drop_cache)
+    {
+        off_t end = target & ~(off_t)(APPEND_LOG_PAGE - 1);
+        if (end > log->dropped)
+        {
+            posix_fadvise(log->fd, log->dropped, end - log->dropped, POSIX_FADV_DONTNEED);
+            log->dropped = end;
+        }
+    }
+    return 0;
+}
+
+/**
+ * 等待日志中lsn之前的数据落盘
+ *
+ * 没有线程在落盘时由调用者执行fdatasync；已有线程在落盘时等它完成，
+ * 它覆盖的范围不够再由某个等待者发起下一次。
+ *
+ * @param lsn: append_log_append返回的偏移
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int append_log_sync(struct append_log *log, off_t lsn)
+{
+    mini_atomic_fetch_add(&log->commits, 1, MINI_ATOMIC_RELAXED);
+
+    for (;;)
+    {
+        int seq;
+
+        if (mini_atomic_load(&log->synced, MINI_ATOMIC_ACQUIRE) >= lsn)
+        {
+            return 0;
+        }
+
+        seq = mini_atomic_load(&log->sync_seq, MINI_ATOMIC_SEQ_CST);
+        if (mini_atomic_exchange(&log->syncing, 1, MINI_ATOMIC_ACQUIRE) == 0)
+        {
+            int ret = 0;
+            int err = 0;
+
+            if (mini_atomic_load(&log->synced, MINI_ATOMIC_ACQUIRE) < lsn)
+            {
+                ret = append_log_do_sync(log);
+                err = mini_errno;
+            }
+
+            mini_atomic_store(&log->syncing, 0, MINI_ATOMIC_RELEASE);
+            mini_atomic_fetch_add(&log->sync_seq, 1, MINI_ATOMIC_SEQ_CST);
+            if (mini_atomic_load(&log->waiters, MINI_ATOMIC_SEQ_CST) > 0)
+            {
+                futex(&log->sync_seq, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, FUTEX_WAKE_ALL, NULL, NULL, 0);
+            }
+
+            if (ret < 0)
+            {
+                mini_errno = err;
+                return -1;
+            }
+            continue;
+        }
+
+        // 有线程正在落盘，等它结束。sync_seq已变化时futex立即返回
+        mini_atomic_fetch_add(&log->waiters, 1, MINI_ATOMIC_SEQ_CST);
+        futex(&log->sync_seq, FUTEX_WAIT | FUTEX_PRIVATE_FLAG, seq, NULL, NULL, 0);
+        mini_atomic_fetch_sub(&log->waiters, 1, MINI_ATOMIC_SEQ_CST);
+    }
+}
+
+/**
+ * 把全部已追加的数据落盘并关闭日志
+ *
+ * 预分配但未使用的空间留在文件中，下次打开继续追加时使用。
+ *
+ * @return: 成功返回0，落盘失败返回-1并设置mini_errno，文件总会被关闭
+ */
+int append_log_close(struct append_log *log)
+{
+    int ret = append_log_sync(log, log->written);
+    int err = mini_errno;
+
+    close(log->fd);
+    log->fd = -1;
+    if (ret < 0)
+    {
+        mini_errno = err;
+    }
+    return ret;
+}
@@ -0,0 +1,71 @@
+/**
+ * auxv.c - 进程启动初始化与辅助向量(auxv)访问
+ *
+ * 内核启动进程时栈顶布局如下：
+ *
+ *   sp -> argc
+ *         argv[0] ... argv[argc-1], NULL
+ *         envp[0] ... envp[n-1], NULL
+ *         auxv[0] (type, value) ... (AT_NULL, 0)
+ *
+ * 入口_mini_libc_entry在调用main之前把初始sp传给__mini_libc_init，
+ * 这里记下环境变量和辅助向量的位置，并完成依赖它们的初始化(如TLS、vDSO)。
+ */
+
+#include "mini_lib.h"
+
+/* 环境变量表，以NULL结尾 */
+char **environ;
+
+/* 辅助向量，(类型, 值)成对排列，以AT_NULL结尾 */
+static unsigned long *g_auxv;
+
+/* CPU支持LSE原子指令时为1，mini_atomic.h据此选择指令 */
+int __mini_atomic_lse;
+
+/**
+ * C库启动初始化，由入口汇编在main之前调用
+ *
+ * @param sp: 进程入口处的栈指针
+ */
+void __mini_libc_init(long *sp)
+{
+    long argc = sp[0];
+    char **argv = (char **)(sp + 1);
+    char **envp = argv + argc + 1;
+
+    environ = envp;
+    while (*envp)
+    {
+        envp++;
+    }
+    g_auxv = (unsigned long *)(envp + 1);
+
+    // 之后的初始化都可能设置mini_errno(包括getauxval查不到时)，先布置好主线程的描述符和TLS。
+    // TLS初始化不使用原子操作，LSE检测放在它之后
+    __mini_tls_init();
+    __mini_atomic_lse = (getauxval(AT_HWCAP) & HWCAP_ATOMICS) != 0;
+    vdso_init(getauxval(AT_SYSINFO_EHDR));
+}
+
+/**
+ * 查询辅助向量中某一项的值
+ *
+ * @param type: AT_xxx
+ * @return: 对应的值，不存在时返回0并把mini_errno设为ENOENT
+ */
+unsigned long getauxval(unsigned long type)
+{
+    unsigned long *p;
+
+    for (p = g_auxv; p && p[0] != AT_NULL; p += 2)
+    {
+        if (p[0] == type)
+        {
+            return p[1];
+        }
+    }
+
+    mini_errno = ENOENT;
+    return 0;
+}
@@ -0,0 +1,405 @@
+/**
+ * bufio.c - 带缓冲的读取器与整文件只读映射
+ *
+ * buf_reader: 每次read系统调用尽量填满缓冲区，之后按行(memchr查找分隔符)
+ * 或按定长记录从缓冲区中取数据，逐行读取一个文件的系统调用次数
+ * 从每行一次降到每个缓冲区一次。
+ *
+ * mapped_file: 把整个文件只读映射进来，文件内容直接以data/len的形式使用，
+ * 省去read到用户缓冲区的拷贝；顺序扫描时配合MADV_SEQUENTIAL/MADV_WILLNEED
+ * 让内核提前预读并尽早回收扫过的页。
+ */
+
+#include "mini_lib.h"
+
+#define BUF_PAGE_SIZE       4096
+#define LINE_INITIAL_SIZE   128
+
+/**
+ * 调用read，被信号中断时重试
+ */
+static ssize_t buf_sys_read(int fd, void *dst, size_t len)
+{
+    ssize_t n;
+
+    do
+    {
+        n = read(fd, dst, len);
+    } while (n < 0 && mini_errno == EINTR);
+    return n;
+}
+
+/**
+ * 把未消费的数据挪到缓冲区开头，再读入数据填充剩余空间
+ *
+ * @return: 本次读入的字节数，已到文件末尾或缓冲区已满返回0，失败返回-1
+ */
+static ssize_t buf_fill(struct buf_reader *r)
+{
+    ssize_t n;
+
+    if (r->pos > 0)
+    {
+        if (r->end > r->pos)
+        {
+            memcpy(r->buf, r->buf + r->pos, r->end - r->pos);
+        }
+        r->end -= r->pos;
+        r->pos = 0;
+    }
+
+    if (r->eof || r->end == r->cap)
+    {
+        return 0;
+    }
+
+    n = buf_sys_read(r->fd, r->buf + r->end, r->cap - r->end);
+    if (n < 0)
+    {
+        return -1;
+    }
+    if (n == 0)
+    {
+        r->eof = 1;
+    }
+    r->end += n;
+    return n;
+}
+
+/**
+ * 初始化读取器
+ *
+ * @param r: 读取器
+ * @param fd: 要读取的文件描述符，读取器不负责关闭
+ * @param buf_size: 缓冲区大小，向上取整到页大小，0表示BUF_READER_DEFAULT_SIZE
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int buf_reader_init(struct buf_reader *r, int fd, size_t buf_size)
+{
+    void *buf;
+
+    if (buf_size == 0)
+    {
+        buf_size = BUF_READER_DEFAULT_SIZE;
+    }
+    buf_size = __MINI_ALIGN(buf_size, BUF_PAGE_SIZE);
+
+    buf = mmap(NULL, buf_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED || buf == NULL)
+    {
+        mini_errno = ENOMEM;
+        return -1;
+    }
+
+    r->fd = fd;
+    r->buf = buf;
+    r->cap = buf_size;
+    r->pos = 0;
+    r->end = 0;
+    r->eof = 0;
+    return 0;
+}
+
+/**
+ * 释放读取器的缓冲区，缓冲区中未消费的数据被丢弃
+ */
+void buf_reader_destroy(struct buf_reader *r)
+{
+    if (r->buf)
+    {
+        munmap(r->buf, r->cap);
+        r->buf = NULL;
+    }
+    r->pos = r->end = 0;
+}
+
+/**
+ * 读取最多len字节，语义同read
+ *
+ * 缓冲区为空且请求不小于缓冲区容量时直接读入dst，不经过缓冲区中转。
+ *
+ * @return: 读取的字节数，文件末尾返回0，失败返回-1并设置mini_errno
+ */
+ssize_t buf_read(struct buf_reader *r, void *dst, size_t len)
+{
+    size_t take;
+
+    if (len == 0)
+    {
+        return 0;
+    }
+
+    if (r->pos == r->end)
+    {
+        if (len >= r->cap && !r->eof)
+        {
+            ssize_t n = buf_sys_read(r->fd, dst, len);
+            if (n == 0)
+            {
+                r->eof = 1;
+            }
+            return n;
+        }
+        if (buf_fill(r) < 0)
+        {
+            return -1;
+        }
+        if (r->pos == r->end)
+        {
+            return 0;
+        }
+    }
+
+    take = r->end - r->pos;
+    if (take > len)
+    {
+        take = len;
+    }
+    memcpy(dst, r->buf + r->pos, take);
+    r->pos += take;
+    return (ssize_t)take;
+}
+
+/**
+ * 保证行缓冲区至少有need字节，不够时按2倍扩大，保留前used字节
+ */
+static int line_reserve(char **lineptr, size_t *n, size_t used, size_t need)
+{
+    size_t cap;
+    char *p;
+
+    if (*lineptr != NULL && *n >= need)
+    {
+        return 0;
+    }
+
+    cap = *n > 0 ? *n : LINE_INITIAL_SIZE;
+    while (cap < need)
+    {
+        cap *= 2;
+    }
+
+    p = malloc(cap);
+    if (p == NULL)
+    {
+        mini_errno = ENOMEM;
+        return -1;
+    }
+    if (*lineptr != NULL)
+    {
+        memcpy(p, *lineptr, used);
+        free(*lineptr);
+    }
+    *lineptr = p;
+    *n = cap;
+    return 0;
+}
+
+/**
+ * 读取一段以delim结尾的数据，参数约定与POSIX getdelim相同
+ *
+ * *lineptr为NULL或容量不够时用malloc分配/扩大，调用者用free释放。
+ * 结果包含分隔符并以'\0'结尾；文件最后一段没有分隔符时原样返回。
+ *
+ * @param r: 读取器
+ * @param lineptr: 行缓冲区指针，可指向NULL
+ * @param n: 行缓冲区容量
+ * @param delim: 分隔字节
+ * @return: 读到的字节数(不含'\0')，文件末尾返回0，失败返回-1并设置mini_errno
+ */
+ssize_t buf_getdelim(struct buf_reader *r, char **lineptr, size_t *n, int delim)
+{
+    size_t used = 0;
+
+    for (;;)
+    {
+        char *start;
+        char *hit;
+        size_t avail, take;
+
+        if (r->pos == r->end)
+        {
+            if (buf_fill(r) < 0)
+            {
+                return -1;
+            }
+            if (r->pos == r->end)
+            {
+                break;
+            }
+        }
+
+        start = r->buf + r->pos;
+        avail = r->end - r->pos;
+        hit = memchr(start, delim, avail);
+        take = hit ? (size_t)(hit - start) + 1 : avail;
+
+        if (line_reserve(lineptr, n, used, used + take + 1) < 0)
+        {
+            return -1;
+        }
+        memcpy(*lineptr + used, start, take);
+        used += take;
+        r->pos += take;
+
+        if (hit)
+        {
+            break;
+        }
+    }
+
+    if (*lineptr != NULL && *n > 0)
+    {
+        (*lineptr)[used] = '\0';
+    }
+    return (ssize_t)used;
+}
+
+/**
+ * 读取一行，包含结尾的'\n'，见buf_getdelim
+ */
+ssize_t buf_getline(struct buf_reader *r, char **lineptr, size_t *n)
+{
+    return buf_getdelim(r, lineptr, n, '\n');
+}
+
+/**
+ * 读取一条size字节的定长记录到rec
+ *
+ * @return: 成功返回size；文件末尾不足一条记录时返回实际读到的字节数，
+ *          正好在记录边界结束时返回0；失败返回-1并设置mini_errno
+ */
+ssize_t buf_read_record(struct buf_reader *r, void *rec, size_t size)
+{
+    size_t got = 0;
+
+    while (got < size)
+    {
+        ssize_t n = buf_read(r, (char *)rec + got, size - got);
+        if (n < 0)
+        {
+            return -1;
+        }
+        if (n == 0)
+        {
+            break;
+        }
+        got += n;
+    }
+    return (ssize_t)got;
+}
+
+/**
+ * 取下一条size字节的定长记录，不拷贝，直接返回指向缓冲区内部的指针
+ *
+ * 返回的指针在下一次调用该读取器的任何函数之前有效。
+ *
+ * @param size: 记录大小，不能超过缓冲区容量
+ * @return: 记录地址；文件末尾(包括末尾不足一条记录)返回NULL且r->eof非0，
+ *          失败返回NULL并设置mini_errno
+ */
+const void *buf_next_record(struct buf_reader *r, size_t size)
+{
+    const void *rec;
+
+    if (size == 0 || size > r->cap)
+    {
+        mini_errno = EINVAL;
+        return NULL;
+    }
+
+    while (r->end - r->pos < size)
+    {
+        // 记录跨越缓冲区尾部时buf_fill会先把剩余数据挪到开头
+        ssize_t n = buf_fill(r);
+        if (n < 0)
+        {
+            return NULL;
+        }
+        if (n == 0 && r->eof)
+        {
+            return NULL;
+        }
+    }
+
+    rec = r->buf + r->pos;
+    r->pos += size;
+    return rec;
+}
+
+/**
+ * 只读映射整个文件
+ *
+ * 映射建立后文件描述符随即关闭，映射本身保持对文件的引用。
+ * madvise只是建议，失败不影响映射的使用。
+ *
+ * @param mf: 输出文件内容的地址和长度
+ * @param path: 文件路径
+ * @param flags: MAPPED_FILE_*的组合
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int mapped_file_open(struct mapped_file *mf, const char *path, int flags)
+{
+    struct stat st;
+    void *data;
+    int fd;
+
+    mf->data = NULL;
+    mf->len = 0;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        mini_errno = -fd;
+        return -1;
+    }
+
+    if (fstat(fd, &st) < 0)
+    {
+        int err = mini_errno;
+        close(fd);
+        mini_errno = err;
+        return -1;
+    }
+
+    // 空文件无法映射，返回空区间
+    if (st.st_size == 0)
+    {
+        close(fd);
+        return 0;
+    }
+
+    data = mmap(NULL, st.st_size, PROT_READ,
+                MAP_PRIVATE | ((flags & MAPPED_FILE_POPULATE) ? MAP_POPULATE : 0), fd, 0);
+    close(fd);
+    if (data == MAP_FAILED || data == NULL)
+    {
+        return -1;
+    }
+
+    if (flags & MAPPED_FILE_SEQUENTIAL)
+    {
+        madvise(data, st.st_size, MADV_SEQUENTIAL);
+    }
+    if (flags & MAPPED_FILE_WILLNEED)
+    {
+        madvise(data, st.st_size, MADV_WILLNEED);
+    }
+
+    mf->data = data;
+    mf->len = st.st_size;
+    return 0;
+}
+
+/**
+ * 解除文件映射
+ */
+void mapped_file_close(struct mapped_file *mf)
+{
+    if (mf->data != NULL)
+    {
+        munmap((void *)mf->data, mf->len);
+        mf->data = NULL;
+        mf->len = 0;
+    }
+}
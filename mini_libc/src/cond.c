@@ -0,0 +1,155 @@
+/**
+ * cond.c - 条件变量实现
+ *
+ * 等待者记下seq后释放互斥锁，在seq上futex等待；signal/broadcast把seq加1，
+ * 期间有signal发生时futex会因为值已变化立即返回，不会丢失唤醒。
+ *
+ * broadcast不把等待者全部唤醒：被唤醒的线程第一件事就是抢同一把互斥锁，
+ * 全部唤醒只会让它们在锁上再排一次队。这里用FUTEX_CMP_REQUEUE只唤醒一个，
+ * 其余等待者在内核中直接转移到互斥锁的futex上，之后每次解锁唤醒一个。
+ * 为此被唤醒的等待者总是以状态2重新加锁(__mini_mutex_lock_contended)，
+ * 保证它解锁时会唤醒下一个转移过来的等待者。
+ */
+
+#include "mini_lib.h"
+#include "mini_atomic.h"
+
+#define COND_REQUEUE_ALL    0x7fffffff
+
+/**
+ * 初始化条件变量
+ */
+int pthread_cond_init(pthread_cond_t *cond, const pthread_condattr_t *attr)
+{
+    cond->seq = 0;
+    cond->waiters = 0;
+    cond->mutex = NULL;
+    return 0;
+}
+
+int pthread_cond_destroy(pthread_cond_t *cond)
+{
+    return 0;
+}
+
+/**
+ * 等待的公共部分
+ *
+ * @param abstime: CLOCK_REALTIME绝对超时时间，NULL表示一直等待
+ * @return: 被唤醒返回0，超时返回ETIMEDOUT；返回时总是重新持有互斥锁
+ */
+static int cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *abstime)
+{
+    int seq;
+    int ret;
+
+    if (mutex->owner != mini_thread_self()->tid)
+    {
+        return -1;
+    }
+
+    // 先登记再读seq：signal先加seq再看waiters，两边都是顺序一致的，
+    // signal看到waiters为0时这里一定读到了加1之后的seq
+    mini_atomic_fetch_add(&cond->waiters, 1, MINI_ATOMIC_SEQ_CST);
+    seq = mini_atomic_load(&cond->seq, MINI_ATOMIC_SEQ_CST);
+    cond->mutex = mutex;
+
+    pthread_mutex_unlock(mutex);
+
+    if (abstime == NULL)
+    {
+        ret = futex(&cond->seq, FUTEX_WAIT | FUTEX_PRIVATE_FLAG, seq, NULL, NULL, 0);
+    }
+    else
+    {
+        // FUTEX_WAIT的超时是相对时间，带FUTEX_CLOCK_REALTIME的BITSET等待直接接受绝对时间
+        ret = futex(&cond->seq, FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG | FUTEX_CLOCK_REALTIME,
+                    seq, abstime, NULL, FUTEX_BITSET_MATCH_ANY);
+    }
+
+    __mini_mutex_lock_contended(mutex);
+    mini_atomic_fetch_sub(&cond->waiters, 1, MINI_ATOMIC_SEQ_CST);
+
+    // EAGAIN/EINTR按虚假唤醒处理，调用者本来就要在循环中重新检查条件
+    return ret == -ETIMEDOUT ? ETIMEDOUT : 0;
+}
+
+/**
+ * 等待条件变量
+ *
+ * 调用时必须持有mutex，等待期间释放，返回时重新持有。可能虚假唤醒，
+ * 调用者应在循环中检查条件。
+ *
+ * @return: 成功返回0，调用者未持有mutex返回-1
+ */
+int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex)
+{
+    return cond_wait(cond, mutex, NULL);
+}
+
+/**
+ * 带超时地等待条件变量
+ *
+ * @param abstime: CLOCK_REALTIME绝对时间
+ * @return: 成功返回0，超时返回ETIMEDOUT，abstime非法返回EINVAL
+ */
+int pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex,
+                           const struct timespec *abstime)
+{
+    if (abstime->tv_nsec < 0 || abstime->tv_nsec >= 1000000000L)
+    {
+        return EINVAL;
+    }
+    if (abstime->tv_sec < 0)
+    {
+        return ETIMEDOUT;
+    }
+    return cond_wait(cond, mutex, abstime);
+}
+
+/**
+ * 唤醒一个等待者，没有等待者时不进入内核
+ */
+int pthread_cond_signal(pthread_cond_t *cond)
+{
+    mini_atomic_fetch_add(&cond->seq, 1, MINI_ATOMIC_SEQ_CST);
+    if (mini_atomic_load(&cond->waiters, MINI_ATOMIC_SEQ_CST) > 0)
+    {
+        futex(&cond->seq, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, 1, NULL, NULL, 0);
+    }
+    return 0;
+}
+
+/**
+ * 唤醒全部等待者
+ *
+ * 只唤醒一个，其余转移到互斥锁的futex上。seq在加1之后又被改动时
+ * FUTEX_CMP_REQUEUE返回EAGAIN，此时退回到全部唤醒。
+ */
+int pthread_cond_broadcast(pthread_cond_t *cond)
+{
+    pthread_mutex_t *mutex;
+    int seq;
+    int ret;
+
+    seq = mini_atomic_fetch_add(&cond->seq, 1, MINI_ATOMIC_SEQ_CST) + 1;
+    if (mini_atomic_load(&cond->waiters, MINI_ATOMIC_SEQ_CST) == 0)
+    {
+        return 0;
+    }
+
+    mutex = cond->mutex;
+    if (mutex != NULL)
+    {
+        // FUTEX_CMP_REQUEUE的val2(最多转移个数)借用timeout参数的位置传递
+        ret = futex(&cond->seq, FUTEX_CMP_REQUEUE | FUTEX_PRIVATE_FLAG, 1,
+                    (const struct timespec *)(long)COND_REQUEUE_ALL, (int *)&mutex->lock, seq);
+        if (ret >= 0)
+        {
+            return 0;
+        }
+    }
+
+    futex(&cond->seq, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, FUTEX_WAKE_ALL, NULL, NULL, 0);
+    return 0;
+}
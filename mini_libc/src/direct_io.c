@@ -0,0 +1,404 @@
+/**
+ * direct_io.c - O_DIRECT对齐I/O与对齐缓冲区池
+ *
+ * 大文件顺序写入走页缓存时，写过一次就不再读的数据会把热数据挤出缓存，
+ * 回写时机也由内核决定，吞吐忽高忽低。O_DIRECT让数据直接在用户缓冲区
+ * 和设备之间传输，代价是内存地址、文件偏移和长度都必须按块对齐：
+ * - 写方向：数据先攒进对齐的中转缓冲区，满一个缓冲区写一次；调用者本身
+ *   给出对齐的数据时跳过中转直接写。文件结尾不足一个对齐块的部分
+ *   在关闭时去掉O_DIRECT标志，走普通缓冲写。
+ * - 读方向：任意偏移和长度的请求被扩展到对齐边界读入中转缓冲区再拷出，
+ *   请求本身对齐时直接读入调用者的缓冲区。
+ *
+ * 文件系统不支持O_DIRECT(open返回EINVAL)时自动退回普通缓冲I/O。
+ */
+
+#include "mini_lib.h"
+
+#define DIO_ACCMODE     3
+#define DIO_MASK        ((size_t)DIO_ALIGN - 1)
+
+/**
+ * 申请按页对齐的内存，大小向上取整到DIO_ALIGN
+ */
+static void *dio_alloc(size_t size)
+{
+    void *p = mmap(NULL, __MINI_ALIGN(size, DIO_ALIGN), PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED || p == NULL)
+    {
+        mini_errno = ENOMEM;
+        return NULL;
+    }
+    return p;
+}
+
+/**
+ * 初始化对齐缓冲区池，所有缓冲区来自一次mmap
+ *
+ * @param pool: 缓冲区池
+ * @param buf_size: 每个缓冲区大小，向上取整到DIO_ALIGN
+ * @param count: 缓冲区个数
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int dio_pool_init(struct dio_pool *pool, size_t buf_size, int count)
+{
+    int i;
+
+    if (buf_size == 0 || count <= 0)
+    {
+        mini_errno = EINVAL;
+        return -1;
+    }
+
+    pool->buf_size = __MINI_ALIGN(buf_size, DIO_ALIGN);
+    pool->base = dio_alloc(pool->buf_size * count);
+    if (pool->base == NULL)
+    {
+        return -1;
+    }
+
+    pool->count = count;
+    pool->nfree = count;
+    pool->free_list = NULL;
+    for (i = count - 1; i >= 0; i--)
+    {
+        void *buf = pool->base + (size_t)i * pool->buf_size;
+        *(void **)buf = pool->free_list;
+        pool->free_list = buf;
+    }
+    return 0;
+}
+
+/**
+ * 从池中取一个缓冲区
+ *
+ * @return: DIO_ALIGN对齐的缓冲区，池已空返回NULL
+ */
+void *dio_pool_get(struct dio_pool *pool)
+{
+    void *buf = pool->free_list;
+
+    if (buf != NULL)
+    {
+        pool->free_list = *(void **)buf;
+        pool->nfree--;
+    }
+    return buf;
+}
+
+/**
+ * 把缓冲区还给池
+ */
+void dio_pool_put(struct dio_pool *pool, void *buf)
+{
+    *(void **)buf = pool->free_list;
+    pool->free_list = buf;
+    pool->nfree++;
+}
+
+/**
+ * 释放整个缓冲区池，取出未归还的缓冲区随之失效
+ */
+void dio_pool_destroy(struct dio_pool *pool)
+{
+    if (pool->base != NULL)
+    {
+        munmap(pool->base, pool->buf_size * pool->count);
+        pool->base = NULL;
+    }
+    pool->free_list = NULL;
+    pool->nfree = 0;
+}
+
+/**
+ * 在指定偏移写完len字节，处理短写
+ */
+static int dio_pwrite_all(int fd, const char *p, size_t len, off_t offset)
+{
+    while (len > 0)
+    {
+        ssize_t n = pwrite64(fd, p, len, offset);
+        if (n < 0)
+        {
+            if (mini_errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        len -= n;
+        offset += n;
+    }
+    return 0;
+}
+
+/**
+ * 打开文件进行直接I/O
+ *
+ * 带O_APPEND时从文件末尾继续写：末尾不足一个对齐块的部分先读回中转缓冲区，
+ * 之后与新数据一起按对齐块重写，因此访问模式会被提升为O_RDWR。
+ * 同一个dio_file只用于写(dio_write)或只用于读(dio_read/dio_pread)。
+ *
+ * @param f: 直接I/O文件
+ * @param path: 文件路径
+ * @param flags: open标志，O_DIRECT和O_CLOEXEC会自动加上，可带O_DSYNC
+ * @param mode: 创建文件时的权限
+ * @param buf_size: 中转缓冲区大小，向上取整到DIO_ALIGN，0表示DIO_DEFAULT_BUF_SIZE
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int dio_open(struct dio_file *f, const char *path, int flags, int mode, size_t buf_size)
+{
+    int append = flags & O_APPEND;
+
+    if (append)
+    {
+        flags = (flags & ~(O_APPEND | DIO_ACCMODE)) | O_RDWR;
+    }
+
+    f->direct = 1;
+    f->fd = open(path, flags | O_DIRECT | O_CLOEXEC, mode);
+    if (f->fd == -EINVAL)
+    {
+        // 文件系统不支持O_DIRECT
+        f->direct = 0;
+        f->fd = open(path, flags | O_CLOEXEC, mode);
+    }
+    if (f->fd < 0)
+    {
+        mini_errno = -f->fd;
+        return -1;
+    }
+
+    f->buf_size = __MINI_ALIGN(buf_size > 0 ? buf_size : DIO_DEFAULT_BUF_SIZE, DIO_ALIGN);
+    f->buf = dio_alloc(f->buf_size);
+    f->offset = 0;
+    f->fill = 0;
+    if (f->buf == NULL)
+    {
+        close(f->fd);
+        mini_errno = ENOMEM;
+        return -1;
+    }
+
+    if (append)
+    {
+        off_t size = lseek(f->fd, 0, SEEK_END);
+        size_t tail;
+
+        if (size < 0)
+        {
+            goto fail;
+        }
+        f->offset = size & ~(off_t)DIO_MASK;
+        tail = size - f->offset;
+        if (tail > 0 && pread64(f->fd, f->buf, DIO_ALIGN, f->offset) != (ssize_t)tail)
+        {
+            goto fail;
+        }
+        f->fill = tail;
+    }
+    return 0;
+
+fail:
+    {
+        int err = mini_errno;
+        munmap(f->buf, f->buf_size);
+        close(f->fd);
+        mini_errno = err;
+    }
+    return -1;
+}
+
+/**
+ * 顺序追加写
+ *
+ * 数据满一个中转缓冲区才真正写出，剩余部分在dio_close时写出。
+ * 中转缓冲区为空且data按DIO_ALIGN对齐时，对齐的整块直接从data写出，
+ * 例如直接写dio_pool中的缓冲区。
+ *
+ * @return: 成功返回len，失败返回-1并设置mini_errno
+ */
+ssize_t dio_write(struct dio_file *f, const void *data, size_t len)
+{
+    const char *p = (const char *)data;
+    size_t left = len;
+
+    while (left > 0)
+    {
+        size_t take;
+
+        if (f->fill == 0 && ((uintptr_t)p & DIO_MASK) == 0 && left >= DIO_ALIGN)
+        {
+            size_t n = left & ~DIO_MASK;
+            if (dio_pwrite_all(f->fd, p, n, f->offset) < 0)
+            {
+                return -1;
+            }
+            f->offset += n;
+            p += n;
+            left -= n;
+            continue;
+        }
+
+        take = f->buf_size - f->fill;
+        if (take > left)
+        {
+            take = left;
+        }
+        memcpy(f->buf + f->fill, p, take);
+        f->fill += take;
+        p += take;
+        left -= take;
+
+        if (f->fill == f->buf_size)
+        {
+            if (dio_pwrite_all(f->fd, f->buf, f->buf_size, f->offset) < 0)
+            {
+                return -1;
+            }
+            f->offset += f->buf_size;
+            f->fill = 0;
+        }
+    }
+    return (ssize_t)len;
+}
+
+/**
+ * 从任意偏移读取任意长度
+ *
+ * @return: 读到的字节数，到达文件末尾时可能小于len；出错时返回已读到的字节数，
+ *          一个字节都没读到返回-1并设置mini_errno
+ */
+ssize_t dio_pread(struct dio_file *f, void *dst, size_t len, off_t offset)
+{
+    char *out = (char *)dst;
+    size_t done = 0;
+
+    while (done < len)
+    {
+        off_t pos = offset + done;
+        off_t start;
+        size_t head, want, take;
+        ssize_t n;
+
+        // 地址、偏移、长度都对齐时直接读入调用者缓冲区；非直接I/O没有对齐要求
+        if (!f->direct ||
+            ((((uintptr_t)(out + done) | (uintptr_t)pos) & DIO_MASK) == 0 && len - done >= DIO_ALIGN))
+        {
+            want = f->direct ? (len - done) & ~DIO_MASK : len - done;
+            n = pread64(f->fd, out + done, want, pos);
+            if (n < 0)
+            {
+                return done > 0 ? (ssize_t)done : -1;
+            }
+            done += n;
+            if ((size_t)n < want)
+            {
+                break;
+            }
+            continue;
+        }
+
+        start = pos & ~(off_t)DIO_MASK;
+        head = pos - start;
+        want = __MINI_ALIGN(head + (len - done), DIO_ALIGN);
+        if (want > f->buf_size)
+        {
+            want = f->buf_size;
+        }
+
+        n = pread64(f->fd, f->buf, want, start);
+        if (n < 0)
+        {
+            return done > 0 ? (ssize_t)done : -1;
+        }
+        if (n <= (ssize_t)head)
+        {
+            break;
+        }
+        take = n - head;
+        if (take > len - done)
+        {
+            take = len - done;
+        }
+        memcpy(out + done, f->buf + head, take);
+        done += take;
+        if ((size_t)n < want)
+        {
+            break;
+        }
+    }
+    return (ssize_t)done;
+}
+
+/**
+ * 从当前位置顺序读取
+ *
+ * @return: 读到的字节数，文件末尾返回0，失败返回-1并设置mini_errno
+ */
+ssize_t dio_read(struct dio_file *f, void *dst, size_t len)
+{
+    ssize_t n = dio_pread(f, dst, len, f->offset);
+
+    if (n > 0)
+    {
+        f->offset += n;
+    }
+    return n;
+}
+
+/**
+ * 写出中转缓冲区中剩余的数据并关闭文件
+ *
+ * 剩余数据中对齐的整块仍直接写，最后不足DIO_ALIGN的尾部
+ * 通过F_SETFL去掉O_DIRECT后写入。
+ *
+ * @return: 成功返回0，失败返回-1并设置mini_errno，文件总会被关闭
+ */
+int dio_close(struct dio_file *f)
+{
+    int ret = 0;
+
+    if (f->fill > 0)
+    {
+        size_t aligned = f->fill & ~DIO_MASK;
+        size_t tail = f->fill - aligned;
+
+        if (aligned > 0 && dio_pwrite_all(f->fd, f->buf, aligned, f->offset) < 0)
+        {
+            ret = -1;
+        }
+        if (ret == 0 && tail > 0)
+        {
+            if (f->direct)
+            {
+                int fl = fcntl(f->fd, F_GETFL, 0);
+                if (fl < 0 || fcntl(f->fd, F_SETFL, fl & ~O_DIRECT) < 0)
+                {
+                    ret = -1;
+                }
+            }
+            if (ret == 0 && dio_pwrite_all(f->fd, f->buf + aligned, tail, f->offset + aligned) < 0)
+            {
+                ret = -1;
+            }
+        }
+        f->offset += f->fill;
+        f->fill = 0;
+    }
+
+    {
+        int err = mini_errno;
+        munmap(f->buf, f->buf_size);
+        close(f->fd);
+        f->buf = NULL;
+        f->fd = -1;
+        if (ret < 0)
+        {
+            mini_errno = err;
+        }
+    }
+    return ret;
+}
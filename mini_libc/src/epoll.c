@@ -0,0 +1,270 @@
+/**
+ * epoll.c - aarch64平台epoll/eventfd/timerfd系统调用实现
+ *
+ * aarch64没有epoll_create/epoll_wait/eventfd这些旧接口，
+ * 只提供epoll_create1、epoll_pwait、eventfd2，poll也只能通过ppoll实现。
+ */
+
+#include "mini_lib.h"
+
+/* 系统调用号定义 */
+#define __NR_eventfd2           19
+#define __NR_epoll_create1      20
+#define __NR_epoll_ctl          21
+#define __NR_epoll_pwait        22
+#define __NR_ppoll              73
+#define __NR_timerfd_create     85
+#define __NR_timerfd_settime    86
+#define __NR_timerfd_gettime    87
+
+/* 内核sigset_t大小 */
+#define KERNEL_SIGSET_SIZE      8
+
+/**
+ * 创建epoll实例
+ *
+ * @param flags: 0或EPOLL_CLOEXEC
+ * @return: 成功返回epoll文件描述符，失败返回-1并设置mini_errno
+ */
+int epoll_create1(int flags)
+{
+    register long x8 asm("x8") = __NR_epoll_create1;
+    register long x0 asm("x0") = flags;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return (int)x0;
+}
+
+/**
+ * 添加/修改/删除epoll监听的文件描述符
+ *
+ * @param epfd: epoll文件描述符
+ * @param op: EPOLL_CTL_ADD/EPOLL_CTL_MOD/EPOLL_CTL_DEL
+ * @param fd: 目标文件描述符
+ * @param event: 关注的事件和用户数据，EPOLL_CTL_DEL时可为NULL
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
+{
+    register long x8 asm("x8") = __NR_epoll_ctl;
+    register long x0 asm("x0") = epfd;
+    register long x1 asm("x1") = op;
+    register long x2 asm("x2") = fd;
+    register long x3 asm("x3") = (long)event;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2), "r"(x3)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 等待epoll事件
+ *
+ * @param epfd: epoll文件描述符
+ * @param events: 输出就绪事件的数组
+ * @param maxevents: 数组长度
+ * @param timeout: 超时毫秒数，-1表示永久等待
+ * @param sigmask: 等待期间使用的信号掩码，NULL表示不修改
+ * @return: 成功返回就绪事件数，失败返回-1并设置mini_errno
+ */
+int epoll_pwait(int epfd, struct epoll_event *events, int maxevents, int timeout, const void *sigmask)
+{
+    register long x8 asm("x8") = __NR_epoll_pwait;
+    register long x0 asm("x0") = epfd;
+    register long x1 asm("x1") = (long)events;
+    register long x2 asm("x2") = maxevents;
+    register long x3 asm("x3") = timeout;
+    register long x4 asm("x4") = (long)sigmask;
+    register long x5 asm("x5") = KERNEL_SIGSET_SIZE;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2), "r"(x3), "r"(x4), "r"(x5)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return (int)x0;
+}
+
+/**
+ * 创建eventfd，用于线程间/进程间的轻量事件通知
+ *
+ * @param initval: 计数器初值
+ * @param flags: EFD_NONBLOCK/EFD_CLOEXEC/EFD_SEMAPHORE
+ * @return: 成功返回文件描述符，失败返回-1并设置mini_errno
+ */
+int eventfd(unsigned int initval, int flags)
+{
+    register long x8 asm("x8") = __NR_eventfd2;
+    register long x0 asm("x0") = initval;
+    register long x1 asm("x1") = flags;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return (int)x0;
+}
+
+/**
+ * 创建timerfd，定时器到期时文件描述符变为可读
+ *
+ * @param clockid: CLOCK_MONOTONIC/CLOCK_REALTIME
+ * @param flags: TFD_NONBLOCK/TFD_CLOEXEC
+ * @return: 成功返回文件描述符，失败返回-1并设置mini_errno
+ */
+int timerfd_create(int clockid, int flags)
+{
+    register long x8 asm("x8") = __NR_timerfd_create;
+    register long x0 asm("x0") = clockid;
+    register long x1 asm("x1") = flags;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return (int)x0;
+}
+
+/**
+ * 设置timerfd的到期时间和周期
+ *
+ * @param fd: timerfd
+ * @param flags: 0表示相对时间，TFD_TIMER_ABSTIME表示绝对时间
+ * @param new_value: 新的到期时间，it_value全0表示停止定时器
+ * @param old_value: 输出原来的设置，可为NULL
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int timerfd_settime(int fd, int flags, const struct itimerspec *new_value, struct itimerspec *old_value)
+{
+    register long x8 asm("x8") = __NR_timerfd_settime;
+    register long x0 asm("x0") = fd;
+    register long x1 asm("x1") = flags;
+    register long x2 asm("x2") = (long)new_value;
+    register long x3 asm("x3") = (long)old_value;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2), "r"(x3)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 读取timerfd的剩余时间
+ *
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int timerfd_gettime(int fd, struct itimerspec *curr_value)
+{
+    register long x8 asm("x8") = __NR_timerfd_gettime;
+    register long x0 asm("x0") = fd;
+    register long x1 asm("x1") = (long)curr_value;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 等待一组fd就绪
+ *
+ * @param fds: pollfd数组
+ * @param nfds: 数组长度
+ * @param timeout: 超时毫秒数，-1表示一直等待
+ * @return: 就绪的fd个数，超时返回0，失败返回-1并设置mini_errno
+ */
+int poll(struct pollfd *fds, unsigned long nfds, int timeout)
+{
+    struct timespec ts;
+    struct timespec *tsp = NULL;
+
+    if (timeout >= 0)
+    {
+        ts.tv_sec = timeout / 1000;
+        ts.tv_nsec = (long)(timeout % 1000) * 1000000;
+        tsp = &ts;
+    }
+
+    register long x8 asm("x8") = __NR_ppoll;
+    register long x0 asm("x0") = (long)fds;
+    register long x1 asm("x1") = nfds;
+    register long x2 asm("x2") = (long)tsp;
+    register long x3 asm("x3") = 0;
+    register long x4 asm("x4") = KERNEL_SIGSET_SIZE;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2), "r"(x3), "r"(x4)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return (int)x0;
+}
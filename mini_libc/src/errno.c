@@ -0,0 +1,19 @@
+/**
+ * errno.c - 错误码
+ *
+ * 系统调用封装失败时返回-1，并把内核返回的错误码(正值)保存在mini_errno中，
+ * 调用者据此区分EAGAIN、EINTR等需要重试的情况。
+ *
+ * mini_errno是当前线程描述符中的字段(见tls.c)，各线程互不干扰，
+ * 读写只需一条mrs指令加一次访存。
+ */
+
+#include "mini_lib.h"
+
+/**
+ * 取当前线程mini_errno的地址，供需要函数形式的调用者使用
+ */
+int *__mini_errno_location(void)
+{
+    return &mini_thread_self()->err;
+}
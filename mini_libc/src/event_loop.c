@@ -0,0 +1,435 @@
+/**
+ * event_loop.c - 基于epoll的事件循环(reactor)
+ *
+ * 实现了以下功能：
+ * - fd就绪回调，支持水平触发和边沿触发(EPOLLET)
+ * - 基于timerfd的一次性/周期定时器
+ * - 监听socket的批量accept：边沿触发下一次唤醒把已完成握手的连接全部取完
+ * - 通过eventfd从其他线程停止事件循环
+ *
+ * 处理器表按fd下标一次性mmap，注册和注销都不调用malloc，
+ * 因此多个线程可以各自运行自己的事件循环而互不干扰。
+ * epoll_event.data中同时保存fd和该槽位的代数(gen)，fd在同一批事件中
+ * 被关闭并复用时，旧事件因代数不匹配而被丢弃。
+ */
+
+#include "mini_lib.h"
+
+/* 单次epoll_pwait最多取出的事件数 */
+#define EVENT_LOOP_BATCH    256
+
+/* 未指定时默认支持的最大fd */
+#define EVENT_LOOP_DEFAULT_MAX_FDS  65536
+
+/* 处理器类型 */
+enum
+{
+    EVENT_KIND_NONE = 0,
+    EVENT_KIND_IO,
+    EVENT_KIND_TIMER,
+    EVENT_KIND_LISTENER,
+    EVENT_KIND_WAKEUP,
+};
+
+/* 每个fd一个处理器槽位 */
+struct event_handler
+{
+    int kind;                   // EVENT_KIND_xxx
+    uint32_t gen;               // 代数，每次注册/注销递增
+    uint32_t events;            // 关注的事件
+    union
+    {
+        event_io_cb io;
+        event_timer_cb timer;
+        event_accept_cb accept;
+    } cb;
+    void *arg;                  // 回调参数
+};
+
+struct event_loop
+{
+    int epfd;                   // epoll文件描述符
+    int wake_fd;                // 用于跨线程唤醒的eventfd
+    volatile int running;       // 运行标志
+    int max_fds;                // 处理器表大小
+    struct event_handler *handlers;
+    size_t handlers_size;
+    struct epoll_event events[EVENT_LOOP_BATCH];
+};
+
+/**
+ * 把fd注册到epoll并填写处理器槽位
+ */
+static int event_loop_register(struct event_loop *loop, int fd, uint32_t events,
+                               int kind, void *cb, void *arg)
+{
+    if (fd < 0 || fd >= loop->max_fds)
+    {
+        mini_errno = EBADF;
+        return -1;
+    }
+
+    struct event_handler *h = &loop->handlers[fd];
+    if (h->kind != EVENT_KIND_NONE)
+    {
+        mini_errno = EEXIST;
+        return -1;
+    }
+
+    h->gen++;
+    h->kind = kind;
+    h->events = events;
+    h->cb.io = (event_io_cb)cb;
+    h->arg = arg;
+
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.u64 = ((uint64_t)h->gen << 32) | (uint32_t)fd;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+    {
+        h->kind = EVENT_KIND_NONE;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * 创建事件循环
+ *
+ * @param max_fds: 支持的最大fd值，<=0时使用默认值65536
+ * @return: 成功返回事件循环，失败返回NULL
+ */
+struct event_loop *event_loop_create(int max_fds)
+{
+    if (max_fds <= 0)
+    {
+        max_fds = EVENT_LOOP_DEFAULT_MAX_FDS;
+    }
+
+    struct event_loop *loop = mmap(NULL, sizeof(struct event_loop),
+                                   PROT_READ | PROT_WRITE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (loop == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    // 处理器表按需缺页，未使用的fd不占物理内存
+    loop->max_fds = max_fds;
+    loop->handlers_size = max_fds * sizeof(struct event_handler);
+    loop->handlers = mmap(NULL, loop->handlers_size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (loop->handlers == MAP_FAILED)
+    {
+        munmap(loop, sizeof(struct event_loop));
+        return NULL;
+    }
+
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    loop->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (loop->epfd < 0 || loop->wake_fd < 0 ||
+        event_loop_register(loop, loop->wake_fd, EPOLLIN, EVENT_KIND_WAKEUP, NULL, NULL) < 0)
+    {
+        event_loop_destroy(loop);
+        return NULL;
+    }
+
+    // 运行标志只由event_loop_stop清除，run之前的stop不会丢失
+    loop->running = 1;
+    return loop;
+}
+
+/**
+ * 销毁事件循环
+ *
+ * 只关闭事件循环自己创建的fd(epoll、唤醒eventfd、定时器)，
+ * 用户注册的fd由用户自行关闭。
+ */
+void event_loop_destroy(struct event_loop *loop)
+{
+    if (!loop)
+    {
+        return;
+    }
+
+    for (int fd = 0; fd < loop->max_fds; fd++)
+    {
+        if (loop->handlers[fd].kind == EVENT_KIND_TIMER)
+        {
+            close(fd);
+        }
+    }
+    if (loop->wake_fd >= 0)
+    {
+        close(loop->wake_fd);
+    }
+    if (loop->epfd >= 0)
+    {
+        close(loop->epfd);
+    }
+
+    munmap(loop->handlers, loop->handlers_size);
+    munmap(loop, sizeof(struct event_loop));
+}
+
+/**
+ * 注册fd就绪回调
+ *
+ * @param fd: 文件描述符，建议设置为非阻塞
+ * @param events: EPOLLIN/EPOLLOUT等，可带EPOLLET使用边沿触发，
+ *                边沿触发下回调必须一直读/写到EAGAIN
+ * @param cb: 就绪回调
+ * @param arg: 回调参数
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int event_loop_add_fd(struct event_loop *loop, int fd, uint32_t events, event_io_cb cb, void *arg)
+{
+    return event_loop_register(loop, fd, events, EVENT_KIND_IO, (void *)cb, arg);
+}
+
+/**
+ * 修改fd关注的事件
+ *
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int event_loop_mod_fd(struct event_loop *loop, int fd, uint32_t events)
+{
+    if (fd < 0 || fd >= loop->max_fds || loop->handlers[fd].kind == EVENT_KIND_NONE)
+    {
+        mini_errno = ENOENT;
+        return -1;
+    }
+
+    struct event_handler *h = &loop->handlers[fd];
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.u64 = ((uint64_t)h->gen << 32) | (uint32_t)fd;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_MOD, fd, &ev) < 0)
+    {
+        return -1;
+    }
+
+    h->events = events;
+    return 0;
+}
+
+/**
+ * 注销fd，可以在回调中调用(包括注销其他fd)
+ *
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int event_loop_del_fd(struct event_loop *loop, int fd)
+{
+    if (fd < 0 || fd >= loop->max_fds || loop->handlers[fd].kind == EVENT_KIND_NONE)
+    {
+        mini_errno = ENOENT;
+        return -1;
+    }
+
+    struct event_handler *h = &loop->handlers[fd];
+    epoll_ctl(loop->epfd, EPOLL_CTL_DEL, fd, NULL);
+
+    // 递增代数，本批次中尚未分发的旧事件将被丢弃
+    h->kind = EVENT_KIND_NONE;
+    h->gen++;
+    return 0;
+}
+
+/**
+ * 添加定时器
+ *
+ * @param initial_ms: 首次到期的相对时间(毫秒)，必须大于0
+ * @param interval_ms: 周期(毫秒)，0表示一次性定时器
+ * @param cb: 到期回调
+ * @param arg: 回调参数
+ * @return: 成功返回定时器fd(用于删除)，失败返回-1
+ */
+int event_loop_add_timer(struct event_loop *loop, long initial_ms, long interval_ms,
+                         event_timer_cb cb, void *arg)
+{
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (tfd < 0)
+    {
+        return -1;
+    }
+
+    struct itimerspec its;
+    its.it_value.tv_sec = initial_ms / 1000;
+    its.it_value.tv_nsec = (initial_ms % 1000) * 1000000;
+    its.it_interval.tv_sec = interval_ms / 1000;
+    its.it_interval.tv_nsec = (interval_ms % 1000) * 1000000;
+
+    if (timerfd_settime(tfd, 0, &its, NULL) < 0 ||
+        event_loop_register(loop, tfd, EPOLLIN, EVENT_KIND_TIMER, (void *)cb, arg) < 0)
+    {
+        close(tfd);
+        return -1;
+    }
+
+    return tfd;
+}
+
+/**
+ * 删除定时器并关闭其timerfd
+ *
+ * @return: 成功返回0，失败返回-1
+ */
+int event_loop_del_timer(struct event_loop *loop, int timer_fd)
+{
+    if (timer_fd < 0 || timer_fd >= loop->max_fds ||
+        loop->handlers[timer_fd].kind != EVENT_KIND_TIMER)
+    {
+        mini_errno = ENOENT;
+        return -1;
+    }
+
+    event_loop_del_fd(loop, timer_fd);
+    close(timer_fd);
+    return 0;
+}
+
+/**
+ * 注册监听socket
+ *
+ * 监听socket被设置为非阻塞并以边沿触发方式注册，
+ * 每次就绪时循环accept4直到EAGAIN，一次唤醒处理完积压的所有连接。
+ *
+ * @param listen_fd: 已listen的socket
+ * @param cb: 新连接回调
+ * @param arg: 回调参数
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int event_loop_add_listener(struct event_loop *loop, int listen_fd, event_accept_cb cb, void *arg)
+{
+    if (set_nonblocking(listen_fd) < 0)
+    {
+        return -1;
+    }
+    return event_loop_register(loop, listen_fd, EPOLLIN | EPOLLET,
+                               EVENT_KIND_LISTENER, (void *)cb, arg);
+}
+
+/**
+ * 取完监听socket上所有待处理的连接
+ */
+static void event_loop_drain_accept(struct event_loop *loop, int listen_fd, struct event_handler *h)
+{
+    uint32_t gen = h->gen;
+
+    while (1)
+    {
+        int conn_fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (conn_fd < 0)
+        {
+            if (mini_errno == EINTR || mini_errno == ECONNABORTED)
+            {
+                continue;
+            }
+            if (mini_errno != EAGAIN)
+            {
+                LOG_ERROR("accept4 on fd %d failed, errno=%d", listen_fd, mini_errno);
+            }
+            return;
+        }
+
+        h->cb.accept(loop, conn_fd, h->arg);
+
+        // 回调中可能注销了监听socket
+        if (h->kind != EVENT_KIND_LISTENER || h->gen != gen)
+        {
+            return;
+        }
+    }
+}
+
+/**
+ * 分发一个就绪事件
+ */
+static void event_loop_dispatch(struct event_loop *loop, struct epoll_event *ev)
+{
+    int fd = (int)(ev->data.u64 & 0xffffffffUL);
+    uint32_t gen = (uint32_t)(ev->data.u64 >> 32);
+    struct event_handler *h = &loop->handlers[fd];
+
+    // 本批次中已被注销(或注销后fd被复用)的事件直接丢弃
+    if (h->kind == EVENT_KIND_NONE || h->gen != gen)
+    {
+        return;
+    }
+
+    switch (h->kind)
+    {
+        case EVENT_KIND_IO:
+            h->cb.io(loop, fd, ev->events, h->arg);
+            break;
+
+        case EVENT_KIND_TIMER:
+        {
+            uint64_t expirations = 0;
+            if (read(fd, &expirations, sizeof(expirations)) == sizeof(expirations))
+            {
+                h->cb.timer(loop, fd, expirations, h->arg);
+            }
+            break;
+        }
+
+        case EVENT_KIND_LISTENER:
+            event_loop_drain_accept(loop, fd, h);
+            break;
+
+        case EVENT_KIND_WAKEUP:
+        {
+            uint64_t value;
+            read(fd, &value, sizeof(value));
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+/**
+ * 运行事件循环，直到event_loop_stop被调用
+ *
+ * 在run之前已经调用过stop时立即返回；停止后的事件循环不能再次运行。
+ *
+ * @return: 正常停止返回0，epoll出错返回-1
+ */
+int event_loop_run(struct event_loop *loop)
+{
+    while (loop->running)
+    {
+        int n = epoll_pwait(loop->epfd, loop->events, EVENT_LOOP_BATCH, -1, NULL);
+        if (n < 0)
+        {
+            if (mini_errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            event_loop_dispatch(loop, &loop->events[i]);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * 停止事件循环
+ *
+ * 可以在回调中调用，也可以从其他线程调用：
+ * 通过eventfd唤醒阻塞在epoll_pwait上的事件循环。
+ */
+void event_loop_stop(struct event_loop *loop)
+{
+    uint64_t one = 1;
+
+    loop->running = 0;
+    write(loop->wake_fd, &one, sizeof(one));
+}
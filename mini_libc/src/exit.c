@@ -0,0 +1,71 @@
+/**
+ * exit.c - 进程退出与atexit
+ *
+ * main返回后入口_mini_libc_entry用main的返回值调用exit，
+ * exit按注册的逆序调用atexit处理函数，再用exit_group结束全部线程。
+ */
+
+#include "mini_lib.h"
+#include "mini_atomic.h"
+
+#define __NR_exit_group 94
+
+/* 最多可注册的处理函数个数，C标准要求至少32个 */
+#define ATEXIT_MAX      32
+
+static struct
+{
+    void (*funcs[ATEXIT_MAX])(void);
+    volatile int count;
+} g_atexit;
+
+/**
+ * 注册进程正常退出时调用的函数
+ *
+ * @return: 成功返回0，已满返回-1
+ */
+int atexit(void (*func)(void))
+{
+    int n = mini_atomic_fetch_add(&g_atexit.count, 1, MINI_ATOMIC_ACQ_REL);
+
+    if (n >= ATEXIT_MAX)
+    {
+        mini_atomic_fetch_sub(&g_atexit.count, 1, MINI_ATOMIC_RELAXED);
+        return -1;
+    }
+    g_atexit.funcs[n] = func;
+    return 0;
+}
+
+/**
+ * 直接结束进程，不调用atexit处理函数
+ */
+void _exit(int status)
+{
+    register long x8 asm("x8") = __NR_exit_group;
+    register long x0 asm("x0") = status;
+
+    for (;;)
+    {
+        asm volatile("svc #0" : : "r"(x8), "r"(x0) : "memory");
+    }
+}
+
+/**
+ * 按注册的逆序调用atexit处理函数后结束进程
+ *
+ * 处理函数中再调用exit时不会重复调用已经执行过的函数
+ */
+void exit(int status)
+{
+    int n;
+
+    while ((n = mini_atomic_load(&g_atexit.count, MINI_ATOMIC_ACQUIRE)) > 0)
+    {
+        if (mini_atomic_cas(&g_atexit.count, &n, n - 1, MINI_ATOMIC_ACQ_REL) && g_atexit.funcs[n - 1] != NULL)
+        {
+            g_atexit.funcs[n - 1]();
+        }
+    }
+    _exit(status);
+}
@@ -0,0 +1,57 @@
+/**
+ * fcntl.c - 文件描述符控制
+ */
+
+#include "mini_lib.h"
+
+#define __NR_fcntl  25
+
+/**
+ * fcntl - 文件描述符控制
+ *
+ * @param fd: 文件描述符
+ * @param cmd: F_GETFL/F_SETFL/F_GETFD/F_SETFD等命令
+ * @param arg: 命令参数
+ * @return: 成功返回值取决于cmd，失败返回-1并设置mini_errno
+ */
+int fcntl(int fd, int cmd, long arg)
+{
+    register long x8 asm("x8") = __NR_fcntl;
+    register long x0 asm("x0") = fd;
+    register long x1 asm("x1") = cmd;
+    register long x2 asm("x2") = arg;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return (int)x0;
+}
+
+/**
+ * 将文件描述符设置为非阻塞模式
+ *
+ * @param fd: 文件描述符
+ * @return: 成功返回0，失败返回-1
+ */
+int set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0)
+    {
+        return -1;
+    }
+    if (flags & O_NONBLOCK)
+    {
+        return 0;
+    }
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0 ? -1 : 0;
+}
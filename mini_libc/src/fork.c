@@ -10,6 +10,9 @@
 
 // 手动定义系统调用号
 #define __NR_getpid 172  // aarch64平台的getpid系统调用号
+#define __NR_getuid 174  // 获取真实用户ID
+#define __NR_getgid 176  // 获取真实组ID
+#define __NR_wait4  260  // 等待子进程状态变化
 
 #define SIGCHLD     17   // 子进程结束时向父进程发送SIGCHLD信号
 
@@ -46,6 +49,12 @@ int fork(void)
     {
         return -1;
     }
+
+    // 子进程复制了父进程的线程描述符，更新其中缓存的线程ID
+    if (ret == 0)
+    {
+        mini_thread_self()->tid = gettid();
+    }
     
     return ret;
 }
@@ -67,4 +76,71 @@ pid_t getpid(void)
     );
     
     return x0;
-}
\ No newline at end of file
+}
+
+/**
+ * 获取当前进程的真实用户ID
+ */
+uid_t getuid(void)
+{
+    register long x8 asm("x8") = __NR_getuid;
+    register long x0 asm("x0") = 0;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8)
+        : "memory", "cc"
+    );
+
+    return x0;
+}
+
+/**
+ * 获取当前进程的真实组ID
+ */
+gid_t getgid(void)
+{
+    register long x8 asm("x8") = __NR_getgid;
+    register long x0 asm("x0") = 0;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8)
+        : "memory", "cc"
+    );
+
+    return x0;
+}
+
+/**
+ * 等待子进程退出
+ *
+ * @param pid: 子进程ID，-1表示任意子进程
+ * @param status: 输出退出状态，可为NULL
+ * @param options: 0或WNOHANG
+ * @return: 返回退出的子进程ID，失败返回-1并设置mini_errno
+ */
+pid_t waitpid(pid_t pid, int *status, int options)
+{
+    register long x8 asm("x8") = __NR_wait4;
+    register long x0 asm("x0") = pid;
+    register long x1 asm("x1") = (long)status;
+    register long x2 asm("x2") = options;
+    register long x3 asm("x3") = 0;   // rusage = NULL
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2), "r"(x3)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return x0;
+}
@@ -0,0 +1,466 @@
+/**
+ * io_uring.c - aarch64平台io_uring实现
+ *
+ * 本文件实现了io_uring的三个系统调用封装以及一个精简版liburing：
+ * - io_uring_setup/io_uring_enter/io_uring_register 系统调用
+ * - 提交队列(SQ)、完成队列(CQ)以及SQE数组的mmap映射
+ * - get_sqe/submit/wait_cqe/cqe_seen 等提交与收割接口
+ * - 注册缓冲区、注册文件
+ * - SQPOLL模式：内核线程轮询提交队列，提交时通常无需系统调用
+ *
+ * 环形队列的head/tail由用户态和内核共同读写，需要用acquire/release
+ * 语义访问，保证sqe内容先于tail可见、cqe内容在读到tail之后才读取。
+ *
+ * @note 本实现不依赖任何标准库，直接使用系统调用实现功能
+ */
+
+#include "mini_lib.h"
+#include "mini_atomic.h"
+
+/* 系统调用号定义 */
+#define __NR_io_uring_setup     425
+#define __NR_io_uring_enter     426
+#define __NR_io_uring_register  427
+
+/**
+ * 创建io_uring实例
+ *
+ * @param entries: 提交队列深度
+ * @param p: 输入为setup标志位等参数，输出为各环的偏移
+ * @return: 成功返回ring的文件描述符，失败返回-errno
+ */
+int io_uring_setup(uint32_t entries, struct io_uring_params *p)
+{
+    register long x8 asm("x8") = __NR_io_uring_setup;
+    register long x0 asm("x0") = entries;
+    register long x1 asm("x1") = (long)p;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1)
+        : "memory", "cc"
+    );
+
+    return (int)x0;
+}
+
+/**
+ * 提交请求并/或等待完成
+ *
+ * @param fd: ring的文件描述符
+ * @param to_submit: 本次提交的sqe数量
+ * @param min_complete: 至少等待多少个完成事件(需配合IORING_ENTER_GETEVENTS)
+ * @param flags: IORING_ENTER_xxx
+ * @return: 成功返回内核消费的sqe数量，失败返回-errno
+ */
+int io_uring_enter(int fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags)
+{
+    register long x8 asm("x8") = __NR_io_uring_enter;
+    register long x0 asm("x0") = fd;
+    register long x1 asm("x1") = to_submit;
+    register long x2 asm("x2") = min_complete;
+    register long x3 asm("x3") = flags;
+    register long x4 asm("x4") = 0;   // sig = NULL
+    register long x5 asm("x5") = 0;   // sigsz
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2), "r"(x3), "r"(x4), "r"(x5)
+        : "memory", "cc"
+    );
+
+    return (int)x0;
+}
+
+/**
+ * 向ring注册资源(缓冲区、文件等)
+ *
+ * @param fd: ring的文件描述符
+ * @param opcode: IORING_REGISTER_xxx
+ * @param arg: 资源数组
+ * @param nr_args: 资源个数
+ * @return: 成功返回0，失败返回-errno
+ */
+int io_uring_register(int fd, uint32_t opcode, const void *arg, uint32_t nr_args)
+{
+    register long x8 asm("x8") = __NR_io_uring_register;
+    register long x0 asm("x0") = fd;
+    register long x1 asm("x1") = opcode;
+    register long x2 asm("x2") = (long)arg;
+    register long x3 asm("x3") = nr_args;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2), "r"(x3)
+        : "memory", "cc"
+    );
+
+    return (int)x0;
+}
+
+/**
+ * 解除SQ/CQ环以及SQE数组的映射
+ */
+static void io_uring_unmap_rings(struct io_uring *ring)
+{
+    if (ring->sq.sqes)
+    {
+        munmap(ring->sq.sqes, *ring->sq.kring_entries * sizeof(struct io_uring_sqe));
+    }
+    if (ring->cq.ring_ptr && ring->cq.ring_ptr != ring->sq.ring_ptr)
+    {
+        munmap(ring->cq.ring_ptr, ring->cq.ring_sz);
+    }
+    if (ring->sq.ring_ptr)
+    {
+        munmap(ring->sq.ring_ptr, ring->sq.ring_sz);
+    }
+}
+
+/**
+ * 映射SQ/CQ环以及SQE数组，并根据内核返回的偏移初始化各指针
+ *
+ * @return: 成功返回0，失败返回-errno
+ */
+static int io_uring_map_rings(int fd, struct io_uring_params *p, struct io_uring *ring)
+{
+    struct io_uring_sq *sq = &ring->sq;
+    struct io_uring_cq *cq = &ring->cq;
+
+    sq->ring_sz = p->sq_off.array + p->sq_entries * sizeof(uint32_t);
+    cq->ring_sz = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+
+    // 新内核SQ和CQ环共用一块映射，取两者较大的长度
+    if (p->features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (cq->ring_sz > sq->ring_sz)
+        {
+            sq->ring_sz = cq->ring_sz;
+        }
+        cq->ring_sz = sq->ring_sz;
+    }
+
+    sq->ring_ptr = mmap(NULL, sq->ring_sz, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq->ring_ptr == MAP_FAILED)
+    {
+        int err = -mini_errno;
+        sq->ring_ptr = NULL;
+        return err;
+    }
+
+    if (p->features & IORING_FEAT_SINGLE_MMAP)
+    {
+        cq->ring_ptr = sq->ring_ptr;
+    }
+    else
+    {
+        cq->ring_ptr = mmap(NULL, cq->ring_sz, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cq->ring_ptr == MAP_FAILED)
+        {
+            int err = -mini_errno;
+            cq->ring_ptr = NULL;
+            io_uring_unmap_rings(ring);
+            return err;
+        }
+    }
+
+    char *sq_base = (char *)sq->ring_ptr;
+    sq->khead = (volatile uint32_t *)(sq_base + p->sq_off.head);
+    sq->ktail = (volatile uint32_t *)(sq_base + p->sq_off.tail);
+    sq->kring_mask = (uint32_t *)(sq_base + p->sq_off.ring_mask);
+    sq->kring_entries = (uint32_t *)(sq_base + p->sq_off.ring_entries);
+    sq->kflags = (volatile uint32_t *)(sq_base + p->sq_off.flags);
+    sq->kdropped = (uint32_t *)(sq_base + p->sq_off.dropped);
+    sq->array = (uint32_t *)(sq_base + p->sq_off.array);
+
+    sq->sqes = mmap(NULL, p->sq_entries * sizeof(struct io_uring_sqe),
+                    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    fd, IORING_OFF_SQES);
+    if (sq->sqes == MAP_FAILED)
+    {
+        int err = -mini_errno;
+        sq->sqes = NULL;
+        io_uring_unmap_rings(ring);
+        return err;
+    }
+
+    char *cq_base = (char *)cq->ring_ptr;
+    cq->khead = (volatile uint32_t *)(cq_base + p->cq_off.head);
+    cq->ktail = (volatile uint32_t *)(cq_base + p->cq_off.tail);
+    cq->kring_mask = (uint32_t *)(cq_base + p->cq_off.ring_mask);
+    cq->kring_entries = (uint32_t *)(cq_base + p->cq_off.ring_entries);
+    cq->koverflow = (uint32_t *)(cq_base + p->cq_off.overflow);
+    cq->cqes = (struct io_uring_cqe *)(cq_base + p->cq_off.cqes);
+
+    return 0;
+}
+
+/**
+ * 按给定参数初始化io_uring
+ *
+ * 需要SQPOLL模式时在p->flags中设置IORING_SETUP_SQPOLL，
+ * 并可通过p->sq_thread_idle指定内核轮询线程的空闲休眠时间。
+ *
+ * @param entries: 提交队列深度(内核会向上取整为2的幂)
+ * @param ring: 待初始化的ring
+ * @param p: setup参数
+ * @return: 成功返回0，失败返回-errno
+ */
+int io_uring_queue_init_params(uint32_t entries, struct io_uring *ring, struct io_uring_params *p)
+{
+    memset(ring, 0, sizeof(*ring));
+
+    int fd = io_uring_setup(entries, p);
+    if (fd < 0)
+    {
+        return fd;
+    }
+
+    int ret = io_uring_map_rings(fd, p, ring);
+    if (ret < 0)
+    {
+        close(fd);
+        return ret;
+    }
+
+    ring->flags = p->flags;
+    ring->ring_fd = fd;
+    return 0;
+}
+
+/**
+ * 初始化io_uring
+ *
+ * @param entries: 提交队列深度
+ * @param ring: 待初始化的ring
+ * @param flags: IORING_SETUP_xxx
+ * @return: 成功返回0，失败返回-errno
+ */
+int io_uring_queue_init(uint32_t entries, struct io_uring *ring, uint32_t flags)
+{
+    struct io_uring_params p;
+
+    memset(&p, 0, sizeof(p));
+    p.flags = flags;
+    return io_uring_queue_init_params(entries, ring, &p);
+}
+
+/**
+ * 销毁io_uring，解除映射并关闭ring
+ */
+void io_uring_queue_exit(struct io_uring *ring)
+{
+    io_uring_unmap_rings(ring);
+    close(ring->ring_fd);
+}
+
+/**
+ * 取出一个空闲的sqe
+ *
+ * 取出的sqe在调用io_uring_submit之前不会被内核看到。
+ *
+ * @return: 成功返回sqe指针，提交队列已满返回NULL
+ */
+struct io_uring_sqe *io_uring_get_sqe(struct io_uring *ring)
+{
+    struct io_uring_sq *sq = &ring->sq;
+
+    // 内核在SQPOLL模式下会并发推进head，需要acquire读取
+    uint32_t head = mini_atomic_load(sq->khead, MINI_ATOMIC_ACQUIRE);
+    if (sq->sqe_tail - head >= *sq->kring_entries)
+    {
+        return NULL;
+    }
+
+    struct io_uring_sqe *sqe = &sq->sqes[sq->sqe_tail & *sq->kring_mask];
+    sq->sqe_tail++;
+    return sqe;
+}
+
+/**
+ * 把已取出的sqe填入共享的索引数组，并发布新的tail
+ *
+ * @return: 队列中等待内核消费的sqe数量
+ */
+static uint32_t io_uring_flush_sq(struct io_uring *ring)
+{
+    struct io_uring_sq *sq = &ring->sq;
+    uint32_t mask = *sq->kring_mask;
+    uint32_t tail = *sq->ktail;
+
+    while (sq->sqe_head != sq->sqe_tail)
+    {
+        sq->array[tail & mask] = sq->sqe_head & mask;
+        tail++;
+        sq->sqe_head++;
+    }
+
+    // release语义：sqe内容和索引数组必须先于tail对内核可见
+    mini_atomic_store(sq->ktail, tail, MINI_ATOMIC_RELEASE);
+
+    return tail - *sq->khead;
+}
+
+/**
+ * 提交请求，可选地等待完成事件
+ *
+ * SQPOLL模式下内核线程自己会发现新的tail，只有在它已经休眠
+ * (IORING_SQ_NEED_WAKEUP)时才需要io_uring_enter唤醒。
+ */
+static int io_uring_submit_internal(struct io_uring *ring, uint32_t wait_nr)
+{
+    uint32_t submitted = io_uring_flush_sq(ring);
+    uint32_t flags = 0;
+
+    if (ring->flags & IORING_SETUP_SQPOLL)
+    {
+        // 全屏障：保证读取kflags发生在发布tail之后
+        mini_atomic_fence(MINI_ATOMIC_SEQ_CST);
+        if (*ring->sq.kflags & IORING_SQ_NEED_WAKEUP)
+        {
+            flags |= IORING_ENTER_SQ_WAKEUP;
+        }
+        if (wait_nr > 0)
+        {
+            flags |= IORING_ENTER_GETEVENTS;
+        }
+        if (flags == 0)
+        {
+            return (int)submitted;
+        }
+
+        int ret = io_uring_enter(ring->ring_fd, submitted, wait_nr, flags);
+        return ret < 0 ? ret : (int)submitted;
+    }
+
+    if (wait_nr > 0)
+    {
+        flags |= IORING_ENTER_GETEVENTS;
+    }
+    if (submitted == 0 && flags == 0)
+    {
+        return 0;
+    }
+
+    return io_uring_enter(ring->ring_fd, submitted, wait_nr, flags);
+}
+
+/**
+ * 提交所有已取出的sqe
+ *
+ * @return: 成功返回提交的sqe数量，失败返回-errno
+ */
+int io_uring_submit(struct io_uring *ring)
+{
+    return io_uring_submit_internal(ring, 0);
+}
+
+/**
+ * 提交所有已取出的sqe，并等待至少wait_nr个完成事件
+ *
+ * @return: 成功返回提交的sqe数量，失败返回-errno
+ */
+int io_uring_submit_and_wait(struct io_uring *ring, uint32_t wait_nr)
+{
+    return io_uring_submit_internal(ring, wait_nr);
+}
+
+/**
+ * 非阻塞地查看完成队列
+ *
+ * @param cqe_ptr: 输出第一个未处理的cqe
+ * @return: 有完成事件返回0，否则返回-EAGAIN
+ */
+int io_uring_peek_cqe(struct io_uring *ring, struct io_uring_cqe **cqe_ptr)
+{
+    struct io_uring_cq *cq = &ring->cq;
+    uint32_t head = *cq->khead;
+
+    // acquire语义：读到新的tail之后才能读取cqe内容
+    uint32_t tail = mini_atomic_load(cq->ktail, MINI_ATOMIC_ACQUIRE);
+    if (head == tail)
+    {
+        *cqe_ptr = NULL;
+        return -EAGAIN;
+    }
+
+    *cqe_ptr = &cq->cqes[head & *cq->kring_mask];
+    return 0;
+}
+
+/**
+ * 等待一个完成事件
+ *
+ * 完成队列中已有事件时直接返回，不进入内核。
+ *
+ * @param cqe_ptr: 输出第一个未处理的cqe
+ * @return: 成功返回0，失败返回-errno
+ */
+int io_uring_wait_cqe(struct io_uring *ring, struct io_uring_cqe **cqe_ptr)
+{
+    while (1)
+    {
+        if (io_uring_peek_cqe(ring, cqe_ptr) == 0)
+        {
+            return 0;
+        }
+
+        int ret = io_uring_enter(ring->ring_fd, 0, 1, IORING_ENTER_GETEVENTS);
+        if (ret < 0 && ret != -EINTR)
+        {
+            return ret;
+        }
+    }
+}
+
+/**
+ * 标记一个cqe已处理，归还完成队列的槽位
+ */
+void io_uring_cqe_seen(struct io_uring *ring, struct io_uring_cqe *cqe)
+{
+    if (cqe)
+    {
+        // release语义：对cqe的读取必须在head前移之前完成
+        mini_atomic_store(ring->cq.khead, *ring->cq.khead + 1, MINI_ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * 注册固定缓冲区
+ *
+ * 内核会预先pin住这些页，之后READ_FIXED/WRITE_FIXED无需每次映射用户内存。
+ *
+ * @return: 成功返回0，失败返回-errno
+ */
+int io_uring_register_buffers(struct io_uring *ring, const struct iovec *iovecs, uint32_t nr_iovecs)
+{
+    return io_uring_register(ring->ring_fd, IORING_REGISTER_BUFFERS, iovecs, nr_iovecs);
+}
+
+int io_uring_unregister_buffers(struct io_uring *ring)
+{
+    return io_uring_register(ring->ring_fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+}
+
+/**
+ * 注册固定文件
+ *
+ * 注册后sqe可设置IOSQE_FIXED_FILE并用下标代替fd，省去每次请求的fd查找与引用计数。
+ * 较老的内核在SQPOLL模式下要求必须使用注册文件。
+ *
+ * @return: 成功返回0，失败返回-errno
+ */
+int io_uring_register_files(struct io_uring *ring, const int *files, uint32_t nr_files)
+{
+    return io_uring_register(ring->ring_fd, IORING_REGISTER_FILES, files, nr_files);
+}
+
+int io_uring_unregister_files(struct io_uring *ring)
+{
+    return io_uring_register(ring->ring_fd, IORING_UNREGISTER_FILES, NULL, 0);
+}
@@ -1,72 +1,32 @@
 /**
  * pthread_mutex.c - 互斥锁实现
+ *
+ * lock字段有三种状态：0未加锁，1已加锁且无人等待，2已加锁且可能有人在futex上等待。
+ * 无竞争时加锁是一次CAS(0->1)，解锁是一次交换(->0)，都不进入内核；
+ * 只有解锁前的值为2时才需要FUTEX_WAKE。
+ * 锁只在进程内使用，futex操作都带FUTEX_PRIVATE_FLAG，内核不必按物理页查找等待队列。
+ *
+ * 竞争时先自旋再休眠，自旋次数按最近几次实际自旋的次数自适应：
+ * 锁持有时间短时自旋通常能等到锁，持有时间长时自旋上限随之下降，
+ * 很快转入futex等待而不是白白占用CPU。
+ *
+ * 用-DMINI_LOCK_PROFILE编译时记录每把锁的竞争情况，见下方"竞争统计"部分；
+ * 不定义时加锁路径与原来完全相同。
  */
 
 #include "mini_lib.h"
+#include "mini_atomic.h"
 
 /* 系统调用号定义 */
 #define __NR_futex   98
 
-/* futex操作码 */
-#define FUTEX_WAIT   0
-#define FUTEX_WAKE   1
-
-/**
- * 原子比较和交换操作
- * 
- * 将ptr指向的值与expected比较,如果相等则将其替换为desired值
- * 整个操作是原子的,不会被中断
- *
- * @param ptr      指向要操作的内存地址的指针
- * @param expected 期望的原值
- * @param desired  要设置的新值
- * @return         1表示交换成功,0表示失败(原值与expected不相等)
- */
-static inline int atomic_cas(volatile int *ptr, int expected, int desired)
-{
-    int tmp;
-    int success;
-
-    asm volatile(
-        "1: ldxr %w0, [%2]\n"         // 加载当前值到 tmp (%w0)
-        "   cmp %w0, %w3\n"           // 比较 tmp 和 expected (%w3)
-        "   b.ne 2f\n"                // 不相等则跳转到失败分支
-        "   stxr %w1, %w4, [%2]\n"    // 尝试存储 desired (%w4)
-        "   cbnz %w1, 1b\n"           // 存储失败则重试
-        "   dmb ish\n"                // 内存屏障（release语义）
-        "   mov %w1, #1\n"            // 设置 success = 1
-        "   b 3f\n"
-        "2: mov %w1, #0\n"            // 设置 success = 0
-        "3:"
-        : "=&r" (tmp), "=&r" (success)  // 输出操作数
-        : "r" (ptr),                    // 输入操作数 %2
-          "r" (expected),               // 输入操作数 %3
-          "r" (desired)                 // 输入操作数 %4
-        : "cc", "memory"
-    );
-
-    return success;
-}
+/* 自适应自旋的上限 */
+#define MUTEX_MAX_SPINS 100
 
-/**
- * 原子存储操作
- * 
- * 使用stlr指令实现原子存储,具有release语义。
- * 确保在此存储之前的所有内存访问都已完成。
- *
- * @param ptr: 要存储的目标内存地址
- * @param val: 要存储的值
- * @note: 使用stlr指令,具有内存屏障效果,保证存储的原子性
- */
-static inline void atomic_store(volatile int *ptr, int val)
-{
-    asm volatile(
-        "stlr %w1, [%0]"
-        : 
-        : "r" (ptr), "r" (val)
-        : "memory"
-    );
-}
+#ifdef MINI_LOCK_PROFILE
+static void mutex_lock_profiled(pthread_mutex_t *mutex, void *site);
+static void mutex_lock_contended_profiled(pthread_mutex_t *mutex, void *site);
+#endif
 
 /**
  * futex 系统调用包装
@@ -128,39 +88,94 @@ int pthread_mutex_init(pthread_mutex_t *mutex, const pthread_mutexattr_t *attr)
 {
     mutex->lock = 0;
     mutex->owner = 0;
+    mutex->spins = 0;
     return 0;
 }
 
 
-static inline int atomic_load(volatile int *ptr)
+/**
+ * 尝试把锁从0改为1
+ */
+static inline int mutex_trylock(pthread_mutex_t *mutex)
+{
+    int expected = 0;
+    return mini_atomic_cas(&mutex->lock, &expected, 1, MINI_ATOMIC_ACQUIRE);
+}
+
+/**
+ * 把状态置为2并在futex上休眠直到拿到锁
+ *
+ * 置为2后解锁者一定会唤醒；交换得到0说明已经拿到锁
+ *
+ * @return: futex休眠的次数
+ */
+static int mutex_lock_wait(pthread_mutex_t *mutex)
+{
+    int c = mini_atomic_exchange(&mutex->lock, 2, MINI_ATOMIC_ACQUIRE);
+    int sleeps = 0;
+
+    while (c != 0)
+    {
+        futex(&mutex->lock, FUTEX_WAIT | FUTEX_PRIVATE_FLAG, 2, NULL, NULL, 0);
+        sleeps++;
+        c = mini_atomic_exchange(&mutex->lock, 2, MINI_ATOMIC_ACQUIRE);
+    }
+    return sleeps;
+}
+
+/**
+ * 加锁慢路径：自适应自旋，之后把状态置为2并在futex上休眠
+ *
+ * spins由多个等待者并发读改写，用relaxed原子读写保证不会读到撕裂的值；
+ * 更新之间可能互相覆盖，丢掉的只是一次估计，对正确性没有影响。
+ *
+ * @return: futex休眠的次数，自旋期间拿到锁时为0
+ */
+static int mutex_lock_slow(pthread_mutex_t *mutex)
 {
-    int value;
-    asm volatile(
-        "ldar %w0, [%1]"
-        : "=r"(value)
-        : "r"(ptr)
-        : "memory"
-    );
-    return value;
+    int spins = mini_atomic_load(&mutex->spins, MINI_ATOMIC_RELAXED);
+    int max_spins = spins * 2 + 10;
+    int cnt = 0;
+
+    if (max_spins > MUTEX_MAX_SPINS)
+    {
+        max_spins = MUTEX_MAX_SPINS;
+    }
+
+    // 自旋时只读，锁看起来空闲才尝试CAS，避免反复抢占缓存行
+    while (cnt < max_spins)
+    {
+        cnt++;
+        if (mini_atomic_load(&mutex->lock, MINI_ATOMIC_RELAXED) == 0 && mutex_trylock(mutex))
+        {
+            // 按1/8的权重向本次实际自旋次数靠拢
+            mini_atomic_store(&mutex->spins, spins + (cnt - spins) / 8, MINI_ATOMIC_RELAXED);
+            return 0;
+        }
+        __asm__ volatile("yield");
+    }
+
+    // 自旋没等到锁说明持有时间比上限还长，估计值向0衰减，不能把上限本身计入平均，
+    // 否则持有时间越长上限反而越高
+    mini_atomic_store(&mutex->spins, spins - (spins + 7) / 8, MINI_ATOMIC_RELAXED);
+
+    return mutex_lock_wait(mutex);
 }
 
 /**
  * 加锁操作
  * 
  * 对互斥锁进行加锁。如果锁已被其他线程持有,则当前线程将被阻塞,直到能获取到锁。
- * 采用自旋+休眠的混合策略,先尝试自旋一定次数,如果仍无法获取锁则通过futex系统调用休眠。
+ * 采用自旋+休眠的混合策略,自旋次数自适应,仍无法获取锁则通过futex系统调用休眠。
  * 
  * @param mutex: 要加锁的互斥锁指针
- * @return: 成功返回0,失败返回错误码
- *         - EINVAL: 参数无效
- *         - EDEADLK: 检测到死锁(重入)
+ * @return: 成功返回0,失败返回-1(参数无效或同一线程重复加锁)
  * 
  * @note: 同一个线程不能对同一个互斥锁重复加锁,否则会返回错误
  */
 int pthread_mutex_lock(pthread_mutex_t *mutex)
 {
-    int tid = gettid();
-    int spin_count = 100;  // 自旋计数
+    int tid;
 
     // 检查参数
     if (!mutex)
@@ -168,59 +183,52 @@ int pthread_mutex_lock(pthread_mutex_t *mutex)
         return -1;
     }
 
+    // 线程ID取自线程描述符，不需要系统调用
+    tid = mini_thread_self()->tid;
+
     // 检查重入
     if (mutex->owner == tid)
     {
         return -1;
     }
 
-    while (1)
+#ifdef MINI_LOCK_PROFILE
+    mutex_lock_profiled(mutex, __builtin_return_address(0));
+#else
+    if (!mutex_trylock(mutex))
     {
-        if (atomic_cas(&mutex->lock, 0, 1))
-        {
-            mutex->owner = tid;
-            return 0;
-        }
-
-        // 自旋等待
-        if (spin_count-- > 0)
-        {
-            __asm__ volatile("yield");  // 使用 yield 指令让出 CPU
-            continue;
-        }
-
-        // 应使用原子读取
-        int ret = futex(&mutex->lock, FUTEX_WAIT, 1, NULL, NULL, 0);
-        if (ret < 0)
-        {
-            // 通过系统调用返回值判断错误类型
-            int err = -ret;
-            if (err == EAGAIN)  // 需要确认系统调用返回码
-            {
-                spin_count = 100;
-                continue;
-            }
-            if (err == EINTR)
-            {
-                continue;
-            }
-            return -MINI_EINVAL;
-        }
-        spin_count = 100;  // 重置自旋计数
+        mutex_lock_slow(mutex);
     }
+#endif
+    mutex->owner = tid;
+    return 0;
+}
+
+/**
+ * 条件变量被唤醒后重新加锁
+ *
+ * broadcast会把其余等待者转移到互斥锁的futex上，它们只能由解锁唤醒，
+ * 所以这里不走自旋和0->1的快速路径，直接以状态2加锁，保证解锁时会唤醒下一个。
+ */
+void __mini_mutex_lock_contended(pthread_mutex_t *mutex)
+{
+#ifdef MINI_LOCK_PROFILE
+    mutex_lock_contended_profiled(mutex, __builtin_return_address(0));
+#else
+    mutex_lock_wait(mutex);
+#endif
+    mutex->owner = mini_thread_self()->tid;
 }
 
 /**
  * 解锁操作
  * @param mutex: 要解锁的互斥锁
- * @return: 成功返回0，失败返回错误码
+ * @return: 成功返回0，失败返回-1
  * @note: 只有锁的持有者(owner)才能解锁，否则返回错误
- * @note: 解锁后会唤醒一个等待该锁的线程
+ * @note: 只有可能有人等待(状态为2)时才唤醒一个等待者
  */
 int pthread_mutex_unlock(pthread_mutex_t *mutex)
 {
-    int tid = gettid();
-
     // 参数检查
     if (!mutex)
     {
@@ -228,22 +236,269 @@ int pthread_mutex_unlock(pthread_mutex_t *mutex)
     }
 
     // 所有权检查
-    if (mutex->owner != tid)
+    if (mutex->owner != mini_thread_self()->tid)
     {
         return -1;  // 非持有者解锁错误
     }
 
     // 先清除 owner，再释放锁
     mutex->owner = 0;
-    atomic_store(&mutex->lock, 0);
-
-    // 唤醒等待者
-    int ret = futex(&mutex->lock, FUTEX_WAKE, 1, NULL, NULL, 0);
-    if (ret == -1)
+    if (mini_atomic_exchange(&mutex->lock, 0, MINI_ATOMIC_RELEASE) == 2)
     {
-        // futex wake 失败，但锁已经释放，继续返回成功
-        return 0;
+        futex(&mutex->lock, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, 1, NULL, NULL, 0);
     }
 
     return 0;
-}
\ No newline at end of file
+}
+
+/*
+ * 竞争统计
+ *
+ * 统计放在按锁地址索引的开放寻址表中，pthread_mutex_t的布局不变。
+ * 除插入新槽外，一把锁的统计只在持有这把锁时修改，不需要原子操作。
+ * 调用点取加锁函数的返回地址，条件变量被唤醒后重新加锁时是cond.c中的地址；
+ * 可以用addr2line -e <程序> <地址>换算成源码行。
+ * 第一次记录时用atexit注册pthread_mutex_profile_dump，进程正常退出时输出报告。
+ */
+#ifdef MINI_LOCK_PROFILE
+
+#define LOCK_PROFILE_BITS   10
+#define LOCK_PROFILE_SLOTS  (1 << LOCK_PROFILE_BITS)
+#define LOCK_PROFILE_SITES  4       /* 每把锁单独计数的调用点个数 */
+#define LOCK_PROFILE_TOP    32      /* 报告中按等待时间列出的锁数 */
+
+struct lock_profile_stats
+{
+    uint64_t acquisitions;          /* 加锁次数 */
+    uint64_t contended;             /* 快速路径失败、需要等待的次数 */
+    uint64_t spin_acquired;         /* 等待中靠自旋拿到锁的次数 */
+    uint64_t sleep_acquired;        /* 等待中进入过futex休眠的次数 */
+    uint64_t futex_waits;           /* futex休眠总次数 */
+    uint64_t wait_cycles;           /* 等待的总计数值(CNTVCT_EL0) */
+    uint64_t max_wait_cycles;       /* 单次最长等待 */
+    struct
+    {
+        void *pc;
+        uint64_t contended;
+    } sites[LOCK_PROFILE_SITES];    /* 发生竞争的调用点 */
+    uint64_t other_sites;           /* 超出sites的调用点上的竞争次数 */
+};
+
+struct lock_profile_entry
+{
+    pthread_mutex_t *volatile mutex;    /* 键，NULL表示空槽 */
+    struct lock_profile_stats stats;
+};
+
+static struct
+{
+    struct lock_profile_entry entries[LOCK_PROFILE_SLOTS];
+    volatile int used;
+    volatile int dropped;           /* 表满后未能记录的锁 */
+    volatile int registered;
+} g_lock_profile;
+
+/**
+ * 查找或插入mutex的统计槽
+ *
+ * @return: 统计槽，表已满返回NULL
+ */
+static struct lock_profile_entry *lock_profile_entry(pthread_mutex_t *mutex)
+{
+    uint64_t key = (uint64_t)(uintptr_t)mutex;
+    unsigned int i = (unsigned int)(((key >> 6) * 0x9e3779b97f4a7c15UL) >> (64 - LOCK_PROFILE_BITS));
+    int n;
+
+    for (n = 0; n < LOCK_PROFILE_SLOTS; n++, i = (i + 1) & (LOCK_PROFILE_SLOTS - 1))
+    {
+        struct lock_profile_entry *e = &g_lock_profile.entries[i];
+        uint64_t cur = mini_atomic_load_64((volatile uint64_t *)&e->mutex, MINI_ATOMIC_ACQUIRE);
+
+        if (cur == 0)
+        {
+            if (!mini_atomic_cas_64((volatile uint64_t *)&e->mutex, &cur, key, MINI_ATOMIC_ACQ_REL))
+            {
+                // 被其他线程抢先占用，cur为它写入的键
+                if (cur == key)
+                {
+                    return e;
+                }
+                continue;
+            }
+            mini_atomic_fetch_add(&g_lock_profile.used, 1, MINI_ATOMIC_RELAXED);
+            if (mini_atomic_exchange(&g_lock_profile.registered, 1, MINI_ATOMIC_ACQ_REL) == 0)
+            {
+                atexit(pthread_mutex_profile_dump);
+            }
+            return e;
+        }
+        if (cur == key)
+        {
+            return e;
+        }
+    }
+
+    mini_atomic_fetch_add(&g_lock_profile.dropped, 1, MINI_ATOMIC_RELAXED);
+    return NULL;
+}
+
+/**
+ * 记录一次需要等待的加锁，调用者已经持有mutex
+ */
+static void lock_profile_contended(pthread_mutex_t *mutex, void *site, uint64_t wait, int sleeps)
+{
+    struct lock_profile_entry *e = lock_profile_entry(mutex);
+    struct lock_profile_stats *st;
+    int i;
+
+    if (e == NULL)
+    {
+        return;
+    }
+    st = &e->stats;
+    st->acquisitions++;
+    st->contended++;
+    if (sleeps > 0)
+    {
+        st->sleep_acquired++;
+        st->futex_waits += sleeps;
+    }
+    else
+    {
+        st->spin_acquired++;
+    }
+    st->wait_cycles += wait;
+    if (wait > st->max_wait_cycles)
+    {
+        st->max_wait_cycles = wait;
+    }
+
+    for (i = 0; i < LOCK_PROFILE_SITES; i++)
+    {
+        if (st->sites[i].pc == site || st->sites[i].pc == NULL)
+        {
+            st->sites[i].pc = site;
+            st->sites[i].contended++;
+            return;
+        }
+    }
+    st->other_sites++;
+}
+
+/**
+ * 带统计的加锁，快速路径只多一次查表
+ */
+static void mutex_lock_profiled(pthread_mutex_t *mutex, void *site)
+{
+    struct lock_profile_entry *e;
+    uint64_t start;
+    int sleeps;
+
+    if (mutex_trylock(mutex))
+    {
+        e = lock_profile_entry(mutex);
+        if (e != NULL)
+        {
+            e->stats.acquisitions++;
+        }
+        return;
+    }
+
+    start = cycles_read();
+    sleeps = mutex_lock_slow(mutex);
+    lock_profile_contended(mutex, site, cycles_read() - start, sleeps);
+}
+
+static void mutex_lock_contended_profiled(pthread_mutex_t *mutex, void *site)
+{
+    uint64_t start = cycles_read();
+    int sleeps = mutex_lock_wait(mutex);
+
+    lock_profile_contended(mutex, site, cycles_read() - start, sleeps);
+}
+
+/**
+ * 输出竞争统计，按总等待时间从多到少列出前LOCK_PROFILE_TOP把锁
+ *
+ * 读取时不加锁，其他线程仍在加锁时个别计数可能不一致
+ */
+void pthread_mutex_profile_dump(void)
+{
+    struct lock_profile_entry *top[LOCK_PROFILE_TOP];
+    int ntop = 0;
+    int i, j, k;
+
+    for (i = 0; i < LOCK_PROFILE_SLOTS; i++)
+    {
+        struct lock_profile_entry *e = &g_lock_profile.entries[i];
+
+        if (e->mutex == NULL || e->stats.acquisitions == 0)
+        {
+            continue;
+        }
+        // 插入排序，只保留前LOCK_PROFILE_TOP个
+        for (j = ntop; j > 0 && top[j - 1]->stats.wait_cycles < e->stats.wait_cycles; j--)
+        {
+        }
+        if (j >= LOCK_PROFILE_TOP)
+        {
+            continue;
+        }
+        if (ntop < LOCK_PROFILE_TOP)
+        {
+            ntop++;
+        }
+        for (k = ntop - 1; k > j; k--)
+        {
+            top[k] = top[k - 1];
+        }
+        top[j] = e;
+    }
+
+    printf("mutex profile: %d locks, %d not tracked\n", g_lock_profile.used, g_lock_profile.dropped);
+    for (i = 0; i < ntop; i++)
+    {
+        struct lock_profile_stats *st = &top[i]->stats;
+
+        printf("mutex 0x%x: acquired %ld, contended %ld (spin %ld, sleep %ld), futex waits %ld\n",
+               (unsigned long)top[i]->mutex, (long)st->acquisitions, (long)st->contended,
+               (long)st->spin_acquired, (long)st->sleep_acquired, (long)st->futex_waits);
+        printf("    wait total %ld us, max %ld us\n",
+               (long)(cycles_to_ns(st->wait_cycles) / 1000), (long)(cycles_to_ns(st->max_wait_cycles) / 1000));
+        for (j = 0; j < LOCK_PROFILE_SITES && st->sites[j].pc != NULL; j++)
+        {
+            printf("    site 0x%x: contended %ld\n", (unsigned long)st->sites[j].pc, (long)st->sites[j].contended);
+        }
+        if (st->other_sites > 0)
+        {
+            printf("    other sites: contended %ld\n", (long)st->other_sites);
+        }
+    }
+}
+
+/**
+ * 清零全部统计，已记录的锁保留在表中
+ */
+void pthread_mutex_profile_reset(void)
+{
+    int i;
+
+    for (i = 0; i < LOCK_PROFILE_SLOTS; i++)
+    {
+        memset(&g_lock_profile.entries[i].stats, 0, sizeof(struct lock_profile_stats));
+    }
+    g_lock_profile.dropped = 0;
+}
+
+#else
+
+void pthread_mutex_profile_dump(void)
+{
+    printf("mutex profile: not enabled, build with -DMINI_LOCK_PROFILE\n");
+}
+
+void pthread_mutex_profile_reset(void)
+{
+}
+
+#endif
@@ -2,14 +2,21 @@
  * logger.c - 日志功能模块
  * 支持DEBUG、INFO、ERROR三个日志级别
  * 自动打印文件名、函数名和行号
+ * 支持编译期级别裁剪、调用点静态描述符以及按模块设置运行期级别
+ * 支持按调用点限流(令牌桶)和概率采样
  */
 
 #include "mini_lib.h"
+#include "mini_atomic.h"
 
 
 
-// 当前日志级别，默认为INFO
-static int current_log_level = LOG_LEVEL_DEBUG;
+// default模块：未定义LOG_MODULE的文件都归属该模块，默认级别DEBUG
+LOG_MODULE_DEFINE(default);
+
+// 链接器为 mini_log_modules 段自动生成的起止符号
+extern struct log_module __start_mini_log_modules[];
+extern struct log_module __stop_mini_log_modules[];
 
 // 日志级别对应的字符串
 static const char *log_level_str[] = {
@@ -36,37 +43,27 @@ static const char *get_filename(const char *path)
     return filename;
 }
 
-// 日志输出函数
-void log_output(int level, const char *file, const char *func, int line, const char *fmt, ...)
+/**
+ * 格式化并输出一条日志
+ *
+ * 调用者已完成级别过滤，这里只负责拼接日志头和内容并写出。
+ *
+ * @param level: 日志级别
+ * @param filename: 不含路径的文件名
+ * @param func: 函数名
+ * @param line: 行号
+ * @param fmt: 格式字符串
+ * @param args: 可变参数列表
+ */
+static void log_vwrite(int level, const char *filename, const char *func, int line,
+                       const char *fmt, va_list args)
 {
-    // 参数有效性检查
-    if (!file || !func || !fmt)
-    {
-        write(2, "Invalid log parameters\n", 22);
-        return;
-    }
-
-    // 检查日志级别范围
-    if (level < LOG_LEVEL_DEBUG || level > LOG_LEVEL_ERROR)
-    {
-        write(2, "Invalid log level\n", 17);
-        return;
-    }
-
-    // 如果当前日志级别高于要输出的级别，则不输出
-    if (level < current_log_level)
-    {
-        return;
-    }
-
-    // 格式化日志
     char buf[1024];
-    va_list args;
     
     // 先格式化日志头，限制长度避免缓冲区溢出
     int header_len = snprintf(buf, sizeof(buf), "[%s][%s:%d][%s] ", 
                            log_level_str[level],
-                           get_filename(file),
+                           filename,
                            line,
                            func);
                            
@@ -86,9 +83,7 @@ void log_output(int level, const char *file, const char *func, int line, const c
     }
 
     // 格式化日志内容
-    va_start(args, fmt);
     int content_len = vsnprintf(buf + header_len, remaining, fmt, args);
-    va_end(args);
 
     // 检查是否发生截断
     if (content_len < 0 || content_len >= remaining)
@@ -97,21 +92,212 @@ void log_output(int level, const char *file, const char *func, int line, const c
         return;
     }
 
-    // 输出到标准输出
-    write(1, buf, header_len + content_len);
-    write(1, "\n", 1);
+    // 日志正文和换行符通过一次writev输出，整行不会与其他线程的输出交错
+    struct iovec iov[2];
+    iov[0].iov_base = buf;
+    iov[0].iov_len = header_len + content_len;
+    iov[1].iov_base = "\n";
+    iov[1].iov_len = 1;
+    writev(1, iov, 2);
+}
+
+// 日志输出函数
+void log_output(int level, const char *file, const char *func, int line, const char *fmt, ...)
+{
+    // 参数有效性检查
+    if (!file || !func || !fmt)
+    {
+        write(2, "Invalid log parameters\n", 22);
+        return;
+    }
+
+    // 检查日志级别范围
+    if (level < LOG_LEVEL_DEBUG || level > LOG_LEVEL_ERROR)
+    {
+        write(2, "Invalid log level\n", 17);
+        return;
+    }
+
+    // 如果当前日志级别高于要输出的级别，则不输出
+    if (level < log_module_default.level)
+    {
+        return;
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    log_vwrite(level, get_filename(file), func, line, fmt, args);
+    va_end(args);
 }
 
-// 设置日志级别
+/**
+ * 调用点日志输出
+ *
+ * 由LOG_xxx宏在通过模块级别检查后调用。调用点描述符在编译期已经确定，
+ * 文件名只在首次输出时从__FILE__中解析一次，之后直接使用缓存。
+ * 多线程下可能重复解析，但写入的结果相同，不影响正确性。
+ *
+ * @param site: 调用点静态描述符
+ * @param fmt: 格式字符串
+ */
+void log_site_output(struct log_site *site, const char *fmt, ...)
+{
+    if (!site->basename)
+    {
+        site->basename = get_filename(site->file);
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    log_vwrite(site->level, site->basename, site->func, site->line, fmt, args);
+    va_end(args);
+}
+
+/**
+ * 调用点限流检查
+ *
+ * 令牌桶按固定窗口补满：每interval_ms毫秒为一个窗口，窗口内最多放行burst条。
+ * 进入新窗口时由CAS成功的那个线程负责补满令牌，并把上个窗口累计的
+ * 抑制条数取走打印一条汇总日志。整个过程只使用原子操作，不加锁。
+ *
+ * @param site: 调用点描述符，用于输出汇总日志
+ * @param rl: 调用点限流状态
+ * @param burst: 每个窗口允许输出的条数
+ * @param interval_ms: 窗口长度(毫秒)
+ * @return: 1表示本条可以输出，0表示被抑制
+ */
+int log_ratelimit_pass(struct log_site *site, struct log_ratelimit *rl,
+                       unsigned int burst, unsigned int interval_ms)
+{
+    if (burst == 0)
+    {
+        return 0;
+    }
+
+    unsigned long interval_ticks = cycles_freq() / 1000 * interval_ms;
+    if (interval_ticks == 0)
+    {
+        interval_ticks = 1;
+    }
+    unsigned long now_window = (cycles_read() / interval_ticks) & 0xffffffffUL;
+
+    unsigned long old = mini_atomic_load(&rl->window, MINI_ATOMIC_RELAXED);
+    while (1)
+    {
+        unsigned long window = old >> 32;
+        unsigned long count = old & 0xffffffffUL;
+        unsigned long desired;
+
+        if (window == now_window)
+        {
+            // 当前窗口令牌已用完，记一次抑制
+            if (count >= burst)
+            {
+                mini_atomic_fetch_add(&rl->suppressed, 1, MINI_ATOMIC_RELAXED);
+                return 0;
+            }
+            desired = old + 1;
+        }
+        else
+        {
+            // 新窗口：补满令牌并消耗一个
+            desired = (now_window << 32) | 1;
+        }
+
+        if (mini_atomic_cas(&rl->window, &old, desired, MINI_ATOMIC_RELAXED))
+        {
+            break;
+        }
+    }
+
+    // 恢复输出，先汇总之前被抑制的条数
+    unsigned int suppressed = mini_atomic_exchange(&rl->suppressed, 0, MINI_ATOMIC_RELAXED);
+    if (suppressed > 0)
+    {
+        log_site_output(site, "suppressed %d messages", (int)suppressed);
+    }
+
+    return 1;
+}
+
+/**
+ * 调用点采样检查
+ *
+ * 对调用点的原子序号做哈希，哈希值落在1/one_in_n区间内的放行。
+ * 相比固定"每N条取1条"，哈希可以避免与循环周期对齐而总是采到同一类消息。
+ *
+ * @param rl: 调用点采样状态
+ * @param one_in_n: 采样率分母，0和1表示全部输出
+ * @return: 1表示本条可以输出，0表示被丢弃
+ */
+int log_sample_pass(struct log_ratelimit *rl, unsigned int one_in_n)
+{
+    if (one_in_n <= 1)
+    {
+        return 1;
+    }
+
+    unsigned long x = mini_atomic_fetch_add(&rl->seq, 1, MINI_ATOMIC_RELAXED);
+
+    // splitmix64 混合，序号加上状态地址让不同调用点相互独立
+    x += (unsigned long)rl + 0x9e3779b97f4a7c15UL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9UL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebUL;
+    x ^= x >> 31;
+
+    return (x % one_in_n) == 0;
+}
+
+// 设置日志级别，作用于所有未单独设置过级别的模块
 void set_log_level(int level)
 {
-    if (level >= LOG_LEVEL_DEBUG && level <= LOG_LEVEL_ERROR)
+    if (level < LOG_LEVEL_DEBUG || level > LOG_LEVEL_NONE)
     {
-        current_log_level = level;
+        return;
+    }
+
+    for (struct log_module *m = __start_mini_log_modules; m < __stop_mini_log_modules; m++)
+    {
+        if (!m->overridden || m == &log_module_default)
+        {
+            m->level = level;
+        }
     }
 }
 
-// 日志宏定义
-#define LOG_DEBUG(fmt, ...) log_output(LOG_LEVEL_DEBUG, __FILE__, __func__, __LINE__, fmt, ##__VA_ARGS__)
-#define LOG_INFO(fmt, ...)  log_output(LOG_LEVEL_INFO, __FILE__, __func__, __LINE__, fmt, ##__VA_ARGS__)
-#define LOG_ERROR(fmt, ...) log_output(LOG_LEVEL_ERROR, __FILE__, __func__, __LINE__, fmt, ##__VA_ARGS__)
+/**
+ * 单独设置某个模块的运行期日志级别
+ *
+ * @param name: 模块名，即LOG_MODULE_DEFINE的参数
+ * @param level: 新的最低级别，传-1表示取消单独设置并恢复为default模块的级别
+ * @return: 成功返回0，模块不存在或级别无效返回-1
+ */
+int log_set_module_level(const char *name, int level)
+{
+    if (!name || level < -1 || level > LOG_LEVEL_NONE)
+    {
+        return -1;
+    }
+
+    for (struct log_module *m = __start_mini_log_modules; m < __stop_mini_log_modules; m++)
+    {
+        if (strcmp(m->name, name) != 0)
+        {
+            continue;
+        }
+
+        if (level < 0)
+        {
+            m->overridden = 0;
+            m->level = log_module_default.level;
+        }
+        else
+        {
+            m->overridden = 1;
+            m->level = level;
+        }
+        return 0;
+    }
+
+    return -1;
+}
@@ -1,20 +1,35 @@
 #include "mini_lib.h"
 
-
-int lseek(int fd, int offset, int whence)
+/**
+ * lseek - 移动文件读写位置
+ *
+ * aarch64下lseek系统调用号为62，偏移量和返回值都是64位，
+ * 可以正确处理超过2GB的文件。
+ *
+ * @param fd: 文件描述符
+ * @param offset: 偏移量
+ * @param whence: SEEK_SET/SEEK_CUR/SEEK_END
+ * @return: 成功返回新的文件位置，失败返回-1并设置mini_errno
+ */
+off_t lseek(int fd, off_t offset, int whence)
 {
-    int result;
+    register long x8 asm("x8") = 62;  // lseek系统调用号
+    register long x0 asm("x0") = fd;
+    register long x1 asm("x1") = offset;
+    register long x2 asm("x2") = whence;
+
     asm volatile(
-        "mov x8, #62\n"                 // syscall number for llseek
-        "mov x0, %1\n"                  // fd
-        "mov x1, %2\n"                  // offset
-        "mov x2, %3\n"                  // whence
-        "svc #0\n"                      // Call the syscall
-        "mov %0, x0\n"                  // Store the result in 'result'
-        : "=r"(result)                  // 输出操作数列表
-        : "r"(fd), "r"(offset), "r"(whence)         // 输入操作数列表,对应占位符顺序
-        : "x0", "x1", "x2", "x8"                    // 告诉编译器在这段汇编代码中会被修改的寄存器, 顺序可以改变
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2)
+        : "memory", "cc"
     );
 
-    return result;
-}
\ No newline at end of file
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+
+    return x0;
+}
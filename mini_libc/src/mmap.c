@@ -38,7 +38,16 @@ void *mmap(void *addr, long size, int prot, int flags, int fd, long offset)
     }
 
     // mmap申请返回的内存大小是4k的整数倍
-    return __mmap(addr, size, prot, flags, fd, offset);
+    void *result = __mmap(addr, size, prot, flags, fd, offset);
+
+    // 内核以-4095~-1返回错误码，统一转换为MAP_FAILED
+    if ((unsigned long)result >= (unsigned long)-4095)
+    {
+        mini_errno = -(long)result;
+        return MAP_FAILED;
+    }
+
+    return result;
 }
 
 
@@ -58,4 +67,67 @@ int munmap(void *addr, long size)
     );
 
     return result;
-}
\ No newline at end of file
+}
+
+/**
+ * 向内核提供一段映射的访问模式建议
+ *
+ * 文件映射上MADV_SEQUENTIAL会加大预读窗口并尽快回收已读过的页，
+ * MADV_WILLNEED立即发起异步预读，MADV_DONTNEED丢弃映射中的页。
+ *
+ * @param addr: 页对齐的起始地址
+ * @param len: 长度
+ * @param advice: MADV_*建议
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int madvise(void *addr, size_t len, int advice)
+{
+    register long x8 asm("x8") = 233;   // madvise系统调用号
+    register long x0 asm("x0") = (long)addr;
+    register long x1 asm("x1") = len;
+    register long x2 asm("x2") = advice;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 修改一段映射的访问权限
+ *
+ * @param addr: 页对齐的起始地址
+ * @param len: 长度
+ * @param prot: PROT_*组合，PROT_NONE使这段内存不可访问
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int mprotect(void *addr, size_t len, int prot)
+{
+    register long x8 asm("x8") = 226;   // mprotect系统调用号
+    register long x0 asm("x0") = (long)addr;
+    register long x1 asm("x1") = len;
+    register long x2 asm("x2") = prot;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return 0;
+}
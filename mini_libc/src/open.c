@@ -18,4 +18,156 @@ int open(const char *pathname, int flags, int mode)
     );
 
     return result;
-}
\ No newline at end of file
+}
+
+/* 系统调用号定义 */
+#define __NR_unlinkat       35
+#define __NR_ftruncate      46
+#define __NR_newfstatat     79
+#define __NR_fstat          80
+#define __NR_memfd_create   279
+
+/**
+ * 把文件截断或扩展到指定长度
+ *
+ * @param fd: 以可写方式打开的文件
+ * @param length: 新长度
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int ftruncate(int fd, off_t length)
+{
+    register long x8 asm("x8") = __NR_ftruncate;
+    register long x0 asm("x0") = fd;
+    register long x1 asm("x1") = length;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 删除文件系统中的一个名字
+ *
+ * @param pathname: 文件路径，相对路径基于当前目录
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int unlink(const char *pathname)
+{
+    register long x8 asm("x8") = __NR_unlinkat;
+    register long x0 asm("x0") = AT_FDCWD;
+    register long x1 asm("x1") = (long)pathname;
+    register long x2 asm("x2") = 0;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 创建一个匿名的内存文件
+ *
+ * 文件只存在于内存中，可以ftruncate、mmap，并通过SCM_RIGHTS传给其他进程，
+ * 双方映射同一份页面即可共享数据而不拷贝。
+ *
+ * @param name: 调试用名字，显示在/proc/self/fd中
+ * @param flags: MFD_CLOEXEC/MFD_ALLOW_SEALING
+ * @return: 成功返回文件描述符，失败返回-1并设置mini_errno
+ */
+int memfd_create(const char *name, unsigned int flags)
+{
+    register long x8 asm("x8") = __NR_memfd_create;
+    register long x0 asm("x0") = (long)name;
+    register long x1 asm("x1") = flags;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return (int)x0;
+}
+
+/**
+ * 读取已打开文件的元数据
+ *
+ * @param fd: 文件描述符
+ * @param st: 输出文件大小、类型、块大小等信息
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int fstat(int fd, struct stat *st)
+{
+    register long x8 asm("x8") = __NR_fstat;
+    register long x0 asm("x0") = fd;
+    register long x1 asm("x1") = (long)st;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 读取路径的元数据，路径是符号链接时返回链接本身的信息
+ *
+ * @param pathname: 文件路径，相对路径基于当前目录
+ * @param st: 输出文件大小、类型、块大小等信息
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int lstat(const char *pathname, struct stat *st)
+{
+    register long x8 asm("x8") = __NR_newfstatat;
+    register long x0 asm("x0") = AT_FDCWD;
+    register long x1 asm("x1") = (long)pathname;
+    register long x2 asm("x2") = (long)st;
+    register long x3 asm("x3") = AT_SYMLINK_NOFOLLOW;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2), "r"(x3)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return 0;
+}
@@ -4,40 +4,78 @@
  * 本文件实现了基本的pthread线程创建功能。
  * 基于Linux的clone系统调用实现，使用适当的标志位
  * 来创建共享地址空间的线程。
+ *
+ * 每个线程的栈是一段独立映射，布局如下(低地址在左)：
+ *
+ *   [保护页][栈 ... | 启动参数][线程描述符|TCB|TLS]
+ *
+ * 保护页为PROT_NONE，栈溢出时立即触发SIGSEGV而不是改写相邻内存。
+ * 启动参数和线程描述符都在映射内部，创建线程不需要malloc。
+ * join之后的映射放入栈缓存，下次创建同样大小的线程时直接复用，
+ * 省去mmap/mprotect/munmap。复用前要确认内核已经清除了描述符中的tid
+ * (CLONE_CHILD_CLEARTID)，即旧线程已彻底不再使用这段栈。
+ *
+ * 线程退出后内核清零描述符中的tid并在该地址上FUTEX_WAKE，pthread_join
+ * 直接等这个futex：醒来时内核已不再使用这段栈，可以立即回收。
+ * 分离的线程在退出前把自己的栈放进缓存；缓存已满时在汇编中先munmap
+ * 自己的栈再exit，munmap之后不再访问栈。
  */
 
 #include "mini_lib.h"
+#include "mini_atomic.h"
 
 /* 系统调用号定义 */
 #define __NR_exit     93
 #define __NR_futex    98   // futex系统调用号
+#define __NR_set_tid_address 96
 #define __NR_gettid  178
-
-
-/* futex操作 */
-#define FUTEX_WAIT 0
-#define FUTEX_WAKE 1
+#define __NR_munmap  215
 
 /* pthread创建时使用的标志位组合 */
 #define PTHREAD_FLAGS (CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_SIGHAND | \
-                      CLONE_THREAD | CLONE_SYSVSEM | \
+                      CLONE_THREAD | CLONE_SYSVSEM | CLONE_SETTLS | \
                       CLONE_PARENT_SETTID | CLONE_CHILD_CLEARTID)
 
-/* 线程栈大小 (64KB) */
+/* 默认线程栈大小 (64KB) */
 #define STACK_SIZE (64 * 1024)  // 64KB
 
-/* 线程启动参数结构 */
+/* 默认保护页大小 */
+#define GUARD_SIZE  4096
+#define PAGE_SIZE   4096
+
+/* 栈缓存最多保存的映射数 */
+#define STACK_CACHE_MAX 64
+
+/* 描述符中的detach_state */
+#define THREAD_JOINABLE 0   // 可join，尚未退出
+#define THREAD_DETACHED 1   // 已分离，退出时自行回收
+#define THREAD_EXITING  2   // 正在退出，由join或detach回收
+
+/* 线程启动参数结构，位于栈映射中线程描述符的下方 */
 struct thread_start_args 
 {
     void *(*start_routine)(void*);  // 线程入口函数
     void *arg;                      // 线程参数
-    void *stack;                    // 线程栈
-    int has_exited;                // 线程是否已退出
-    int tid;                      // 线程ID
-    void *return_value;           // 添加返回值字段
+};
 
+/* 一段线程栈映射 */
+struct stack_map
+{
+    void *base;             // 映射起始地址(保护页)
+    size_t size;            // 映射总大小
+    size_t guard;           // 保护页大小
+    volatile int *tid;      // 描述符中的tid，内核清零后映射才可复用或释放
 };
 
+/* 已结束线程的栈映射缓存 */
+static struct
+{
+    volatile int lock;
+    int count;
+    int limit;
+    struct stack_map maps[STACK_CACHE_MAX];
+} g_stack_cache = { 0, 0, STACK_CACHE_MAX };
+
 
 
 /**
@@ -59,114 +97,448 @@ int gettid(void)
 }
 
 
+static void stack_cache_lock(void)
+{
+    while (mini_atomic_exchange(&g_stack_cache.lock, 1, MINI_ATOMIC_ACQUIRE))
+    {
+        __asm__ volatile("yield");
+    }
+}
+
+static void stack_cache_unlock(void)
+{
+    mini_atomic_store(&g_stack_cache.lock, 0, MINI_ATOMIC_RELEASE);
+}
+
+/**
+ * 等待旧线程彻底退出后释放栈映射
+ *
+ * 内核在线程退出时清零tid并在该地址上执行FUTEX_WAKE(非private)。
+ */
+static void stack_unmap(struct stack_map *map)
+{
+    int tid;
+
+    while ((tid = mini_atomic_load(map->tid, MINI_ATOMIC_ACQUIRE)) != 0)
+    {
+        futex(map->tid, FUTEX_WAIT, tid, NULL, NULL, 0);
+    }
+    munmap(map->base, map->size);
+}
+
+/**
+ * 从缓存中取一个大小相同且旧线程已退出的栈映射
+ *
+ * @return: 找到返回1，否则返回0
+ */
+static int stack_cache_get(size_t size, size_t guard, struct stack_map *out)
+{
+    int i;
+
+    stack_cache_lock();
+    for (i = 0; i < g_stack_cache.count; i++)
+    {
+        struct stack_map *m = &g_stack_cache.maps[i];
+        if (m->size == size && m->guard == guard &&
+            mini_atomic_load(m->tid, MINI_ATOMIC_ACQUIRE) == 0)
+        {
+            *out = *m;
+            *m = g_stack_cache.maps[--g_stack_cache.count];
+            stack_cache_unlock();
+            return 1;
+        }
+    }
+    stack_cache_unlock();
+    return 0;
+}
+
+/**
+ * 把栈映射放回缓存
+ *
+ * @return: 放入返回1，缓存已满返回0
+ */
+static int stack_cache_try_put(struct stack_map *map)
+{
+    int ok = 0;
+
+    stack_cache_lock();
+    if (g_stack_cache.count < g_stack_cache.limit)
+    {
+        g_stack_cache.maps[g_stack_cache.count++] = *map;
+        ok = 1;
+    }
+    stack_cache_unlock();
+    return ok;
+}
+
+/**
+ * 把栈映射放回缓存，缓存已满时释放
+ */
+static void stack_cache_put(struct stack_map *map)
+{
+    if (!stack_cache_try_put(map))
+    {
+        stack_unmap(map);
+    }
+}
+
+static void thread_stack_map(struct mini_thread *t, struct stack_map *map)
+{
+    map->base = t->map_base;
+    map->size = t->map_size;
+    map->guard = t->guard_size;
+    map->tid = &t->tid;
+}
+
+/**
+ * 设置栈缓存最多保存的映射数，0表示关闭缓存
+ *
+ * 超出新上限的缓存映射会被释放。
+ *
+ * @param count: 新上限，不超过STACK_CACHE_MAX
+ * @return: 原来的上限
+ */
+int pthread_stack_cache_limit(int count)
+{
+    struct stack_map evicted[STACK_CACHE_MAX];
+    int old, n = 0;
+    int i;
+
+    if (count < 0)
+    {
+        count = 0;
+    }
+    if (count > STACK_CACHE_MAX)
+    {
+        count = STACK_CACHE_MAX;
+    }
+
+    stack_cache_lock();
+    old = g_stack_cache.limit;
+    g_stack_cache.limit = count;
+    while (g_stack_cache.count > count)
+    {
+        evicted[n++] = g_stack_cache.maps[--g_stack_cache.count];
+    }
+    stack_cache_unlock();
+
+    for (i = 0; i < n; i++)
+    {
+        stack_unmap(&evicted[i]);
+    }
+    return old;
+}
+
+/**
+ * 初始化线程属性为默认值
+ */
+int pthread_attr_init(pthread_attr_t *attr)
+{
+    attr->stacksize = STACK_SIZE;
+    attr->guardsize = GUARD_SIZE;
+    attr->detachstate = PTHREAD_CREATE_JOINABLE;
+    return 0;
+}
+
+int pthread_attr_destroy(pthread_attr_t *attr)
+{
+    return 0;
+}
+
+/**
+ * 设置线程栈大小，不含保护页以及栈顶的线程描述符和TLS
+ *
+ * @return: 成功返回0，小于PTHREAD_STACK_MIN返回EINVAL
+ */
+int pthread_attr_setstacksize(pthread_attr_t *attr, size_t stacksize)
+{
+    if (stacksize < PTHREAD_STACK_MIN)
+    {
+        return EINVAL;
+    }
+    attr->stacksize = stacksize;
+    return 0;
+}
+
+int pthread_attr_getstacksize(const pthread_attr_t *attr, size_t *stacksize)
+{
+    *stacksize = attr->stacksize;
+    return 0;
+}
+
+/**
+ * 设置栈底保护页大小，创建线程时向上取整到页大小，0表示不要保护页
+ */
+int pthread_attr_setguardsize(pthread_attr_t *attr, size_t guardsize)
+{
+    attr->guardsize = guardsize;
+    return 0;
+}
+
+int pthread_attr_getguardsize(const pthread_attr_t *attr, size_t *guardsize)
+{
+    *guardsize = attr->guardsize;
+    return 0;
+}
+
+/**
+ * 设置线程创建时是否分离
+ *
+ * @param detachstate: PTHREAD_CREATE_JOINABLE或PTHREAD_CREATE_DETACHED
+ * @return: 成功返回0，取值非法返回EINVAL
+ */
+int pthread_attr_setdetachstate(pthread_attr_t *attr, int detachstate)
+{
+    if (detachstate != PTHREAD_CREATE_JOINABLE && detachstate != PTHREAD_CREATE_DETACHED)
+    {
+        return EINVAL;
+    }
+    attr->detachstate = detachstate;
+    return 0;
+}
+
+int pthread_attr_getdetachstate(const pthread_attr_t *attr, int *detachstate)
+{
+    *detachstate = attr->detachstate;
+    return 0;
+}
+
+/**
+ * 只结束当前线程，不影响进程中的其他线程
+ */
+static void __attribute__((noreturn)) thread_sys_exit(int code)
+{
+    register long x8 asm("x8") = __NR_exit;
+    register long x0 asm("x0") = code;
+
+    for (;;)
+    {
+        asm volatile("svc #0" : : "r"(x8), "r"(x0) : "memory");
+    }
+}
+
+/**
+ * 释放当前线程自己的栈映射并结束线程
+ *
+ * munmap之后栈已不存在，所以两次系统调用在同一段汇编里完成，中间不访问内存。
+ * 先用set_tid_address取消退出时对tid的清零，避免内核写已释放的地址。
+ */
+static void __attribute__((noreturn)) thread_unmap_self_exit(void *base, size_t size)
+{
+    register long x8 asm("x8") = __NR_set_tid_address;
+    register long x0 asm("x0") = 0;
+
+    asm volatile("svc #0" : "+r"(x0) : "r"(x8) : "memory", "cc");
+
+    {
+        register long n8 asm("x8") = __NR_munmap;
+        register long a0 asm("x0") = (long)base;
+        register long a1 asm("x1") = size;
+
+        asm volatile(
+            "svc #0\n\t"
+            "mov x8, #93\n\t"     // __NR_exit
+            "mov x0, #0\n\t"
+            "svc #0"
+            : : "r"(n8), "r"(a0), "r"(a1)
+            : "memory", "cc"
+        );
+    }
+    __builtin_unreachable();
+}
+
+/**
+ * 线程退出的公共路径：保存返回值，分离的线程回收自己的栈
+ */
+static void __attribute__((noreturn)) thread_exit(void *result)
+{
+    struct mini_thread *t = mini_thread_self();
+    struct stack_map map;
+
+    t->result = result;
+
+    // 主线程没有栈映射，只结束自身，进程等其他线程结束后退出
+    if (t->map_base == NULL)
+    {
+        thread_sys_exit(0);
+    }
+
+    if (mini_atomic_exchange(&t->detach_state, THREAD_EXITING, MINI_ATOMIC_ACQ_REL) == THREAD_DETACHED)
+    {
+        // 放进缓存后要等内核清零tid才会被复用，此时还可以继续使用这段栈
+        thread_stack_map(t, &map);
+        if (!stack_cache_try_put(&map))
+        {
+            thread_unmap_self_exit(map.base, map.size);
+        }
+    }
+    thread_sys_exit(0);
+}
+
 /**
  * 线程启动包装函数
- * 负责调用实际的线程函数并清理资源
  */
 static int pthread_start(struct thread_start_args *start_args) 
 {
-    // 调用实际的线程函数
-    start_args->return_value = start_args->start_routine(start_args->arg);
-    
-    // 设置退出标志
-    start_args->has_exited = 1;
-    // 唤醒等待的线程
-    futex(&start_args->has_exited, FUTEX_WAKE, 1, NULL, NULL, 0);    
+    thread_exit(start_args->start_routine(start_args->arg));
 }
 
+/**
+ * 结束调用线程，retval交给pthread_join
+ *
+ * 主线程调用时进程不会立即退出，而是等其他线程都结束。
+ */
+void pthread_exit(void *retval)
+{
+    thread_exit(retval);
+}
+
+/**
+ * 当前线程的标识符，与pthread_create返回的相同
+ */
+pthread_t pthread_self(void)
+{
+    return (pthread_t)mini_thread_self();
+}
 
 /**
  * 创建新线程
  * @param thread: 线程标识符
- * @param attr: 线程属性（本实现忽略）
+ * @param attr: 线程属性，NULL表示使用默认栈大小和保护页，可分离
  * @param start_routine: 线程入口函数
  * @param arg: 传递给线程函数的参数
- * @return: 成功返回0，失败返回错误码
+ * @return: 成功返回0；栈映射或clone失败返回EAGAIN，与POSIX一致，不设置mini_errno
  */
 int pthread_create(pthread_t *thread, const pthread_attr_t *attr,
                   void *(*start_routine)(void*), void *arg)
 {
-    // 分配线程栈
-    void *stack = mmap(NULL, STACK_SIZE,
-                      PROT_READ | PROT_WRITE,
-                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK,  // 添加 MAP_STACK 标志
-                      -1, 0);
-                      
-    if (stack == MAP_FAILED)
-    {
-        return -1;
-    }
+    size_t stack_size = attr ? attr->stacksize : STACK_SIZE;
+    size_t guard = __MINI_ALIGN(attr ? attr->guardsize : GUARD_SIZE, PAGE_SIZE);
+    // 栈顶放线程描述符、TLS和启动参数
+    size_t top = __mini_tls_area_size() + sizeof(struct thread_start_args) + 16;
+    size_t map_size = __MINI_ALIGN(guard + stack_size + top, PAGE_SIZE);
+    struct stack_map map;
 
-    // 分配并初始化启动参数结构
-    struct thread_start_args *start_args = malloc(sizeof(struct thread_start_args));
-    if (start_args == NULL)
+    if (!stack_cache_get(map_size, guard, &map))
     {
-        munmap(stack, STACK_SIZE);
-        return -1;
+        // 分配线程栈
+        map.base = mmap(NULL, map_size,
+                        PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK,  // 添加 MAP_STACK 标志
+                        -1, 0);
+        if (map.base == MAP_FAILED)
+        {
+            return EAGAIN;
+        }
+        if (guard > 0 && mprotect(map.base, guard, PROT_NONE) < 0)
+        {
+            munmap(map.base, map_size);
+            return EAGAIN;
+        }
+        map.size = map_size;
+        map.guard = guard;
     }
 
-    // 初始化启动参数
+    struct mini_thread *t = __mini_tls_setup(map.base, map.size);
+    t->map_base = map.base;
+    t->map_size = map.size;
+    t->guard_size = map.guard;
+    t->detach_state = (attr && attr->detachstate == PTHREAD_CREATE_DETACHED) ?
+                      THREAD_DETACHED : THREAD_JOINABLE;
+    map.tid = &t->tid;
+
+    // 初始化启动参数，其下方即为栈顶(16字节对齐)
+    struct thread_start_args *start_args =
+        (struct thread_start_args *)(((unsigned long)t - sizeof(struct thread_start_args)) & ~15UL);
     start_args->start_routine = start_routine;
     start_args->arg = arg;
-    start_args->stack = stack;
-    start_args->has_exited = 0;
 
-    // 栈顶需要16字节对齐
-    void *stack_top = (void*)(((unsigned long)stack + STACK_SIZE) & ~15UL);
+    void *stack_top = (void *)start_args;
+
+    // 分离的线程可能在clone返回前就已结束并被回收，先写出标识符
+    *thread = (pthread_t)t;
     
+    // 内核在子线程运行前把线程ID写入t->tid，线程退出后清零并唤醒等待者
     int ret = clone(
         (int(*)(void*))pthread_start,
         stack_top,
         PTHREAD_FLAGS,
         start_args,
-        &start_args->tid,
-        NULL,
-        &start_args->tid
+        &t->tid,
+        __mini_thread_tp(t),
+        &t->tid
     );
     
     if (ret < 0)
     {
-        printf("clone failed\n");
-        free(start_args);
-        munmap(stack, STACK_SIZE);
-        return -1;
+        t->tid = 0;
+        stack_cache_put(&map);
+        return EAGAIN;
     }
-    
-    *thread = (pthread_t)start_args;
     return 0;
 }
 
 /**
  * 等待线程结束
+ *
+ * 等待描述符中的tid被内核清零。内核的唤醒不带FUTEX_PRIVATE_FLAG，
+ * 所以这里也用共享futex等待。
+ *
  * @param thread: 要等待的线程标识符
  * @param retval: 用于存储线程返回值的指针
- * @return: 成功返回0，失败返回错误码
+ * @return: 成功返回0，线程已分离返回EINVAL
  */
 int pthread_join(pthread_t thread, void **retval)
 {
-    struct thread_start_args *start_args = (struct thread_start_args*)thread;
+    struct mini_thread *t = (struct mini_thread *)thread;
+    struct stack_map map;
+    int tid;
     
-    if (start_args == NULL)
+    if (t == NULL)
     {
         printf("pthread_join: thread is NULL\n");
         return -1;
     }
+    if (mini_atomic_load(&t->detach_state, MINI_ATOMIC_ACQUIRE) == THREAD_DETACHED)
+    {
+        return EINVAL;
+    }
 
-    // 等待线程退出
-    while (!start_args->has_exited)
+    while ((tid = mini_atomic_load(&t->tid, MINI_ATOMIC_ACQUIRE)) != 0)
     {
-        futex(&start_args->has_exited, FUTEX_WAIT, 0, NULL, NULL, 0);
+        futex(&t->tid, FUTEX_WAIT, tid, NULL, NULL, 0);
     }
 
     if (retval != NULL)
     {
-        *retval = start_args->return_value;
+        *retval = t->result;
     }
 
-    // 清理资源
-    void *stack = start_args->stack;
-    free(start_args);
-    munmap(stack, STACK_SIZE);
-
+    // 线程描述符和TLS都在栈映射里，整段放回缓存
+    thread_stack_map(t, &map);
+    stack_cache_put(&map);
     return 0;
 }
+
+/**
+ * 分离线程，线程结束时自行回收栈
+ *
+ * 线程已经在退出时改为由这里回收，等它结束即可，不会阻塞太久。
+ *
+ * @return: 成功返回0，已分离返回EINVAL
+ */
+int pthread_detach(pthread_t thread)
+{
+    struct mini_thread *t = (struct mini_thread *)thread;
+    int expected = THREAD_JOINABLE;
+
+    if (mini_atomic_cas(&t->detach_state, &expected, THREAD_DETACHED, MINI_ATOMIC_ACQ_REL))
+    {
+        return 0;
+    }
+    if (expected == THREAD_DETACHED)
+    {
+        return EINVAL;
+    }
+    return pthread_join(thread, NULL);
+}
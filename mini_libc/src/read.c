@@ -9,7 +9,7 @@
  * @param fd: 文件描述符
  * @param buf: 接收数据的缓冲区
  * @param count: 要读取的字节数
- * @return: 成功返回读取的字节数，失败返回-1
+ * @return: 成功返回读取的字节数，失败返回-1并设置mini_errno
  */
 ssize_t read(int fd, void *buf, size_t count)
 {
@@ -28,9 +28,117 @@ ssize_t read(int fd, void *buf, size_t count)
     // 检查系统调用返回值
     if (x0 < 0) {
         // 设置错误码并返回-1
+        mini_errno = -x0;
         return -1;
     }
     
     return x0;
 }
 
+/**
+ * readv - 分散读
+ *
+ * 一次系统调用把数据依次读入多个缓冲区，系统调用号为65。
+ *
+ * @param fd: 文件描述符
+ * @param iov: 缓冲区向量
+ * @param iovcnt: 向量个数
+ * @return: 成功返回读取的总字节数，失败返回-1并设置mini_errno
+ */
+ssize_t readv(int fd, const struct iovec *iov, int iovcnt)
+{
+    register long x8 asm("x8") = 65;  // readv系统调用号
+    register long x0 asm("x0") = fd;
+    register long x1 asm("x1") = (long)iov;
+    register long x2 asm("x2") = iovcnt;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+
+    return x0;
+}
+
+/**
+ * pread64 - 定位读
+ *
+ * 从指定偏移读取数据，不使用也不修改文件当前位置，
+ * 多个线程可以对同一个fd并发定位读而不需要加锁。系统调用号为67。
+ *
+ * @param fd: 文件描述符
+ * @param buf: 接收数据的缓冲区
+ * @param count: 要读取的字节数
+ * @param offset: 文件内的64位偏移
+ * @return: 成功返回读取的字节数，失败返回-1并设置mini_errno
+ */
+ssize_t pread64(int fd, void *buf, size_t count, off_t offset)
+{
+    register long x8 asm("x8") = 67;  // pread64系统调用号
+    register long x0 asm("x0") = fd;
+    register long x1 asm("x1") = (long)buf;
+    register long x2 asm("x2") = count;
+    register long x3 asm("x3") = offset;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2), "r"(x3)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+
+    return x0;
+}
+
+/**
+ * preadv2 - 带标志位的定位分散读
+ *
+ * 系统调用号为286。64位平台上偏移量通过pos_l一个寄存器传递，pos_h填0。
+ *
+ * @param fd: 文件描述符
+ * @param iov: 缓冲区向量
+ * @param iovcnt: 向量个数
+ * @param offset: 文件内偏移，-1表示使用并更新文件当前位置
+ * @param flags: RWF_NOWAIT/RWF_HIPRI等标志
+ * @return: 成功返回读取的总字节数，失败返回-1并设置mini_errno
+ *          (RWF_NOWAIT下数据未缓存时mini_errno为EAGAIN)
+ */
+ssize_t preadv2(int fd, const struct iovec *iov, int iovcnt, off_t offset, int flags)
+{
+    register long x8 asm("x8") = 286;  // preadv2系统调用号
+    register long x0 asm("x0") = fd;
+    register long x1 asm("x1") = (long)iov;
+    register long x2 asm("x2") = iovcnt;
+    register long x3 asm("x3") = offset;  // pos_l
+    register long x4 asm("x4") = 0;       // pos_h
+    register long x5 asm("x5") = flags;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2), "r"(x3), "r"(x4), "r"(x5)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+
+    return x0;
+}
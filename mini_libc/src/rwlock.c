@@ -0,0 +1,357 @@
+/**
+ * rwlock.c - 读写锁实现
+ *
+ * 整个锁状态在一个32位字里：写锁位、写者等待位、读者等待位和读者计数。
+ * 没有写者时读者加锁/解锁各是一次原子操作，不进入内核，读多写少时读者之间互不阻塞。
+ *
+ * 读者和写者都在state上futex等待，分别使用不同的bitset(FUTEX_WAIT_BITSET)，
+ * 唤醒时可以只唤醒一个写者，或者一次唤醒全部读者。
+ * 等待位只说明"可能有人在等"：被唤醒的写者拿到锁时会重新置上写者等待位，
+ * 解锁时唤醒不到写者就转而唤醒读者，不会有人因为等待位被清除而永远睡下去。
+ *
+ * 偏好：
+ * - PTHREAD_RWLOCK_PREFER_READER_NP(默认)：只要没有写者持有锁，读者就可以进入，
+ *   持续有读者时写者可能饥饿
+ * - PTHREAD_RWLOCK_PREFER_WRITER_NP：有写者在等待时新来的读者也要等待，
+ *   持有读锁的线程不能再次加读锁，否则会与等待的写者死锁
+ */
+
+#include "mini_lib.h"
+#include "mini_atomic.h"
+
+#define RW_WRITE_LOCKED     0x80000000U
+#define RW_WRITERS_WAITING  0x40000000U
+#define RW_READERS_WAITING  0x20000000U
+#define RW_READER_MASK      0x1fffffffU
+
+/* futex bitset，区分两类等待者 */
+#define RW_WAKE_READERS     1
+#define RW_WAKE_WRITERS     2
+
+/* 进入futex等待前的自旋次数 */
+#define RWLOCK_SPINS        100
+
+static inline int rw_futex_wait(pthread_rwlock_t *rwlock, unsigned int expected, int bitset)
+{
+    return futex((volatile int *)&rwlock->state, FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG,
+                 (int)expected, NULL, NULL, bitset);
+}
+
+static inline int rw_futex_wake(pthread_rwlock_t *rwlock, int count, int bitset)
+{
+    return futex((volatile int *)&rwlock->state, FUTEX_WAKE_BITSET | FUTEX_PRIVATE_FLAG,
+                 count, NULL, NULL, bitset);
+}
+
+/**
+ * 清除读者等待位，之前置位时唤醒全部读者
+ */
+static void rw_wake_readers(pthread_rwlock_t *rwlock)
+{
+    unsigned int old = mini_atomic_fetch_and(&rwlock->state, ~RW_READERS_WAITING, MINI_ATOMIC_RELAXED);
+
+    if (old & RW_READERS_WAITING)
+    {
+        rw_futex_wake(rwlock, FUTEX_WAKE_ALL, RW_WAKE_READERS);
+    }
+}
+
+/**
+ * 唤醒一个写者，一个也没唤醒(等待位是被唤醒的写者保守置上的)时
+ * 转而唤醒可能因为写者等待位而睡下的读者
+ *
+ * @param readers_waiting: 清除写者等待位时读者等待位是否置位
+ */
+static void rw_wake_writer(pthread_rwlock_t *rwlock, int readers_waiting)
+{
+    if (rw_futex_wake(rwlock, 1, RW_WAKE_WRITERS) <= 0 && readers_waiting)
+    {
+        rw_wake_readers(rwlock);
+    }
+}
+
+/**
+ * 当前状态下读者能否进入
+ */
+static inline int rw_can_read(pthread_rwlock_t *rwlock, unsigned int s)
+{
+    if (s & RW_WRITE_LOCKED)
+    {
+        return 0;
+    }
+    if (rwlock->kind == PTHREAD_RWLOCK_PREFER_WRITER_NP && (s & RW_WRITERS_WAITING))
+    {
+        return 0;
+    }
+    return (s & RW_READER_MASK) != RW_READER_MASK;
+}
+
+int pthread_rwlockattr_init(pthread_rwlockattr_t *attr)
+{
+    attr->kind = PTHREAD_RWLOCK_PREFER_READER_NP;
+    return 0;
+}
+
+int pthread_rwlockattr_destroy(pthread_rwlockattr_t *attr)
+{
+    return 0;
+}
+
+/**
+ * 设置读写锁偏好
+ *
+ * @param pref: PTHREAD_RWLOCK_PREFER_READER_NP或PTHREAD_RWLOCK_PREFER_WRITER_NP
+ * @return: 成功返回0，取值非法返回EINVAL
+ */
+int pthread_rwlockattr_setkind_np(pthread_rwlockattr_t *attr, int pref)
+{
+    if (pref != PTHREAD_RWLOCK_PREFER_READER_NP && pref != PTHREAD_RWLOCK_PREFER_WRITER_NP)
+    {
+        return EINVAL;
+    }
+    attr->kind = pref;
+    return 0;
+}
+
+int pthread_rwlockattr_getkind_np(const pthread_rwlockattr_t *attr, int *pref)
+{
+    *pref = attr->kind;
+    return 0;
+}
+
+/**
+ * 初始化读写锁
+ *
+ * @param attr: 属性，NULL表示读者优先
+ */
+int pthread_rwlock_init(pthread_rwlock_t *rwlock, const pthread_rwlockattr_t *attr)
+{
+    rwlock->state = 0;
+    rwlock->writer = 0;
+    rwlock->kind = attr ? attr->kind : PTHREAD_RWLOCK_PREFER_READER_NP;
+    return 0;
+}
+
+int pthread_rwlock_destroy(pthread_rwlock_t *rwlock)
+{
+    return 0;
+}
+
+/**
+ * 尝试加读锁，不等待
+ *
+ * @return: 成功返回0，写者持有(或写者优先时有写者等待)返回EBUSY，读者数溢出返回EAGAIN
+ */
+int pthread_rwlock_tryrdlock(pthread_rwlock_t *rwlock)
+{
+    unsigned int s = mini_atomic_load(&rwlock->state, MINI_ATOMIC_RELAXED);
+
+    while (rw_can_read(rwlock, s))
+    {
+        if (mini_atomic_cas(&rwlock->state, &s, s + 1, MINI_ATOMIC_ACQUIRE))
+        {
+            return 0;
+        }
+    }
+    return (s & RW_READER_MASK) == RW_READER_MASK ? EAGAIN : EBUSY;
+}
+
+/**
+ * 加读锁
+ *
+ * 没有写者时只是一次CAS增加读者计数；否则先自旋，再置读者等待位并休眠。
+ *
+ * @return: 成功返回0，读者数溢出返回EAGAIN
+ */
+int pthread_rwlock_rdlock(pthread_rwlock_t *rwlock)
+{
+    unsigned int s = mini_atomic_load(&rwlock->state, MINI_ATOMIC_RELAXED);
+    int spins = RWLOCK_SPINS;
+
+    for (;;)
+    {
+        if (rw_can_read(rwlock, s))
+        {
+            if (mini_atomic_cas(&rwlock->state, &s, s + 1, MINI_ATOMIC_ACQUIRE))
+            {
+                return 0;
+            }
+            continue;
+        }
+        if ((s & RW_READER_MASK) == RW_READER_MASK)
+        {
+            return EAGAIN;
+        }
+
+        if (spins-- > 0)
+        {
+            __asm__ volatile("yield");
+            s = mini_atomic_load(&rwlock->state, MINI_ATOMIC_RELAXED);
+            continue;
+        }
+
+        // 置上读者等待位后休眠，期间state有任何变化futex都会立即返回
+        if (!(s & RW_READERS_WAITING))
+        {
+            if (!mini_atomic_cas(&rwlock->state, &s, s | RW_READERS_WAITING, MINI_ATOMIC_RELAXED))
+            {
+                continue;
+            }
+            s |= RW_READERS_WAITING;
+        }
+        rw_futex_wait(rwlock, s, RW_WAKE_READERS);
+        s = mini_atomic_load(&rwlock->state, MINI_ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * 尝试加写锁，不等待
+ *
+ * @return: 成功返回0，已被持有返回EBUSY
+ */
+int pthread_rwlock_trywrlock(pthread_rwlock_t *rwlock)
+{
+    unsigned int s = mini_atomic_load(&rwlock->state, MINI_ATOMIC_RELAXED);
+
+    while (!(s & (RW_WRITE_LOCKED | RW_READER_MASK)))
+    {
+        if (mini_atomic_cas(&rwlock->state, &s, s | RW_WRITE_LOCKED, MINI_ATOMIC_ACQUIRE))
+        {
+            rwlock->writer = mini_thread_self()->tid;
+            return 0;
+        }
+    }
+    return EBUSY;
+}
+
+/**
+ * 加写锁
+ *
+ * @return: 成功返回0，调用者已持有写锁返回EDEADLK
+ */
+int pthread_rwlock_wrlock(pthread_rwlock_t *rwlock)
+{
+    int tid = mini_thread_self()->tid;
+    unsigned int s = mini_atomic_load(&rwlock->state, MINI_ATOMIC_RELAXED);
+    unsigned int waiting = 0;
+    int spins = RWLOCK_SPINS;
+
+    if (rwlock->writer == tid)
+    {
+        return EDEADLK;
+    }
+
+    for (;;)
+    {
+        if (!(s & (RW_WRITE_LOCKED | RW_READER_MASK)))
+        {
+            // 睡过的写者不知道是否还有其他写者在等，保守地保留写者等待位
+            if (mini_atomic_cas(&rwlock->state, &s, s | RW_WRITE_LOCKED | waiting, MINI_ATOMIC_ACQUIRE))
+            {
+                rwlock->writer = tid;
+                return 0;
+            }
+            continue;
+        }
+
+        if (spins-- > 0)
+        {
+            __asm__ volatile("yield");
+            s = mini_atomic_load(&rwlock->state, MINI_ATOMIC_RELAXED);
+            continue;
+        }
+
+        if (!(s & RW_WRITERS_WAITING))
+        {
+            if (!mini_atomic_cas(&rwlock->state, &s, s | RW_WRITERS_WAITING, MINI_ATOMIC_RELAXED))
+            {
+                continue;
+            }
+            s |= RW_WRITERS_WAITING;
+        }
+        rw_futex_wait(rwlock, s, RW_WAKE_WRITERS);
+        waiting = RW_WRITERS_WAITING;
+        s = mini_atomic_load(&rwlock->state, MINI_ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * 释放写锁，按偏好唤醒一个写者或全部读者，没被唤醒的一类保留等待位
+ */
+static void rw_write_unlock(pthread_rwlock_t *rwlock)
+{
+    unsigned int s = mini_atomic_load(&rwlock->state, MINI_ATOMIC_RELAXED);
+    unsigned int next;
+    int wake;
+
+    rwlock->writer = 0;
+    for (;;)
+    {
+        if ((s & RW_WRITERS_WAITING) &&
+            (rwlock->kind == PTHREAD_RWLOCK_PREFER_WRITER_NP || !(s & RW_READERS_WAITING)))
+        {
+            next = s & RW_READERS_WAITING;
+            wake = RW_WAKE_WRITERS;
+        }
+        else if (s & RW_READERS_WAITING)
+        {
+            next = s & RW_WRITERS_WAITING;
+            wake = RW_WAKE_READERS;
+        }
+        else
+        {
+            next = 0;
+            wake = 0;
+        }
+        if (mini_atomic_cas(&rwlock->state, &s, next, MINI_ATOMIC_RELEASE))
+        {
+            break;
+        }
+    }
+
+    if (wake == RW_WAKE_WRITERS)
+    {
+        rw_wake_writer(rwlock, next & RW_READERS_WAITING);
+    }
+    else if (wake == RW_WAKE_READERS)
+    {
+        rw_futex_wake(rwlock, FUTEX_WAKE_ALL, RW_WAKE_READERS);
+    }
+}
+
+/**
+ * 释放读锁，最后一个读者离开且有写者等待时唤醒一个写者
+ */
+static void rw_read_unlock(pthread_rwlock_t *rwlock)
+{
+    unsigned int s = mini_atomic_fetch_sub(&rwlock->state, 1, MINI_ATOMIC_RELEASE) - 1;
+
+    while ((s & RW_READER_MASK) == 0 && (s & RW_WRITERS_WAITING))
+    {
+        if (mini_atomic_cas(&rwlock->state, &s, s & ~RW_WRITERS_WAITING, MINI_ATOMIC_RELAXED))
+        {
+            rw_wake_writer(rwlock, s & RW_READERS_WAITING);
+            break;
+        }
+    }
+}
+
+/**
+ * 解锁，调用者持有写锁时释放写锁，否则释放一个读锁
+ *
+ * @return: 成功返回0，调用者既未持有写锁、锁上也没有读者时返回EPERM
+ */
+int pthread_rwlock_unlock(pthread_rwlock_t *rwlock)
+{
+    if (rwlock->writer != 0 && rwlock->writer == mini_thread_self()->tid)
+    {
+        rw_write_unlock(rwlock);
+        return 0;
+    }
+    if ((mini_atomic_load(&rwlock->state, MINI_ATOMIC_RELAXED) & RW_READER_MASK) == 0)
+    {
+        return EPERM;
+    }
+    rw_read_unlock(rwlock);
+    return 0;
+}
@@ -0,0 +1,137 @@
+/**
+ * sched.c - aarch64平台调度相关系统调用实现
+ *
+ * 实现了以下功能：
+ * - CPU亲和性设置与查询
+ * - 主动让出CPU
+ * - 可用CPU数统计
+ */
+
+#include "mini_lib.h"
+
+/* 系统调用号定义 */
+#define __NR_sched_setaffinity  122
+#define __NR_sched_getaffinity  123
+#define __NR_sched_yield        124
+
+/**
+ * 设置线程的CPU亲和性
+ *
+ * @param pid: 线程ID，0表示调用线程
+ * @param cpusetsize: mask的字节数，一般为sizeof(cpu_set_t)
+ * @param mask: 允许运行的CPU集合
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int sched_setaffinity(pid_t pid, size_t cpusetsize, const cpu_set_t *mask)
+{
+    register long x8 asm("x8") = __NR_sched_setaffinity;
+    register long x0 asm("x0") = pid;
+    register long x1 asm("x1") = cpusetsize;
+    register long x2 asm("x2") = (long)mask;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 查询线程的CPU亲和性
+ *
+ * 内核只写入实际CPU数对应的字节，这里先把mask清零。
+ *
+ * @param pid: 线程ID，0表示调用线程
+ * @param cpusetsize: mask的字节数
+ * @param mask: 输出允许运行的CPU集合
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int sched_getaffinity(pid_t pid, size_t cpusetsize, cpu_set_t *mask)
+{
+    memset(mask, 0, cpusetsize);
+
+    register long x8 asm("x8") = __NR_sched_getaffinity;
+    register long x0 asm("x0") = pid;
+    register long x1 asm("x1") = cpusetsize;
+    register long x2 asm("x2") = (long)mask;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 主动让出CPU
+ *
+ * @return: 总是返回0
+ */
+int sched_yield(void)
+{
+    register long x8 asm("x8") = __NR_sched_yield;
+    register long x0 asm("x0");
+
+    asm volatile(
+        "svc #0"
+        : "=r"(x0)
+        : "r"(x8)
+        : "memory", "cc"
+    );
+
+    return 0;
+}
+
+/**
+ * 统计CPU集合中的CPU个数
+ */
+int cpu_set_count(const cpu_set_t *set)
+{
+    int count = 0;
+    int i;
+
+    for (i = 0; i < CPU_SETSIZE / 64; i++)
+    {
+        unsigned long bits = set->bits[i];
+        while (bits)
+        {
+            bits &= bits - 1;
+            count++;
+        }
+    }
+    return count;
+}
+
+/**
+ * 获取当前进程可以使用的CPU数
+ *
+ * 以调用线程的亲和性为准，容器/taskset限制的CPU不计入。
+ *
+ * @return: 可用CPU数，查询失败时返回1
+ */
+int get_nprocs(void)
+{
+    cpu_set_t set;
+
+    if (sched_getaffinity(0, sizeof(set), &set) < 0)
+    {
+        return 1;
+    }
+    return cpu_set_count(&set);
+}
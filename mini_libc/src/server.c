@@ -0,0 +1,249 @@
+/**
+ * server.c - 基于SO_REUSEPORT的多线程TCP服务器骨架
+ *
+ * 每个worker线程拥有独立的监听socket和epoll事件循环，所有监听socket
+ * 用SO_REUSEPORT绑定同一端口，由内核按四元组哈希把新连接分给各个socket。
+ * worker之间没有共享的accept队列和锁，连接一旦落到某个worker，
+ * 其后的读写都在该worker的事件循环中完成，可以随CPU数线性扩展。
+ *
+ * 所有资源(监听socket、事件循环、线程)都在主线程中创建，
+ * worker线程只负责绑核和运行事件循环。
+ */
+
+#include "mini_lib.h"
+
+#define SERVER_DEFAULT_BACKLOG  1024
+
+/**
+ * 创建一个SO_REUSEPORT监听socket并按配置设置选项
+ *
+ * 缓冲区大小和TCP_NODELAY设置在监听socket上，accept得到的连接会继承。
+ *
+ * @return: 成功返回监听fd，失败返回-1并设置mini_errno
+ */
+static int server_listen(const struct server_config *cfg)
+{
+    struct sockaddr_in addr;
+    int on = 1;
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0)
+    {
+        goto fail;
+    }
+    if (cfg->tcp_nodelay && setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)) < 0)
+    {
+        goto fail;
+    }
+    if (cfg->sndbuf > 0 &&
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &cfg->sndbuf, sizeof(cfg->sndbuf)) < 0)
+    {
+        goto fail;
+    }
+    if (cfg->rcvbuf > 0 &&
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &cfg->rcvbuf, sizeof(cfg->rcvbuf)) < 0)
+    {
+        goto fail;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(cfg->port);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(fd, cfg->backlog > 0 ? cfg->backlog : SERVER_DEFAULT_BACKLOG) < 0)
+    {
+        goto fail;
+    }
+    return fd;
+
+fail:
+    {
+        int err = mini_errno;
+        close(fd);
+        mini_errno = err;
+    }
+    return -1;
+}
+
+/**
+ * worker线程入口：绑核后运行事件循环直到server_stop
+ */
+static void *server_worker_main(void *arg)
+{
+    struct server_worker *w = (struct server_worker *)arg;
+    struct server *srv = w->srv;
+
+    if (w->cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(w->cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) < 0)
+        {
+            LOG_ERROR("worker %d: pin to cpu %d failed, errno=%d", w->id, w->cpu, mini_errno);
+        }
+    }
+
+    if (srv->cfg.on_worker_start)
+    {
+        srv->cfg.on_worker_start(w->loop, w->id, srv->cfg.arg);
+    }
+
+    LOG_DEBUG("worker %d running on cpu %d, listen fd %d", w->id, w->cpu, w->listen_fd);
+    event_loop_run(w->loop);
+    return NULL;
+}
+
+/**
+ * 释放前n个worker的监听socket和事件循环
+ */
+static void server_release(struct server *srv, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        struct server_worker *w = &srv->workers[i];
+        if (w->loop)
+        {
+            event_loop_destroy(w->loop);
+        }
+        if (w->listen_fd >= 0)
+        {
+            close(w->listen_fd);
+        }
+    }
+    free(srv->workers);
+    srv->workers = NULL;
+    srv->nworkers = 0;
+}
+
+/**
+ * 启动服务器
+ *
+ * 按配置为每个worker创建监听socket和事件循环，然后启动worker线程。
+ * 任意一步失败都会回收已创建的资源。
+ *
+ * @param srv: 服务器对象
+ * @param cfg: 配置，on_accept不能为空
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int server_start(struct server *srv, const struct server_config *cfg)
+{
+    cpu_set_t allowed;
+    int cpus[CPU_SETSIZE];
+    int ncpus = 0;
+    int i;
+
+    if (cfg->on_accept == NULL)
+    {
+        mini_errno = EINVAL;
+        return -1;
+    }
+
+    memset(srv, 0, sizeof(*srv));
+    srv->cfg = *cfg;
+
+    // 只在进程允许运行的CPU上放置worker
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+    {
+        for (i = 0; i < CPU_SETSIZE; i++)
+        {
+            if (CPU_ISSET(i, &allowed))
+            {
+                cpus[ncpus++] = i;
+            }
+        }
+    }
+
+    srv->nworkers = cfg->workers > 0 ? cfg->workers : (ncpus > 0 ? ncpus : 1);
+    srv->workers = malloc(srv->nworkers * sizeof(struct server_worker));
+    if (srv->workers == NULL)
+    {
+        mini_errno = ENOMEM;
+        return -1;
+    }
+
+    for (i = 0; i < srv->nworkers; i++)
+    {
+        struct server_worker *w = &srv->workers[i];
+
+        w->srv = srv;
+        w->id = i;
+        w->cpu = (cfg->pin_cpus && ncpus > 0) ? cpus[i % ncpus] : -1;
+        w->loop = NULL;
+        w->listen_fd = server_listen(cfg);
+        if (w->listen_fd < 0)
+        {
+            LOG_ERROR("worker %d: listen on port %d failed, errno=%d", i, cfg->port, mini_errno);
+            server_release(srv, i + 1);
+            return -1;
+        }
+
+        w->loop = event_loop_create(cfg->max_fds);
+        if (w->loop == NULL ||
+            event_loop_add_listener(w->loop, w->listen_fd, cfg->on_accept, cfg->arg) < 0)
+        {
+            LOG_ERROR("worker %d: event loop setup failed, errno=%d", i, mini_errno);
+            server_release(srv, i + 1);
+            return -1;
+        }
+    }
+
+    for (i = 0; i < srv->nworkers; i++)
+    {
+        if (pthread_create(&srv->workers[i].thread, NULL, server_worker_main, &srv->workers[i]) != 0)
+        {
+            int started = i;
+
+            LOG_ERROR("worker %d: pthread_create failed", i);
+            for (i = 0; i < started; i++)
+            {
+                event_loop_stop(srv->workers[i].loop);
+                pthread_join(srv->workers[i].thread, NULL);
+            }
+            server_release(srv, srv->nworkers);
+            mini_errno = ENOMEM;
+            return -1;
+        }
+    }
+
+    LOG_INFO("server listening on port %d with %d workers", cfg->port, srv->nworkers);
+    return 0;
+}
+
+/**
+ * 通知所有worker退出事件循环，可在任意线程(包括worker回调)中调用
+ */
+void server_stop(struct server *srv)
+{
+    int i;
+
+    for (i = 0; i < srv->nworkers; i++)
+    {
+        event_loop_stop(srv->workers[i].loop);
+    }
+}
+
+/**
+ * 等待所有worker退出并释放资源，只能在启动服务器的线程中调用
+ *
+ * 仍然打开的连接由调用者在回调中自行管理。
+ */
+void server_wait(struct server *srv)
+{
+    int i;
+
+    for (i = 0; i < srv->nworkers; i++)
+    {
+        pthread_join(srv->workers[i].thread, NULL);
+    }
+    server_release(srv, srv->nworkers);
+}
@@ -9,6 +9,9 @@
  * - 监听连接
  * - 接受连接
  * - 数据收发
+ * - 带地址的数据报收发(sendto/recvfrom)
+ * - 消息收发与批量消息收发(sendmsg/recvmsg/sendmmsg/recvmmsg)
+ * - socket选项设置与读取
  * 
  * 所有函数都使用内联汇编直接调用Linux系统调用实现，
  * 不依赖任何外部库。
@@ -16,17 +19,22 @@
 
 #include "mini_lib.h"
 
-/* 全局错误码变量 */
-static int mini_errno;
-
 /* Linux系统调用号定义 */
 #define __NR_socket      198  // 创建socket
+#define __NR_socketpair 199   // 创建一对已连接的socket
 #define __NR_connect    203   // 连接到远程地址
 #define __NR_bind       200   // 绑定本地地址
 #define __NR_listen     201   // 监听连接
 #define __NR_accept     202   // 接受连接
+#define __NR_accept4    242   // 接受连接并设置标志
 #define __NR_sendto     206   // 发送数据
 #define __NR_recvfrom   207   // 接收数据
+#define __NR_setsockopt 208   // 设置socket选项
+#define __NR_getsockopt 209   // 读取socket选项
+#define __NR_sendmsg    211   // 发送消息
+#define __NR_recvmsg    212   // 接收消息
+#define __NR_recvmmsg   243   // 批量接收消息
+#define __NR_sendmmsg   269   // 批量发送消息
 #define __NR_close      57    // 关闭socket
 
 /**
@@ -44,6 +52,23 @@ unsigned short htons(unsigned short hostshort)
     return ((hostshort & 0xFF) << 8) | ((hostshort & 0xFF00) >> 8);
 }
 
+/**
+ * 将网络字节序转换为主机字节序(16位)
+ */
+unsigned short ntohs(unsigned short netshort)
+{
+    return htons(netshort);
+}
+
+/**
+ * 将主机字节序转换为网络字节序(32位)
+ */
+uint32_t htonl(uint32_t hostlong)
+{
+    return ((hostlong & 0xFF) << 24) | ((hostlong & 0xFF00) << 8) |
+           ((hostlong & 0xFF0000) >> 8) | ((hostlong & 0xFF000000) >> 24);
+}
+
 /**
  * 创建一个新的socket
  * 
@@ -218,6 +243,41 @@ int accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen)
     return x0;
 }
 
+/**
+ * 接受一个新的连接并设置文件描述符标志
+ * 
+ * 与accept相同，但可以在同一次系统调用中把新连接设置为非阻塞/CLOEXEC，
+ * 省去额外的fcntl调用。
+ * 
+ * @param sockfd   socket文件描述符
+ * @param addr     用于存储客户端地址的结构体
+ * @param addrlen  地址结构体长度的指针
+ * @param flags    SOCK_NONBLOCK | SOCK_CLOEXEC
+ * @return         成功返回新的socket文件描述符，失败返回-1并设置mini_errno
+ *                 (非阻塞监听socket上没有待处理连接时为EAGAIN)
+ */
+int accept4(int sockfd, struct sockaddr *addr, socklen_t *addrlen, int flags)
+{
+    register long x8 asm("x8") = __NR_accept4;
+    register long x0 asm("x0") = sockfd;
+    register long x1 asm("x1") = (long)addr;
+    register long x2 asm("x2") = (long)addrlen;
+    register long x3 asm("x3") = flags;
+    
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x0), "r"(x1), "r"(x2), "r"(x3)
+        : "memory", "cc"
+    );
+    
+    if (x0 < 0) {
+        mini_errno = -x0;
+        return -1;
+    }
+    return x0;
+}
+
 /**
  * 发送数据
  * 
@@ -227,6 +287,8 @@ int accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen)
  * x1 = buf (数据缓冲区)
  * x2 = len (数据长度)
  * x3 = flags (发送标志)
+ * x4 = dest_addr (NULL，已连接socket)
+ * x5 = addrlen (0)
  * 
  * @param sockfd   socket文件描述符
  * @param buf      要发送的数据缓冲区
@@ -241,13 +303,13 @@ ssize_t send(int sockfd, const void *buf, size_t len, int flags)
     register long x1 asm("x1") = (long)buf;
     register long x2 asm("x2") = len;
     register long x3 asm("x3") = flags;
-    register long x4 asm("x4") = 0;   // src_addr = NULL
-    register long x5 asm("x5") = 0;   // addrlen = NULL
+    register long x4 asm("x4") = 0;   // dest_addr = NULL
+    register long x5 asm("x5") = 0;   // addrlen = 0
     
     asm volatile(
         "svc #0"
         : "+r"(x0)
-        : "r"(x8), "r"(x0), "r"(x1), "r"(x2), "r"(x3)  // 添加x0作为输入
+        : "r"(x8), "r"(x1), "r"(x2), "r"(x3), "r"(x4), "r"(x5)
         : "memory", "cc"
     );
     
@@ -276,9 +338,6 @@ ssize_t send(int sockfd, const void *buf, size_t len, int flags)
  */
 ssize_t recv(int sockfd, void *buf, size_t len, int flags)
 {
-    printf("DEBUG: recv called with sockfd=%d, buf=%lx, len=%lx, flags=%d\n", 
-           sockfd, (unsigned long)buf, (unsigned long)len, flags);
-
     register long x8 asm("x8") = __NR_recvfrom;
     register long x0 asm("x0") = sockfd;
     register long x1 asm("x1") = (long)buf;
@@ -296,10 +355,340 @@ ssize_t recv(int sockfd, void *buf, size_t len, int flags)
     
     if (x0 < 0) {
         mini_errno = -x0;
-        printf("DEBUG: recv failed with errno=%d\n", mini_errno);
         return -1;
     }
     
-    printf("DEBUG: recv succeeded, returned %ld bytes\n", x0);
     return x0;
 }
+
+/**
+ * 创建一对相互连接的匿名socket
+ *
+ * @param domain   协议族，只支持AF_UNIX
+ * @param type     SOCK_STREAM/SOCK_DGRAM/SOCK_SEQPACKET，可或上SOCK_NONBLOCK/SOCK_CLOEXEC
+ * @param protocol 协议(通常为0)
+ * @param sv       输出两个socket文件描述符
+ * @return         成功返回0，失败返回-1并设置mini_errno
+ */
+int socketpair(int domain, int type, int protocol, int sv[2])
+{
+    register long x8 asm("x8") = __NR_socketpair;
+    register long x0 asm("x0") = domain;
+    register long x1 asm("x1") = type;
+    register long x2 asm("x2") = protocol;
+    register long x3 asm("x3") = (long)sv;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2), "r"(x3)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 向指定地址发送数据报
+ *
+ * @param sockfd    socket文件描述符
+ * @param buf       待发送数据
+ * @param len       数据长度
+ * @param flags     发送标志(MSG_xxx)
+ * @param dest_addr 目标地址，已连接的socket可为NULL
+ * @param addrlen   地址长度
+ * @return          成功返回发送的字节数，失败返回-1并设置mini_errno
+ */
+ssize_t sendto(int sockfd, const void *buf, size_t len, int flags,
+               const struct sockaddr *dest_addr, socklen_t addrlen)
+{
+    register long x8 asm("x8") = __NR_sendto;
+    register long x0 asm("x0") = sockfd;
+    register long x1 asm("x1") = (long)buf;
+    register long x2 asm("x2") = len;
+    register long x3 asm("x3") = flags;
+    register long x4 asm("x4") = (long)dest_addr;
+    register long x5 asm("x5") = addrlen;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2), "r"(x3), "r"(x4), "r"(x5)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return x0;
+}
+
+/**
+ * 接收数据报并返回来源地址
+ *
+ * @param sockfd    socket文件描述符
+ * @param buf       接收缓冲区
+ * @param len       缓冲区长度
+ * @param flags     接收标志(MSG_xxx)
+ * @param src_addr  输出来源地址，可为NULL
+ * @param addrlen   输入为src_addr缓冲区长度，输出为实际地址长度
+ * @return          成功返回接收的字节数，失败返回-1并设置mini_errno
+ */
+ssize_t recvfrom(int sockfd, void *buf, size_t len, int flags,
+                 struct sockaddr *src_addr, socklen_t *addrlen)
+{
+    register long x8 asm("x8") = __NR_recvfrom;
+    register long x0 asm("x0") = sockfd;
+    register long x1 asm("x1") = (long)buf;
+    register long x2 asm("x2") = len;
+    register long x3 asm("x3") = flags;
+    register long x4 asm("x4") = (long)src_addr;
+    register long x5 asm("x5") = (long)addrlen;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2), "r"(x3), "r"(x4), "r"(x5)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return x0;
+}
+
+/**
+ * 发送一条消息，支持分散数据和控制消息(cmsg)
+ *
+ * @param sockfd socket文件描述符
+ * @param msg    消息头
+ * @param flags  发送标志(MSG_xxx)
+ * @return       成功返回发送的字节数，失败返回-1并设置mini_errno
+ */
+ssize_t sendmsg(int sockfd, const struct msghdr *msg, int flags)
+{
+    register long x8 asm("x8") = __NR_sendmsg;
+    register long x0 asm("x0") = sockfd;
+    register long x1 asm("x1") = (long)msg;
+    register long x2 asm("x2") = flags;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return x0;
+}
+
+/**
+ * 接收一条消息，内核回写msg_namelen/msg_controllen/msg_flags
+ *
+ * @param sockfd socket文件描述符
+ * @param msg    消息头
+ * @param flags  接收标志(MSG_xxx)
+ * @return       成功返回接收的字节数，失败返回-1并设置mini_errno
+ */
+ssize_t recvmsg(int sockfd, struct msghdr *msg, int flags)
+{
+    register long x8 asm("x8") = __NR_recvmsg;
+    register long x0 asm("x0") = sockfd;
+    register long x1 asm("x1") = (long)msg;
+    register long x2 asm("x2") = flags;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return x0;
+}
+
+/**
+ * 一次系统调用发送多条消息
+ *
+ * 每条消息实际发送的字节数写回msgvec[i].msg_len。
+ *
+ * @param sockfd socket文件描述符
+ * @param msgvec 消息数组
+ * @param vlen   消息个数(内核上限UIO_MAXIOV=1024)
+ * @param flags  发送标志(MSG_xxx)
+ * @return       成功返回发送的消息条数(可能小于vlen)，失败返回-1并设置mini_errno
+ */
+int sendmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags)
+{
+    register long x8 asm("x8") = __NR_sendmmsg;
+    register long x0 asm("x0") = sockfd;
+    register long x1 asm("x1") = (long)msgvec;
+    register long x2 asm("x2") = vlen;
+    register long x3 asm("x3") = flags;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2), "r"(x3)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return (int)x0;
+}
+
+/**
+ * 一次系统调用接收多条消息
+ *
+ * 配合MSG_WAITFORONE时，收到第一条消息后不再阻塞，
+ * 有多少取多少，适合事件驱动的接收循环。
+ *
+ * @param sockfd  socket文件描述符
+ * @param msgvec  消息数组，每条消息的长度写回msg_len
+ * @param vlen    消息个数
+ * @param flags   接收标志(MSG_xxx)
+ * @param timeout 超时时间，NULL表示不超时
+ * @return        成功返回接收的消息条数，失败返回-1并设置mini_errno
+ */
+int recvmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen, int flags,
+             struct timespec *timeout)
+{
+    register long x8 asm("x8") = __NR_recvmmsg;
+    register long x0 asm("x0") = sockfd;
+    register long x1 asm("x1") = (long)msgvec;
+    register long x2 asm("x2") = vlen;
+    register long x3 asm("x3") = flags;
+    register long x4 asm("x4") = (long)timeout;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2), "r"(x3), "r"(x4)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return (int)x0;
+}
+
+/**
+ * 设置socket选项
+ *
+ * @param sockfd  socket文件描述符
+ * @param level   选项所在协议层(SOL_SOCKET/SOL_UDP/IPPROTO_TCP等)
+ * @param optname 选项名
+ * @param optval  选项值
+ * @param optlen  选项值长度
+ * @return        成功返回0，失败返回-1并设置mini_errno
+ */
+int setsockopt(int sockfd, int level, int optname, const void *optval, socklen_t optlen)
+{
+    register long x8 asm("x8") = __NR_setsockopt;
+    register long x0 asm("x0") = sockfd;
+    register long x1 asm("x1") = level;
+    register long x2 asm("x2") = optname;
+    register long x3 asm("x3") = (long)optval;
+    register long x4 asm("x4") = optlen;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2), "r"(x3), "r"(x4)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 读取socket选项
+ *
+ * @param sockfd  socket文件描述符
+ * @param level   选项所在协议层
+ * @param optname 选项名
+ * @param optval  输出选项值
+ * @param optlen  输入为optval缓冲区长度，输出为实际长度
+ * @return        成功返回0，失败返回-1并设置mini_errno
+ */
+int getsockopt(int sockfd, int level, int optname, void *optval, socklen_t *optlen)
+{
+    register long x8 asm("x8") = __NR_getsockopt;
+    register long x0 asm("x0") = sockfd;
+    register long x1 asm("x1") = level;
+    register long x2 asm("x2") = optname;
+    register long x3 asm("x3") = (long)optval;
+    register long x4 asm("x4") = (long)optlen;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2), "r"(x3), "r"(x4)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 取msghdr控制缓冲区中cmsg之后的下一条控制消息
+ *
+ * @param msg  消息头
+ * @param cmsg 当前控制消息
+ * @return     下一条控制消息，没有则返回NULL
+ */
+struct cmsghdr *cmsg_nxthdr(struct msghdr *msg, struct cmsghdr *cmsg)
+{
+    unsigned char *end = (unsigned char *)msg->msg_control + msg->msg_controllen;
+    unsigned char *next;
+
+    if (cmsg->cmsg_len < sizeof(struct cmsghdr))
+    {
+        return NULL;
+    }
+
+    next = (unsigned char *)cmsg + CMSG_ALIGN(cmsg->cmsg_len);
+    if (next + sizeof(struct cmsghdr) > end ||
+        next + CMSG_ALIGN(((struct cmsghdr *)next)->cmsg_len) > end)
+    {
+        return NULL;
+    }
+    return (struct cmsghdr *)next;
+}
@@ -0,0 +1,156 @@
+/**
+ * spinlock.c - 票号自旋锁与MCS队列锁
+ *
+ * 互斥锁的自旋阶段所有等待者反复读写同一个lock字，每次解锁时全部等待者的
+ * 缓存行同时失效再一起抢，核心越多流量越大。这里提供两种只适合短临界区、
+ * 从不进入内核的锁：
+ * - pthread_spin_*: 票号锁，一个32位字，取票用一次原子加，按先来后到进入。
+ *   等待者仍然共享一个缓存行，但解锁只是一次普通的release存储，不会互相抢
+ * - mcs_lock_*: MCS队列锁，每个等待者只在自己的节点上等待，
+ *   解锁只写下一个等待者的节点，交接开销与等待者数量无关
+ *
+ * 两者都用mini_atomic_wait_32/64以WFE等待，不做yield忙等。
+ */
+
+#include "mini_lib.h"
+#include "mini_atomic.h"
+
+#define SPIN_OWNER_MASK     0xffffu
+#define SPIN_NEXT_SHIFT     16
+#define SPIN_NEXT_ONE       (1u << SPIN_NEXT_SHIFT)
+
+/**
+ * 初始化自旋锁，pshared被忽略：锁不依赖futex，进程间共享内存中同样可用
+ */
+int pthread_spin_init(pthread_spinlock_t *lock, int pshared)
+{
+    lock->ticket = 0;
+    return 0;
+}
+
+int pthread_spin_destroy(pthread_spinlock_t *lock)
+{
+    return 0;
+}
+
+/**
+ * 取一张票，等到owner轮到它
+ *
+ * 其他线程取票也会改写这个字，等待者可能被提前唤醒，重新比较即可
+ */
+int pthread_spin_lock(pthread_spinlock_t *lock)
+{
+    uint32_t val = mini_atomic_fetch_add_32(&lock->ticket, SPIN_NEXT_ONE, MINI_ATOMIC_ACQUIRE);
+    uint32_t ticket = val >> SPIN_NEXT_SHIFT;
+
+    while ((val & SPIN_OWNER_MASK) != ticket)
+    {
+        val = mini_atomic_wait_32(&lock->ticket, val);
+    }
+    return 0;
+}
+
+/**
+ * 尝试加锁，只在当前无人持有也无人排队时取票
+ *
+ * @return: 成功返回0，锁被占用返回EBUSY
+ */
+int pthread_spin_trylock(pthread_spinlock_t *lock)
+{
+    uint32_t val = mini_atomic_load_32(&lock->ticket, MINI_ATOMIC_RELAXED);
+
+    if ((val & SPIN_OWNER_MASK) != (val >> SPIN_NEXT_SHIFT))
+    {
+        return EBUSY;
+    }
+    return mini_atomic_cas_32(&lock->ticket, &val, val + SPIN_NEXT_ONE, MINI_ATOMIC_ACQUIRE) ? 0 : EBUSY;
+}
+
+/**
+ * 解锁：owner加1
+ *
+ * owner只有持有者会修改，直接对低16位做一次release存储(小端下位于偏移0)，
+ * 不需要原子加，也不会和同时取票的线程冲突
+ */
+int pthread_spin_unlock(pthread_spinlock_t *lock)
+{
+    uint16_t owner = (uint16_t)(lock->ticket & SPIN_OWNER_MASK);
+
+    mini_atomic_store_16((volatile uint16_t *)&lock->ticket, (uint16_t)(owner + 1), MINI_ATOMIC_RELEASE);
+    return 0;
+}
+
+void mcs_lock_init(struct mcs_lock *lock)
+{
+    lock->tail = NULL;
+}
+
+/**
+ * 把node挂到队尾，等前驱把锁交过来
+ *
+ * @param node: 调用者提供的节点，保持有效直到mcs_lock_release返回
+ */
+void mcs_lock_acquire(struct mcs_lock *lock, struct mcs_node *node)
+{
+    struct mcs_node *prev;
+    uint32_t locked;
+
+    node->next = NULL;
+    node->locked = 1;
+
+    // release让前驱看到初始化好的节点，acquire在队列为空时直接获得锁
+    prev = (struct mcs_node *)(uintptr_t)mini_atomic_exchange_64(
+        (volatile uint64_t *)&lock->tail, (uint64_t)(uintptr_t)node, MINI_ATOMIC_ACQ_REL);
+    if (prev == NULL)
+    {
+        return;
+    }
+
+    mini_atomic_store_64((volatile uint64_t *)&prev->next, (uint64_t)(uintptr_t)node, MINI_ATOMIC_RELEASE);
+
+    locked = mini_atomic_load_32((volatile uint32_t *)&node->locked, MINI_ATOMIC_ACQUIRE);
+    while (locked != 0)
+    {
+        locked = mini_atomic_wait_32((volatile uint32_t *)&node->locked, locked);
+    }
+}
+
+/**
+ * 尝试加锁，只在队列为空时成功
+ *
+ * @return: 成功返回0，锁被占用返回EBUSY
+ */
+int mcs_lock_tryacquire(struct mcs_lock *lock, struct mcs_node *node)
+{
+    uint64_t expected = 0;
+
+    node->next = NULL;
+    node->locked = 0;
+    return mini_atomic_cas_64((volatile uint64_t *)&lock->tail, &expected,
+                              (uint64_t)(uintptr_t)node, MINI_ATOMIC_ACQUIRE) ? 0 : EBUSY;
+}
+
+/**
+ * 解锁，把锁交给队列中的下一个节点
+ *
+ * 没有后继时把tail从node改回NULL；CAS失败说明有线程已经交换了tail，
+ * 但还没来得及链接到node->next，等它链接完成再交接。
+ */
+void mcs_lock_release(struct mcs_lock *lock, struct mcs_node *node)
+{
+    uint64_t next = mini_atomic_load_64((volatile uint64_t *)&node->next, MINI_ATOMIC_ACQUIRE);
+
+    if (next == 0)
+    {
+        uint64_t expected = (uint64_t)(uintptr_t)node;
+
+        if (mini_atomic_cas_64((volatile uint64_t *)&lock->tail, &expected, 0, MINI_ATOMIC_RELEASE))
+        {
+            return;
+        }
+        next = mini_atomic_wait_64((volatile uint64_t *)&node->next, 0);
+    }
+
+    mini_atomic_store_32((volatile uint32_t *)&((struct mcs_node *)(uintptr_t)next)->locked, 0,
+                         MINI_ATOMIC_RELEASE);
+}
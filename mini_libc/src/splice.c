@@ -0,0 +1,338 @@
+/**
+ * splice.c - aarch64平台零拷贝传输实现
+ *
+ * 实现了以下系统调用封装：
+ * - pipe2: 创建管道
+ * - sendfile: 文件到fd的内核内拷贝
+ * - splice: 管道与任意fd之间移动数据
+ * - tee: 在两个管道之间复制数据而不消费
+ * - vmsplice: 把用户内存页映射进管道
+ *
+ * 并在此基础上实现了把文件区域发送到socket的file_stream，
+ * 数据全程只在内核中流动，不经过用户态缓冲区。
+ */
+
+#include "mini_lib.h"
+
+/* 系统调用号定义 */
+#define __NR_pipe2      59
+#define __NR_sendfile   71
+#define __NR_vmsplice   75
+#define __NR_splice     76
+#define __NR_tee        77
+
+/* 单次splice/sendfile最多搬运的字节数，避免一次占用socket过久 */
+#define FILE_STREAM_CHUNK   (1 << 20)
+
+/**
+ * 创建管道
+ *
+ * @param pipefd: 输出，pipefd[0]为读端，pipefd[1]为写端
+ * @param flags: O_NONBLOCK/O_CLOEXEC
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int pipe2(int pipefd[2], int flags)
+{
+    register long x8 asm("x8") = __NR_pipe2;
+    register long x0 asm("x0") = (long)pipefd;
+    register long x1 asm("x1") = flags;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 在内核中把in_fd的数据拷贝到out_fd
+ *
+ * @param out_fd: 目标fd(通常为socket)
+ * @param in_fd: 源fd，必须支持mmap(普通文件)
+ * @param offset: 读取偏移，非NULL时不修改in_fd的文件位置并回写新偏移
+ * @param count: 最多拷贝的字节数
+ * @return: 成功返回拷贝的字节数，失败返回-1并设置mini_errno
+ */
+ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count)
+{
+    register long x8 asm("x8") = __NR_sendfile;
+    register long x0 asm("x0") = out_fd;
+    register long x1 asm("x1") = in_fd;
+    register long x2 asm("x2") = (long)offset;
+    register long x3 asm("x3") = count;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2), "r"(x3)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return x0;
+}
+
+/**
+ * 在管道与fd之间移动数据，fd_in和fd_out至少一个是管道
+ *
+ * @param fd_in: 源fd
+ * @param off_in: 源偏移，源为管道时必须为NULL
+ * @param fd_out: 目标fd
+ * @param off_out: 目标偏移，目标为管道时必须为NULL
+ * @param len: 最多移动的字节数
+ * @param flags: SPLICE_F_xxx
+ * @return: 成功返回移动的字节数，0表示源已到结尾，失败返回-1并设置mini_errno
+ */
+ssize_t splice(int fd_in, off_t *off_in, int fd_out, off_t *off_out, size_t len, unsigned int flags)
+{
+    register long x8 asm("x8") = __NR_splice;
+    register long x0 asm("x0") = fd_in;
+    register long x1 asm("x1") = (long)off_in;
+    register long x2 asm("x2") = fd_out;
+    register long x3 asm("x3") = (long)off_out;
+    register long x4 asm("x4") = len;
+    register long x5 asm("x5") = flags;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2), "r"(x3), "r"(x4), "r"(x5)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return x0;
+}
+
+/**
+ * 把fd_in管道中的数据复制到fd_out管道，fd_in中的数据不被消费
+ *
+ * 常用于把同一份数据同时送往两个目的地(例如日志分流)。
+ *
+ * @return: 成功返回复制的字节数，失败返回-1并设置mini_errno
+ */
+ssize_t tee(int fd_in, int fd_out, size_t len, unsigned int flags)
+{
+    register long x8 asm("x8") = __NR_tee;
+    register long x0 asm("x0") = fd_in;
+    register long x1 asm("x1") = fd_out;
+    register long x2 asm("x2") = len;
+    register long x3 asm("x3") = flags;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2), "r"(x3)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return x0;
+}
+
+/**
+ * 把用户内存页接入管道
+ *
+ * 配合SPLICE_F_GIFT时页面所有权交给内核，调用者之后不能再修改这些页。
+ *
+ * @param fd: 管道写端
+ * @param iov: 用户内存向量
+ * @param nr_segs: 向量个数
+ * @param flags: SPLICE_F_xxx
+ * @return: 成功返回接入的字节数，失败返回-1并设置mini_errno
+ */
+ssize_t vmsplice(int fd, const struct iovec *iov, unsigned long nr_segs, unsigned int flags)
+{
+    register long x8 asm("x8") = __NR_vmsplice;
+    register long x0 asm("x0") = fd;
+    register long x1 asm("x1") = (long)iov;
+    register long x2 asm("x2") = nr_segs;
+    register long x3 asm("x3") = flags;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2), "r"(x3)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return x0;
+}
+
+/**
+ * 初始化文件流
+ *
+ * @param fs: 文件流
+ * @param sock: 目标socket
+ * @param file_fd: 源文件
+ * @param offset: 起始偏移
+ * @param count: 要发送的字节数
+ * @return: 成功返回0
+ */
+int file_stream_init(struct file_stream *fs, int sock, int file_fd, off_t offset, size_t count)
+{
+    fs->sock = sock;
+    fs->file_fd = file_fd;
+    fs->offset = offset;
+    fs->remaining = count;
+    fs->pipefd[0] = -1;
+    fs->pipefd[1] = -1;
+    fs->in_pipe = 0;
+    fs->sent = 0;
+    return 0;
+}
+
+/**
+ * 通过中转管道发送：文件 -> 管道 -> socket
+ *
+ * @return: 1表示全部发送完成，0表示socket暂时不可写，-1表示出错
+ */
+static int file_stream_send_splice(struct file_stream *fs)
+{
+    if (fs->pipefd[0] < 0 && pipe2(fs->pipefd, O_NONBLOCK | O_CLOEXEC) < 0)
+    {
+        return -1;
+    }
+
+    while (fs->in_pipe > 0 || fs->remaining > 0)
+    {
+        // 管道空了再从文件灌入，管道中可能残留上次没发完的数据
+        if (fs->in_pipe == 0)
+        {
+            size_t chunk = fs->remaining < FILE_STREAM_CHUNK ? fs->remaining : FILE_STREAM_CHUNK;
+            ssize_t n = splice(fs->file_fd, &fs->offset, fs->pipefd[1], NULL, chunk,
+                               SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n < 0)
+            {
+                // 管道为空，文件读不会阻塞，被信号打断时直接重试
+                if (mini_errno == EINTR)
+                {
+                    continue;
+                }
+                return -1;
+            }
+            if (n == 0)
+            {
+                // 文件提前结束
+                fs->remaining = 0;
+                break;
+            }
+            fs->in_pipe = n;
+            fs->remaining -= n;
+        }
+
+        unsigned int flags = SPLICE_F_MOVE | SPLICE_F_NONBLOCK;
+        if (fs->remaining > 0)
+        {
+            flags |= SPLICE_F_MORE;
+        }
+
+        ssize_t n = splice(fs->pipefd[0], NULL, fs->sock, NULL, fs->in_pipe, flags);
+        if (n < 0)
+        {
+            if (mini_errno == EAGAIN)
+            {
+                return 0;
+            }
+            if (mini_errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        fs->in_pipe -= n;
+        fs->sent += n;
+    }
+
+    return 1;
+}
+
+/**
+ * 继续发送文件流
+ *
+ * 阻塞socket上一次调用发送完全部数据；非阻塞socket上发送缓冲区满时返回0，
+ * 调用者应等待EPOLLOUT后再次调用。
+ *
+ * @param fs: 文件流
+ * @return: 1表示全部发送完成，0表示socket暂时不可写，-1表示出错(mini_errno为错误码)
+ */
+int file_stream_send(struct file_stream *fs)
+{
+    // 已经切换到splice路径，或管道中还有残留数据
+    if (fs->pipefd[0] >= 0)
+    {
+        return file_stream_send_splice(fs);
+    }
+
+    while (fs->remaining > 0)
+    {
+        size_t chunk = fs->remaining < FILE_STREAM_CHUNK ? fs->remaining : FILE_STREAM_CHUNK;
+        ssize_t n = sendfile(fs->sock, fs->file_fd, &fs->offset, chunk);
+        if (n < 0)
+        {
+            if (mini_errno == EAGAIN)
+            {
+                return 0;
+            }
+            if (mini_errno == EINTR)
+            {
+                continue;
+            }
+            // 该fd组合不支持sendfile，改走splice
+            if (mini_errno == EINVAL || mini_errno == ENOSYS)
+            {
+                return file_stream_send_splice(fs);
+            }
+            return -1;
+        }
+        if (n == 0)
+        {
+            // 文件提前结束
+            fs->remaining = 0;
+            break;
+        }
+        fs->remaining -= n;
+        fs->sent += n;
+    }
+
+    return 1;
+}
+
+/**
+ * 释放文件流占用的中转管道，不关闭socket和文件
+ */
+void file_stream_close(struct file_stream *fs)
+{
+    if (fs->pipefd[0] >= 0)
+    {
+        close(fs->pipefd[0]);
+        close(fs->pipefd[1]);
+        fs->pipefd[0] = -1;
+        fs->pipefd[1] = -1;
+    }
+}
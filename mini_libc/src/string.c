@@ -151,3 +151,54 @@ int strncmp(const char *s1, const char *s2, size_t n)
     
     return *(const unsigned char*)s1 - *(const unsigned char*)s2;
 }
+
+
+/**
+ * 在内存块中查找字节
+ *
+ * 先逐字节走到8字节对齐，再每次比较8个字节：把目标字节复制到每个字节位置，
+ * 异或后某个字节为0即表示命中，用 (x - 0x01..01) & ~x & 0x80..80 一次判断。
+ *
+ * @param s: 内存块起始地址
+ * @param c: 要查找的字节
+ * @param n: 内存块长度
+ * @return: 第一个匹配字节的地址，找不到返回NULL
+ */
+void *memchr(const void *s, int c, size_t n)
+{
+    const unsigned char *p = (const unsigned char *)s;
+    unsigned char ch = (unsigned char)c;
+    unsigned long pattern = ch * 0x0101010101010101UL;
+
+    while (n > 0 && ((uintptr_t)p & 7))
+    {
+        if (*p == ch)
+        {
+            return (void *)p;
+        }
+        p++;
+        n--;
+    }
+
+    while (n >= 8)
+    {
+        unsigned long x = *(const unsigned long *)p ^ pattern;
+        if ((x - 0x0101010101010101UL) & ~x & 0x8080808080808080UL)
+        {
+            break;
+        }
+        p += 8;
+        n -= 8;
+    }
+
+    while (n > 0)
+    {
+        if (*p == ch)
+        {
+            return (void *)p;
+        }
+        p++;
+        n--;
+    }
+    return NULL;
+}
@@ -0,0 +1,596 @@
+/**
+ * thread_pool.c - 工作窃取线程池与parallel_for/parallel_reduce
+ *
+ * 每个并行单元都pthread_create/pthread_join一次，代价是一次clone、
+ * 一次栈映射和一次futex等待，几十微秒起步，细粒度的并行完全不划算。
+ * 线程池的线程常驻，提交一个任务只是往自己的队列里压入一个指针：
+ * - 每个工作线程一个Chase-Lev双端队列。所有者在底部压入/弹出不需要原子读-改-写，
+ *   只在队列只剩一个任务、可能与窃取者冲突时才做CAS；窃取者在顶部用CAS取任务
+ * - fork-join：spawn把任务压入自己的队列，sync时先弹出自己的任务直接执行，
+ *   任务已被窃取时转去窃取其他任务，不空等
+ * - 找不到任务的线程先自旋窃取一阵，再在work_seq上futex休眠。
+ *   有线程在自旋时提交任务不唤醒任何线程，自旋的线程会找到它；
+ *   最后一个自旋的线程找到任务后再唤醒一个休眠的线程接替，工作逐步扩散
+ * - 非工作线程提交的任务进入由互斥锁保护的注入队列，任务放在调用者提供的内存中，
+ *   整个过程不调用malloc
+ */
+
+#include "mini_lib.h"
+#include "mini_atomic.h"
+
+#define POOL_DEQUE_SIZE         1024    /* 每个队列的容量，2的幂 */
+#define POOL_SPIN_ROUNDS        64      /* 休眠前窃取的轮数 */
+#define POOL_CHUNKS_PER_WORKER  8       /* 自动粒度：每个工作线程平均分到的块数 */
+
+/* 任务状态 */
+#define TASK_PENDING    0
+#define TASK_DONE       1
+#define TASK_WAITING    2   /* 未完成，且有非工作线程在futex上等待 */
+
+struct pool_deque
+{
+    volatile long top __attribute__((aligned(64)));     /* 窃取端，只增不减 */
+    volatile long bottom __attribute__((aligned(64)));  /* 所有者端 */
+    struct pool_task *volatile tasks[POOL_DEQUE_SIZE];
+};
+
+struct pool_worker
+{
+    struct pool_deque deque;
+    struct thread_pool *pool;
+    pthread_t thread;
+    unsigned int seed;      /* 选择窃取对象的随机数状态 */
+};
+
+/**
+ * 所有者在底部压入任务
+ *
+ * @return: 成功返回0，队列已满返回-1
+ */
+static int deque_push(struct pool_deque *d, struct pool_task *task)
+{
+    long b = d->bottom;
+    long t = mini_atomic_load(&d->top, MINI_ATOMIC_ACQUIRE);
+
+    if (b - t >= POOL_DEQUE_SIZE)
+    {
+        return -1;
+    }
+    d->tasks[b & (POOL_DEQUE_SIZE - 1)] = task;
+    // release保证窃取者看到新的bottom时也能看到任务指针
+    mini_atomic_store(&d->bottom, b + 1, MINI_ATOMIC_RELEASE);
+    return 0;
+}
+
+/**
+ * 所有者从底部弹出最近压入的任务
+ *
+ * 先减bottom再读top，两者之间的全屏障与窃取端对应：
+ * 只剩一个任务时双方都可能看到它，用top上的CAS决定归属。
+ */
+static struct pool_task *deque_pop(struct pool_deque *d)
+{
+    long b = d->bottom - 1;
+    long t;
+    struct pool_task *task;
+
+    mini_atomic_store(&d->bottom, b, MINI_ATOMIC_RELAXED);
+    mini_atomic_fence(MINI_ATOMIC_SEQ_CST);
+    t = mini_atomic_load(&d->top, MINI_ATOMIC_RELAXED);
+
+    if (t > b)
+    {
+        mini_atomic_store(&d->bottom, b + 1, MINI_ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    task = d->tasks[b & (POOL_DEQUE_SIZE - 1)];
+    if (t == b)
+    {
+        if (!mini_atomic_cas(&d->top, &t, t + 1, MINI_ATOMIC_SEQ_CST))
+        {
+            task = NULL;    // 被窃取者抢走
+        }
+        mini_atomic_store(&d->bottom, b + 1, MINI_ATOMIC_RELAXED);
+    }
+    return task;
+}
+
+/**
+ * 从顶部窃取最早压入的任务
+ *
+ * @return: 任务，队列为空或与其他线程竞争失败返回NULL
+ */
+static struct pool_task *deque_steal(struct pool_deque *d)
+{
+    long t = mini_atomic_load(&d->top, MINI_ATOMIC_ACQUIRE);
+    long b;
+    struct pool_task *task;
+
+    mini_atomic_fence(MINI_ATOMIC_SEQ_CST);
+    b = mini_atomic_load(&d->bottom, MINI_ATOMIC_ACQUIRE);
+    if (t >= b)
+    {
+        return NULL;
+    }
+
+    // 容量固定，top推进之前所有者不会覆盖这个槽
+    task = d->tasks[t & (POOL_DEQUE_SIZE - 1)];
+    if (!mini_atomic_cas(&d->top, &t, t + 1, MINI_ATOMIC_SEQ_CST))
+    {
+        return NULL;
+    }
+    return task;
+}
+
+/**
+ * 当前线程在pool中的工作线程数据，不是pool的工作线程返回NULL
+ */
+static struct pool_worker *pool_self(struct thread_pool *pool)
+{
+    struct pool_worker *w = (struct pool_worker *)mini_thread_self()->pool_worker;
+
+    return (w != NULL && w->pool == pool) ? w : NULL;
+}
+
+static void pool_wake(struct thread_pool *pool, int count)
+{
+    mini_atomic_fetch_add(&pool->work_seq, 1, MINI_ATOMIC_SEQ_CST);
+    futex(&pool->work_seq, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, count, NULL, NULL, 0);
+}
+
+/**
+ * 有新任务可取，需要时唤醒一个休眠的线程
+ *
+ * 任务已经发布后再检查searching和sleepers，与休眠前"先登记sleepers再检查任务"
+ * 对应，两边至少有一方能看到对方
+ */
+static void pool_notify(struct thread_pool *pool)
+{
+    mini_atomic_fence(MINI_ATOMIC_SEQ_CST);
+    if (mini_atomic_load(&pool->searching, MINI_ATOMIC_RELAXED) == 0 &&
+        mini_atomic_load(&pool->sleepers, MINI_ATOMIC_RELAXED) > 0)
+    {
+        pool_wake(pool, 1);
+    }
+}
+
+static void pool_inject(struct thread_pool *pool, struct pool_task *task)
+{
+    pthread_mutex_lock(&pool->inject_lock);
+    if (pool->inject_tail != NULL)
+    {
+        pool->inject_tail->next = task;
+    }
+    else
+    {
+        pool->inject_head = task;
+    }
+    pool->inject_tail = task;
+    mini_atomic_fetch_add(&pool->inject_count, 1, MINI_ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&pool->inject_lock);
+
+    pool_notify(pool);
+}
+
+static struct pool_task *pool_inject_pop(struct thread_pool *pool)
+{
+    struct pool_task *task;
+
+    if (mini_atomic_load(&pool->inject_count, MINI_ATOMIC_ACQUIRE) == 0)
+    {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&pool->inject_lock);
+    task = pool->inject_head;
+    if (task != NULL)
+    {
+        pool->inject_head = task->next;
+        if (pool->inject_head == NULL)
+        {
+            pool->inject_tail = NULL;
+        }
+        mini_atomic_fetch_sub(&pool->inject_count, 1, MINI_ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&pool->inject_lock);
+    return task;
+}
+
+/**
+ * 从随机选择的工作线程开始依次窃取，最后看注入队列
+ */
+static struct pool_task *pool_find_task(struct thread_pool *pool, struct pool_worker *self)
+{
+    int n = pool->nworkers;
+    unsigned int start;
+    int i;
+
+    self->seed ^= self->seed << 13;
+    self->seed ^= self->seed >> 17;
+    self->seed ^= self->seed << 5;
+    start = self->seed % (unsigned int)n;
+
+    for (i = 0; i < n; i++)
+    {
+        struct pool_worker *victim = &pool->workers[(start + i) % n];
+        struct pool_task *task;
+
+        if (victim == self)
+        {
+            continue;
+        }
+        task = deque_steal(&victim->deque);
+        if (task != NULL)
+        {
+            return task;
+        }
+    }
+    return pool_inject_pop(pool);
+}
+
+/**
+ * 执行任务并标记完成，有线程在futex上等待时唤醒它
+ */
+static void pool_task_run(struct pool_task *task)
+{
+    task->fn(task->arg);
+    if (mini_atomic_exchange(&task->state, TASK_DONE, MINI_ATOMIC_RELEASE) == TASK_WAITING)
+    {
+        futex(&task->state, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, FUTEX_WAKE_ALL, NULL, NULL, 0);
+    }
+}
+
+/**
+ * 自己的队列已空时找任务：先自旋窃取，找不到再休眠
+ *
+ * @return: 任务，线程池正在销毁时返回NULL
+ */
+static struct pool_task *pool_search(struct thread_pool *pool, struct pool_worker *self)
+{
+    for (;;)
+    {
+        struct pool_task *task;
+        int seq;
+        int i;
+
+        mini_atomic_fetch_add(&pool->searching, 1, MINI_ATOMIC_SEQ_CST);
+        for (i = 0; i < POOL_SPIN_ROUNDS; i++)
+        {
+            task = pool_find_task(pool, self);
+            if (task != NULL)
+            {
+                // 最后一个自旋的线程找到了任务，可能还有更多，唤醒一个接替自旋
+                if (mini_atomic_fetch_sub(&pool->searching, 1, MINI_ATOMIC_SEQ_CST) == 1)
+                {
+                    pool_notify(pool);
+                }
+                return task;
+            }
+            __asm__ volatile("yield");
+        }
+        mini_atomic_fetch_sub(&pool->searching, 1, MINI_ATOMIC_SEQ_CST);
+
+        // 先登记再检查一次，提交者要么看到sleepers，要么任务在这里被找到
+        seq = mini_atomic_load(&pool->work_seq, MINI_ATOMIC_SEQ_CST);
+        mini_atomic_fetch_add(&pool->sleepers, 1, MINI_ATOMIC_SEQ_CST);
+        task = pool_find_task(pool, self);
+        if (task == NULL && !mini_atomic_load(&pool->stop, MINI_ATOMIC_ACQUIRE))
+        {
+            futex(&pool->work_seq, FUTEX_WAIT | FUTEX_PRIVATE_FLAG, seq, NULL, NULL, 0);
+        }
+        mini_atomic_fetch_sub(&pool->sleepers, 1, MINI_ATOMIC_SEQ_CST);
+
+        if (task != NULL)
+        {
+            return task;
+        }
+        if (mini_atomic_load(&pool->stop, MINI_ATOMIC_ACQUIRE))
+        {
+            return NULL;
+        }
+    }
+}
+
+static void *pool_worker_main(void *arg)
+{
+    struct pool_worker *self = (struct pool_worker *)arg;
+    struct thread_pool *pool = self->pool;
+
+    mini_thread_self()->pool_worker = self;
+    for (;;)
+    {
+        struct pool_task *task = deque_pop(&self->deque);
+
+        if (task == NULL)
+        {
+            task = pool_search(pool, self);
+            if (task == NULL)
+            {
+                break;
+            }
+        }
+        pool_task_run(task);
+    }
+    mini_thread_self()->pool_worker = NULL;
+    return NULL;
+}
+
+/**
+ * 创建线程池
+ *
+ * @param nthreads: 工作线程数，<=0时取可用CPU数，最多THREAD_POOL_MAX_WORKERS
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int thread_pool_init(struct thread_pool *pool, int nthreads)
+{
+    size_t size;
+    int i;
+
+    if (nthreads <= 0)
+    {
+        nthreads = get_nprocs();
+    }
+    if (nthreads > THREAD_POOL_MAX_WORKERS)
+    {
+        nthreads = THREAD_POOL_MAX_WORKERS;
+    }
+
+    memset(pool, 0, sizeof(*pool));
+    pthread_mutex_init(&pool->inject_lock, NULL);
+
+    size = __MINI_ALIGN(sizeof(struct pool_worker) * nthreads, 4096);
+    pool->workers = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    pool->workers_size = size;
+    if (pool->workers == MAP_FAILED || pool->workers == NULL)
+    {
+        pool->workers = NULL;
+        return -1;
+    }
+    for (i = 0; i < nthreads; i++)
+    {
+        pool->workers[i].pool = pool;
+        pool->workers[i].seed = (unsigned int)i * 2654435761U + 1;
+    }
+
+    // 先确定线程数，先启动的线程会窃取还没启动的线程的(空)队列
+    pool->nworkers = nthreads;
+    for (i = 0; i < nthreads; i++)
+    {
+        int err = pthread_create(&pool->workers[i].thread, NULL, pool_worker_main, &pool->workers[i]);
+        if (err != 0)
+        {
+            // pthread_create返回错误码(EAGAIN)而不设置mini_errno，回收后再写入
+            pool->nworkers = i;
+            thread_pool_destroy(pool);
+            mini_errno = err;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * 停止并回收全部工作线程，调用前所有任务都应已sync
+ */
+void thread_pool_destroy(struct thread_pool *pool)
+{
+    int i;
+
+    if (pool->workers == NULL)
+    {
+        return;
+    }
+
+    mini_atomic_store(&pool->stop, 1, MINI_ATOMIC_RELEASE);
+    pool_wake(pool, FUTEX_WAKE_ALL);
+    for (i = 0; i < pool->nworkers; i++)
+    {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+
+    munmap(pool->workers, pool->workers_size);
+    pool->workers = NULL;
+}
+
+/**
+ * 提交任务，之后必须对同一个task调用thread_pool_sync
+ *
+ * 工作线程压入自己的队列，队列满时直接执行；其他线程放入注入队列。
+ */
+void thread_pool_spawn(struct thread_pool *pool, struct pool_task *task, void (*fn)(void *), void *arg)
+{
+    struct pool_worker *self = pool_self(pool);
+
+    task->fn = fn;
+    task->arg = arg;
+    task->state = TASK_PENDING;
+    task->next = NULL;
+
+    if (self == NULL)
+    {
+        pool_inject(pool, task);
+        return;
+    }
+    if (deque_push(&self->deque, task) < 0)
+    {
+        pool_task_run(task);
+        return;
+    }
+    pool_notify(pool);
+}
+
+/**
+ * 等待任务完成
+ *
+ * 工作线程在等待期间执行自己队列中的任务(通常就是要等的这个)或窃取其他任务；
+ * 其他线程在任务的state上futex等待。
+ */
+void thread_pool_sync(struct thread_pool *pool, struct pool_task *task)
+{
+    struct pool_worker *self = pool_self(pool);
+
+    if (self == NULL)
+    {
+        int state = mini_atomic_load(&task->state, MINI_ATOMIC_ACQUIRE);
+
+        while (state != TASK_DONE)
+        {
+            if (state == TASK_PENDING &&
+                !mini_atomic_cas(&task->state, &state, TASK_WAITING, MINI_ATOMIC_ACQUIRE))
+            {
+                continue;   // state已更新为当前值
+            }
+            futex(&task->state, FUTEX_WAIT | FUTEX_PRIVATE_FLAG, TASK_WAITING, NULL, NULL, 0);
+            state = mini_atomic_load(&task->state, MINI_ATOMIC_ACQUIRE);
+        }
+        return;
+    }
+
+    while (mini_atomic_load(&task->state, MINI_ATOMIC_ACQUIRE) != TASK_DONE)
+    {
+        struct pool_task *other = deque_pop(&self->deque);
+
+        if (other == NULL)
+        {
+            other = pool_find_task(pool, self);
+        }
+        if (other != NULL)
+        {
+            pool_task_run(other);
+        }
+        else
+        {
+            __asm__ volatile("yield");
+        }
+    }
+}
+
+/*
+ * parallel_for/parallel_reduce: 区间对半拆分，右半作为任务提交，左半由自己继续拆分，
+ * 长度不超过grain时直接执行。空闲线程窃取到的总是最早提交、最大的那一半。
+ */
+struct pool_range
+{
+    struct thread_pool *pool;
+    long begin;
+    long end;
+    long grain;
+    pool_for_fn for_fn;
+    pool_reduce_fn reduce_fn;
+    pool_combine_fn combine;
+    void *arg;
+    long result;
+};
+
+static void pool_range_run(void *p)
+{
+    struct pool_range *r = (struct pool_range *)p;
+    struct pool_range left, right;
+    struct pool_task task;
+    long mid;
+
+    if (r->end - r->begin <= r->grain)
+    {
+        if (r->for_fn != NULL)
+        {
+            r->for_fn(r->arg, r->begin, r->end);
+        }
+        else
+        {
+            r->result = r->reduce_fn(r->arg, r->begin, r->end);
+        }
+        return;
+    }
+
+    mid = r->begin + (r->end - r->begin) / 2;
+    left = *r;
+    left.end = mid;
+    right = *r;
+    right.begin = mid;
+
+    thread_pool_spawn(r->pool, &task, pool_range_run, &right);
+    pool_range_run(&left);
+    thread_pool_sync(r->pool, &task);
+
+    if (r->for_fn == NULL)
+    {
+        r->result = r->combine(r->arg, left.result, right.result);
+    }
+}
+
+/**
+ * 自动粒度：每个工作线程平均分到POOL_CHUNKS_PER_WORKER块，
+ * 块数足够多时负载能靠窃取摊平，拆分的开销又不随区间长度增长
+ */
+static long pool_grain(struct thread_pool *pool, long begin, long end, long grain)
+{
+    if (grain > 0)
+    {
+        return grain;
+    }
+    grain = (end - begin) / ((long)pool->nworkers * POOL_CHUNKS_PER_WORKER);
+    return grain > 0 ? grain : 1;
+}
+
+static void pool_range_start(struct pool_range *r)
+{
+    struct pool_task task;
+
+    // 非工作线程调用时整个区间作为一个任务提交，自己等待完成
+    thread_pool_spawn(r->pool, &task, pool_range_run, r);
+    thread_pool_sync(r->pool, &task);
+}
+
+/**
+ * 并行执行fn(arg, lo, hi)，各子区间互不重叠且合起来正好是[begin, end)
+ *
+ * @param grain: 子区间最大长度，<=0时自动选择
+ */
+void parallel_for(struct thread_pool *pool, long begin, long end, long grain,
+                  pool_for_fn fn, void *arg)
+{
+    struct pool_range r;
+
+    if (end <= begin)
+    {
+        return;
+    }
+    memset(&r, 0, sizeof(r));
+    r.pool = pool;
+    r.begin = begin;
+    r.end = end;
+    r.grain = pool_grain(pool, begin, end, grain);
+    r.for_fn = fn;
+    r.arg = arg;
+    pool_range_start(&r);
+}
+
+/**
+ * 并行归约：每个子区间由fn计算，相邻结果用combine两两合并
+ *
+ * combine需满足结合律，合并顺序固定为左在前，不要求交换律
+ *
+ * @param identity: 区间为空时的返回值
+ * @return: 归约结果
+ */
+long parallel_reduce(struct thread_pool *pool, long begin, long end, long grain, long identity,
+                     pool_reduce_fn fn, pool_combine_fn combine, void *arg)
+{
+    struct pool_range r;
+
+    if (end <= begin)
+    {
+        return identity;
+    }
+    memset(&r, 0, sizeof(r));
+    r.pool = pool;
+    r.begin = begin;
+    r.end = end;
+    r.grain = pool_grain(pool, begin, end, grain);
+    r.reduce_fn = fn;
+    r.combine = combine;
+    r.arg = arg;
+    pool_range_start(&r);
+    return r.result;
+}
@@ -0,0 +1,443 @@
+/**
+ * time.c - 时间接口与vDSO解析
+ *
+ * 内核把一小段共享库(vDSO)映射进每个进程，其中的__kernel_clock_gettime等
+ * 函数直接读取内核维护的时间数据页和CNTVCT_EL0计数器，不需要陷入内核，
+ * 一次调用只要几十纳秒，而系统调用要几百纳秒。
+ *
+ * vDSO的位置由辅助向量AT_SYSINFO_EHDR给出。这里解析它的ELF动态段，
+ * 在动态符号表中按名字和版本(arm64为LINUX_2.6.39)查找函数地址。
+ * 找不到vDSO(或对应符号)时，各接口退回普通系统调用。
+ */
+
+#include "mini_lib.h"
+
+/* 系统调用号定义 */
+#define __NR_clock_gettime  113
+#define __NR_clock_getres   114
+#define __NR_gettimeofday   169
+
+/* arm64 vDSO导出符号的版本 */
+#define VDSO_VERSION        "LINUX_2.6.39"
+
+/* 频率校准时的测量时长 */
+#define CALIBRATE_NS        10000000L
+
+/* ELF定义，只包含解析vDSO需要的部分 */
+#define ELFMAG0         0x7f
+#define PT_LOAD         1
+#define PT_DYNAMIC      2
+#define DT_NULL         0
+#define DT_HASH         4
+#define DT_STRTAB       5
+#define DT_SYMTAB       6
+#define DT_GNU_HASH     0x6ffffef5
+#define DT_VERSYM       0x6ffffff0
+#define DT_VERDEF       0x6ffffffc
+#define STT_FUNC        2
+#define STB_GLOBAL      1
+#define STB_WEAK        2
+#define SHN_UNDEF       0
+#define VER_FLG_BASE    0x1
+
+typedef struct
+{
+    unsigned char e_ident[16];
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint64_t e_entry;
+    uint64_t e_phoff;
+    uint64_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+} vdso_ehdr_t;
+
+typedef struct
+{
+    uint32_t p_type;
+    uint32_t p_flags;
+    uint64_t p_offset;
+    uint64_t p_vaddr;
+    uint64_t p_paddr;
+    uint64_t p_filesz;
+    uint64_t p_memsz;
+    uint64_t p_align;
+} vdso_phdr_t;
+
+typedef struct
+{
+    int64_t d_tag;
+    uint64_t d_val;
+} vdso_dyn_t;
+
+typedef struct
+{
+    uint32_t st_name;
+    unsigned char st_info;
+    unsigned char st_other;
+    uint16_t st_shndx;
+    uint64_t st_value;
+    uint64_t st_size;
+} vdso_sym_t;
+
+typedef struct
+{
+    uint16_t vd_version;
+    uint16_t vd_flags;
+    uint16_t vd_ndx;
+    uint16_t vd_cnt;
+    uint32_t vd_hash;
+    uint32_t vd_aux;
+    uint32_t vd_next;
+} vdso_verdef_t;
+
+typedef struct
+{
+    uint32_t vda_name;
+    uint32_t vda_next;
+} vdso_verdaux_t;
+
+/* 解析结果 */
+static struct
+{
+    unsigned long load_offset;      /* 运行地址 - 链接地址 */
+    const char *strtab;
+    const vdso_sym_t *symtab;
+    uint32_t nsyms;
+    const uint16_t *versym;
+    const vdso_verdef_t *verdef;
+} g_vdso;
+
+typedef int (*vdso_clock_fn)(int, struct timespec *);
+typedef int (*vdso_gettimeofday_fn)(struct timeval *, void *);
+
+static vdso_clock_fn g_vdso_clock_gettime;
+static vdso_clock_fn g_vdso_clock_getres;
+static vdso_gettimeofday_fn g_vdso_gettimeofday;
+
+static uint64_t g_cycles_freq;
+
+/**
+ * 根据GNU哈希表计算动态符号个数(表中没有直接记录)
+ */
+static uint32_t vdso_gnu_hash_nsyms(const uint32_t *gh)
+{
+    uint32_t nbuckets = gh[0];
+    uint32_t symoffset = gh[1];
+    uint32_t bloom_size = gh[2];
+    const uint32_t *buckets = gh + 4 + bloom_size * 2;  // bloom字为64位
+    const uint32_t *chain = buckets + nbuckets;
+    uint32_t max = 0;
+    uint32_t i;
+
+    for (i = 0; i < nbuckets; i++)
+    {
+        if (buckets[i] > max)
+        {
+            max = buckets[i];
+        }
+    }
+    if (max < symoffset)
+    {
+        return symoffset;
+    }
+    // 链的最后一项最低位为1
+    while (!(chain[max - symoffset] & 1))
+    {
+        max++;
+    }
+    return max + 1;
+}
+
+/**
+ * 解析vDSO并绑定时间函数，由__mini_libc_init调用
+ *
+ * @param base: AT_SYSINFO_EHDR的值，0表示没有vDSO
+ */
+void vdso_init(unsigned long base)
+{
+    const vdso_ehdr_t *ehdr = (const vdso_ehdr_t *)base;
+    const vdso_phdr_t *phdr;
+    const vdso_dyn_t *dyn = NULL;
+    const uint32_t *hash = NULL;
+    const uint32_t *gnu_hash = NULL;
+    int found_load = 0;
+    int i;
+
+    memset(&g_vdso, 0, sizeof(g_vdso));
+    g_vdso_clock_gettime = NULL;
+    g_vdso_clock_getres = NULL;
+    g_vdso_gettimeofday = NULL;
+
+    if (base == 0 || ehdr->e_ident[0] != ELFMAG0 || ehdr->e_ident[1] != 'E' ||
+        ehdr->e_ident[2] != 'L' || ehdr->e_ident[3] != 'F')
+    {
+        return;
+    }
+
+    phdr = (const vdso_phdr_t *)(base + ehdr->e_phoff);
+    for (i = 0; i < ehdr->e_phnum; i++)
+    {
+        if (phdr[i].p_type == PT_LOAD && !found_load)
+        {
+            found_load = 1;
+            g_vdso.load_offset = base + phdr[i].p_offset - phdr[i].p_vaddr;
+        }
+        else if (phdr[i].p_type == PT_DYNAMIC)
+        {
+            dyn = (const vdso_dyn_t *)(base + phdr[i].p_offset);
+        }
+    }
+    if (!found_load || dyn == NULL)
+    {
+        return;
+    }
+
+    // 动态段中的地址都是链接地址，需要加上load_offset
+    for (; dyn->d_tag != DT_NULL; dyn++)
+    {
+        unsigned long addr = dyn->d_val + g_vdso.load_offset;
+        switch (dyn->d_tag)
+        {
+            case DT_STRTAB:   g_vdso.strtab = (const char *)addr; break;
+            case DT_SYMTAB:   g_vdso.symtab = (const vdso_sym_t *)addr; break;
+            case DT_HASH:     hash = (const uint32_t *)addr; break;
+            case DT_GNU_HASH: gnu_hash = (const uint32_t *)addr; break;
+            case DT_VERSYM:   g_vdso.versym = (const uint16_t *)addr; break;
+            case DT_VERDEF:   g_vdso.verdef = (const vdso_verdef_t *)addr; break;
+            default: break;
+        }
+    }
+    if (g_vdso.strtab == NULL || g_vdso.symtab == NULL || (hash == NULL && gnu_hash == NULL))
+    {
+        return;
+    }
+
+    // SysV哈希表的nchain就是符号个数
+    g_vdso.nsyms = hash ? hash[1] : vdso_gnu_hash_nsyms(gnu_hash);
+    if (g_vdso.versym == NULL || g_vdso.verdef == NULL)
+    {
+        g_vdso.versym = NULL;
+    }
+
+    g_vdso_clock_gettime = (vdso_clock_fn)vdso_sym(VDSO_VERSION, "__kernel_clock_gettime");
+    g_vdso_clock_getres = (vdso_clock_fn)vdso_sym(VDSO_VERSION, "__kernel_clock_getres");
+    g_vdso_gettimeofday = (vdso_gettimeofday_fn)vdso_sym(VDSO_VERSION, "__kernel_gettimeofday");
+}
+
+/**
+ * 检查第sym_index个符号的版本是否为version
+ */
+static int vdso_match_version(uint32_t sym_index, const char *version)
+{
+    const vdso_verdef_t *def = g_vdso.verdef;
+    uint16_t ver = g_vdso.versym[sym_index] & 0x7fff;
+
+    for (;;)
+    {
+        if (!(def->vd_flags & VER_FLG_BASE) && (def->vd_ndx & 0x7fff) == ver)
+        {
+            const vdso_verdaux_t *aux = (const vdso_verdaux_t *)((const char *)def + def->vd_aux);
+            return strcmp(version, g_vdso.strtab + aux->vda_name) == 0;
+        }
+        if (def->vd_next == 0)
+        {
+            return 0;
+        }
+        def = (const vdso_verdef_t *)((const char *)def + def->vd_next);
+    }
+}
+
+/**
+ * 在vDSO中查找函数
+ *
+ * vDSO只有十来个符号，线性扫描即可，且只在初始化时查找一次。
+ *
+ * @param version: 符号版本，为NULL或vDSO没有版本信息时不检查
+ * @param name: 符号名
+ * @return: 函数运行地址，找不到返回NULL
+ */
+void *vdso_sym(const char *version, const char *name)
+{
+    uint32_t i;
+
+    for (i = 0; i < g_vdso.nsyms; i++)
+    {
+        const vdso_sym_t *sym = &g_vdso.symtab[i];
+        unsigned char type = sym->st_info & 0xf;
+        unsigned char bind = sym->st_info >> 4;
+
+        if (type != STT_FUNC || (bind != STB_GLOBAL && bind != STB_WEAK) ||
+            sym->st_shndx == SHN_UNDEF)
+        {
+            continue;
+        }
+        if (strcmp(name, g_vdso.strtab + sym->st_name) != 0)
+        {
+            continue;
+        }
+        if (version && g_vdso.versym && !vdso_match_version(i, version))
+        {
+            continue;
+        }
+        return (void *)(g_vdso.load_offset + sym->st_value);
+    }
+    return NULL;
+}
+
+/**
+ * 两个参数的时间类系统调用
+ */
+static int time_syscall(long nr, long a0, long a1)
+{
+    register long x8 asm("x8") = nr;
+    register long x0 asm("x0") = a0;
+    register long x1 asm("x1") = a1;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * 读取指定时钟的当前时间
+ *
+ * @param clk_id: CLOCK_xxx
+ * @param tp: 输出时间
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int clock_gettime(int clk_id, struct timespec *tp)
+{
+    if (g_vdso_clock_gettime)
+    {
+        // vDSO处理不了的时钟会在内部自己发起系统调用，错误以负的errno返回
+        int ret = g_vdso_clock_gettime(clk_id, tp);
+        if (ret < 0)
+        {
+            mini_errno = -ret;
+            return -1;
+        }
+        return 0;
+    }
+    return time_syscall(__NR_clock_gettime, clk_id, (long)tp);
+}
+
+/**
+ * 读取指定时钟的精度
+ *
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int clock_getres(int clk_id, struct timespec *res)
+{
+    if (g_vdso_clock_getres)
+    {
+        int ret = g_vdso_clock_getres(clk_id, res);
+        if (ret < 0)
+        {
+            mini_errno = -ret;
+            return -1;
+        }
+        return 0;
+    }
+    return time_syscall(__NR_clock_getres, clk_id, (long)res);
+}
+
+/**
+ * 读取墙上时间，精度微秒
+ *
+ * @param tv: 输出时间，可为NULL
+ * @param tz: 已废弃，应传NULL
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int gettimeofday(struct timeval *tv, void *tz)
+{
+    if (g_vdso_gettimeofday)
+    {
+        int ret = g_vdso_gettimeofday(tv, tz);
+        if (ret < 0)
+        {
+            mini_errno = -ret;
+            return -1;
+        }
+        return 0;
+    }
+    return time_syscall(__NR_gettimeofday, (long)tv, (long)tz);
+}
+
+static long timespec_ns(const struct timespec *ts)
+{
+    return ts->tv_sec * 1000000000L + ts->tv_nsec;
+}
+
+/**
+ * 校准CNTVCT_EL0的实际频率
+ *
+ * 正常情况下CNTFRQ_EL0就是准确频率，但部分固件填错了该寄存器。
+ * 这里对照CLOCK_MONOTONIC_RAW测量10毫秒：与CNTFRQ_EL0相差1%以内时
+ * 采用CNTFRQ_EL0(精确值)，否则采用实测值。结果会被缓存。
+ *
+ * @return: 计数器频率，单位Hz
+ */
+uint64_t cycles_calibrate(void)
+{
+    struct timespec ts;
+    uint64_t c0, c1, declared, measured;
+    long t0, t1;
+
+    if (g_cycles_freq)
+    {
+        return g_cycles_freq;
+    }
+
+    declared = cycles_freq();
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    c0 = cycles_read_ordered();
+    t0 = timespec_ns(&ts);
+    do
+    {
+        clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+        c1 = cycles_read_ordered();
+        t1 = timespec_ns(&ts);
+    } while (t1 - t0 < CALIBRATE_NS);
+
+    measured = (c1 - c0) * 1000000000UL / (uint64_t)(t1 - t0);
+    if (declared != 0 &&
+        measured > declared - declared / 100 && measured < declared + declared / 100)
+    {
+        g_cycles_freq = declared;
+    }
+    else
+    {
+        LOG_INFO("CNTFRQ_EL0 reports %ld Hz, measured %ld Hz", (long)declared, (long)measured);
+        g_cycles_freq = measured;
+    }
+    return g_cycles_freq;
+}
+
+/**
+ * 把计数器差值换算为纳秒，首次调用时触发校准
+ */
+uint64_t cycles_to_ns(uint64_t cycles)
+{
+    uint64_t freq = g_cycles_freq ? g_cycles_freq : cycles_calibrate();
+
+    // 分成整秒和余数两部分计算，避免乘法溢出
+    return cycles / freq * 1000000000UL + cycles % freq * 1000000000UL / freq;
+}
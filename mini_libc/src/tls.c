@@ -0,0 +1,169 @@
+/**
+ * tls.c - 线程局部存储(TLS)布局与线程描述符
+ *
+ * 链接器把所有__thread变量的初值放在可执行文件的PT_TLS段中：
+ * 前p_filesz字节是.tdata的初值，其后到p_memsz为清零的.tbss。
+ * 每个线程需要一份自己的副本，并让TPIDR_EL0指向它。aarch64使用variant I布局，
+ * 线程指针处是16字节的TCB，TLS块从线程指针向上偏移 align_up(16, p_align) 处开始，
+ * 静态链接时编译器直接用这个偏移访问变量(local-exec模型)。
+ *
+ * mini_libc把线程描述符struct mini_thread放在线程指针正下方，
+ * 所以描述符、TCB、TLS块是一段连续内存：主线程在启动时分配，
+ * 新线程放在自己栈映射的顶端，随栈一起释放。
+ */
+
+#include "mini_lib.h"
+
+#define __NR_exit_group 94
+
+/* ELF程序头类型，只包含需要的部分 */
+#define PT_PHDR         6
+#define PT_TLS          7
+
+/* variant I布局下线程指针处TCB的大小 */
+#define TLS_TCB_SIZE    16
+
+typedef struct
+{
+    uint32_t p_type;
+    uint32_t p_flags;
+    uint64_t p_offset;
+    uint64_t p_vaddr;
+    uint64_t p_paddr;
+    uint64_t p_filesz;
+    uint64_t p_memsz;
+    uint64_t p_align;
+} tls_phdr_t;
+
+/* 可执行文件的TLS模板 */
+static struct
+{
+    const void *image;  /* .tdata初值 */
+    size_t filesz;      /* .tdata大小 */
+    size_t memsz;       /* .tdata + .tbss大小 */
+    size_t align;       /* TLS块对齐，至少16 */
+    size_t offset;      /* TLS块相对线程指针的偏移 */
+} g_tls = { NULL, 0, 0, 16, TLS_TCB_SIZE };
+
+/* 主线程在TLS布置好之前使用的描述符，保证mini_errno任何时候都可用 */
+static struct mini_thread g_boot_thread;
+
+/* TLS较小时主线程直接使用这块静态内存，不需要mmap */
+static char g_main_tls_area[512] __attribute__((aligned(64)));
+
+static inline void tls_set_tp(void *tp)
+{
+    asm volatile("msr tpidr_el0, %0" : : "r"(tp) : "memory");
+}
+
+/**
+ * 描述符对应的线程指针，用于clone的tls参数
+ */
+void *__mini_thread_tp(struct mini_thread *t)
+{
+    return (char *)t + sizeof(struct mini_thread);
+}
+
+/**
+ * 一个线程的描述符、TCB和TLS块总共需要的字节数(含对齐余量)
+ */
+size_t __mini_tls_area_size(void)
+{
+    return __MINI_ALIGN(sizeof(struct mini_thread) + g_tls.offset + g_tls.memsz + g_tls.align, 16);
+}
+
+/**
+ * 在[base, base+size)的顶端布置线程描述符和TLS块
+ *
+ * 描述符清零，TLS块从模板复制.tdata并清零.tbss，内存可以是复用的旧栈。
+ * 描述符以下的部分留给调用者(新线程用作栈)。
+ *
+ * @param base: 内存起始地址
+ * @param size: 内存大小，不小于__mini_tls_area_size()
+ * @return: 线程描述符
+ */
+struct mini_thread *__mini_tls_setup(void *base, size_t size)
+{
+    uintptr_t end = (uintptr_t)base + size;
+    uintptr_t tp = (end - g_tls.offset - g_tls.memsz) & ~(uintptr_t)(g_tls.align - 1);
+    struct mini_thread *t = (struct mini_thread *)(tp - sizeof(struct mini_thread));
+    char *block = (char *)tp + g_tls.offset;
+
+    memset(t, 0, sizeof(struct mini_thread) + g_tls.offset);
+    if (g_tls.memsz > 0)
+    {
+        memcpy(block, g_tls.image, g_tls.filesz);
+        memset(block + g_tls.filesz, 0, g_tls.memsz - g_tls.filesz);
+    }
+    t->self = t;
+    return t;
+}
+
+static void tls_fatal(const char *msg)
+{
+    register long x8 asm("x8") = __NR_exit_group;
+    register long x0 asm("x0") = 127;
+
+    write(2, msg, strlen(msg));
+    asm volatile("svc #0" : : "r"(x8), "r"(x0) : "memory");
+}
+
+/**
+ * 主线程TLS初始化，由__mini_libc_init最先调用
+ *
+ * 从AT_PHDR找到PT_TLS段，为主线程布置描述符和TLS块并设置TPIDR_EL0。
+ * PIE可执行文件的p_vaddr是相对地址，用PT_PHDR算出加载偏移。
+ */
+void __mini_tls_init(void)
+{
+    const tls_phdr_t *phdr;
+    unsigned long phnum, i;
+    uintptr_t bias = 0;
+    struct mini_thread *t;
+    size_t size;
+    void *area;
+
+    g_boot_thread.self = &g_boot_thread;
+    tls_set_tp(__mini_thread_tp(&g_boot_thread));
+
+    phdr = (const tls_phdr_t *)getauxval(AT_PHDR);
+    phnum = getauxval(AT_PHNUM);
+    for (i = 0; phdr != NULL && i < phnum; i++)
+    {
+        if (phdr[i].p_type == PT_PHDR)
+        {
+            bias = (uintptr_t)phdr - phdr[i].p_vaddr;
+        }
+    }
+    for (i = 0; phdr != NULL && i < phnum; i++)
+    {
+        if (phdr[i].p_type == PT_TLS)
+        {
+            g_tls.image = (const void *)(bias + phdr[i].p_vaddr);
+            g_tls.filesz = phdr[i].p_filesz;
+            g_tls.memsz = phdr[i].p_memsz;
+            g_tls.align = phdr[i].p_align > 16 ? phdr[i].p_align : 16;
+            g_tls.offset = __MINI_ALIGN(TLS_TCB_SIZE, g_tls.align);
+        }
+    }
+
+    size = __mini_tls_area_size();
+    if (size <= sizeof(g_main_tls_area))
+    {
+        area = g_main_tls_area;
+        size = sizeof(g_main_tls_area);
+    }
+    else
+    {
+        size = __MINI_ALIGN(size, 4096);
+        area = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (area == MAP_FAILED || area == NULL)
+        {
+            tls_fatal("mini_libc: cannot allocate TLS for main thread\n");
+        }
+    }
+
+    t = __mini_tls_setup(area, size);
+    t->tid = gettid();
+    tls_set_tp(__mini_thread_tp(t));
+}
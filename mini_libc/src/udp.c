@@ -0,0 +1,85 @@
+/**
+ * udp.c - UDP分段卸载(GSO)与接收合并(GRO)辅助函数
+ *
+ * GSO: 发送端把一块大缓冲区交给内核，内核(或网卡)按gso_size切成多个数据报，
+ *      一次sendmsg即可发出几十个报文。
+ * GRO: 接收端允许内核把同一流的连续数据报合并后一次交给用户，
+ *      通过UDP_GRO控制消息告知原始分段大小，用户按此大小自行拆分。
+ *
+ * 两者都需要Linux 5.0及以上内核。
+ */
+
+#include "mini_lib.h"
+
+/**
+ * 打开接收端GRO
+ *
+ * 之后recvmsg可能一次返回多个合并的数据报，
+ * 需要配合udp_cmsg_get_gro()取分段大小。
+ *
+ * @param sockfd: UDP socket
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int udp_enable_gro(int sockfd)
+{
+    int on = 1;
+    return setsockopt(sockfd, SOL_UDP, UDP_GRO, &on, sizeof(on));
+}
+
+/**
+ * 设置socket级别的默认GSO分段大小
+ *
+ * 设置后该socket上每次发送超过gso_size的数据都会被切分，
+ * 单次发送也可以用udp_cmsg_put_segment()覆盖。
+ *
+ * @param sockfd: UDP socket
+ * @param gso_size: 每个数据报的负载大小，0表示关闭
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int udp_set_segment_size(int sockfd, int gso_size)
+{
+    return setsockopt(sockfd, SOL_UDP, UDP_SEGMENT, &gso_size, sizeof(gso_size));
+}
+
+/**
+ * 在msg中填入一条UDP_SEGMENT控制消息，仅对本次sendmsg生效
+ *
+ * @param msg: 待发送的消息头
+ * @param cbuf: 控制消息缓冲区，至少CMSG_SPACE(sizeof(uint16_t))字节，按size_t对齐
+ * @param cbuf_len: cbuf长度
+ * @param gso_size: 每个数据报的负载大小
+ */
+void udp_cmsg_put_segment(struct msghdr *msg, void *cbuf, size_t cbuf_len, uint16_t gso_size)
+{
+    struct cmsghdr *cm;
+
+    memset(cbuf, 0, cbuf_len);
+    msg->msg_control = cbuf;
+    msg->msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+
+    cm = CMSG_FIRSTHDR(msg);
+    cm->cmsg_level = SOL_UDP;
+    cm->cmsg_type = UDP_SEGMENT;
+    cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    *(uint16_t *)CMSG_DATA(cm) = gso_size;
+}
+
+/**
+ * 从recvmsg返回的消息中取出GRO分段大小
+ *
+ * @param msg: recvmsg填充过的消息头
+ * @return: 分段大小；没有UDP_GRO控制消息(未合并)时返回-1
+ */
+int udp_cmsg_get_gro(struct msghdr *msg)
+{
+    struct cmsghdr *cm;
+
+    for (cm = CMSG_FIRSTHDR(msg); cm != NULL; cm = CMSG_NXTHDR(msg, cm))
+    {
+        if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO)
+        {
+            return *(int *)CMSG_DATA(cm);
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,381 @@
+/**
+ * unix.c - AF_UNIX本地socket辅助函数
+ *
+ * 本地socket不经过TCP/IP协议栈，同机进程间通信比回环TCP少了
+ * 协议头、校验和、拥塞控制等开销。除了普通数据外还支持辅助数据：
+ * - SCM_RIGHTS: 把文件描述符传给对端进程(对端得到指向同一文件的新fd)
+ * - SCM_CREDENTIALS: 携带发送进程的pid/uid/gid，由内核校验
+ *
+ * 配合memfd_create，一方创建内存文件并把fd发给另一方，
+ * 双方mmap同一个文件即可共享大块数据而不需要拷贝。
+ *
+ * 名字支持两种形式：
+ * - 文件系统路径: 在目录中创建socket节点，关闭后节点仍在，需要自行unlink；
+ *   unix_listen只会清理确认无人使用的残留socket节点
+ * - 抽象命名空间: 地址以'\0'开头，随最后一个socket关闭自动消失
+ */
+
+#include "mini_lib.h"
+
+/**
+ * 填充AF_UNIX地址
+ *
+ * @param addr: 输出地址
+ * @param name: 路径或抽象名字
+ * @param abstract: 非0表示使用抽象命名空间
+ * @return: 传给bind/connect的地址长度，名字过长返回0
+ */
+socklen_t unix_addr_init(struct sockaddr_un *addr, const char *name, int abstract)
+{
+    size_t len = strlen(name);
+    size_t base = (char *)addr->sun_path - (char *)addr;
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+
+    if (abstract)
+    {
+        // 抽象名字不以'\0'结尾，长度由地址长度决定
+        if (len + 1 > UNIX_PATH_MAX)
+        {
+            return 0;
+        }
+        memcpy(addr->sun_path + 1, name, len);
+        return (socklen_t)(base + 1 + len);
+    }
+
+    if (len + 1 > UNIX_PATH_MAX)
+    {
+        return 0;
+    }
+    memcpy(addr->sun_path, name, len + 1);
+    return (socklen_t)(base + len + 1);
+}
+
+/**
+ * 判断路径上是否为没有进程使用的残留socket节点
+ *
+ * 普通文件、目录等一律不算；是socket节点时试着连接一次，
+ * 只有返回ECONNREFUSED(没有socket绑定在上面)才认为是残留。
+ */
+static int unix_stale_node(const char *name, const struct sockaddr_un *addr, socklen_t len, int type)
+{
+    struct stat st;
+    int fd, stale;
+
+    if (lstat(name, &st) < 0 || !S_ISSOCK(st.st_mode))
+    {
+        return 0;
+    }
+
+    fd = socket(AF_UNIX, (type & 0xf) | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return 0;
+    }
+    stale = connect(fd, (struct sockaddr *)addr, len) < 0 && mini_errno == ECONNREFUSED;
+    close(fd);
+    return stale;
+}
+
+/**
+ * 创建并绑定AF_UNIX socket，面向连接的类型同时开始监听
+ *
+ * 文件系统路径已被占用时，只有确认是无人使用的残留socket节点才删除后重新绑定；
+ * 其他文件或仍在使用的socket不会被删除，返回-1且mini_errno为EADDRINUSE。
+ *
+ * @param name: 路径或抽象名字
+ * @param abstract: 非0表示使用抽象命名空间
+ * @param type: SOCK_STREAM/SOCK_DGRAM/SOCK_SEQPACKET，可或上SOCK_NONBLOCK/SOCK_CLOEXEC
+ * @param backlog: 监听队列长度，SOCK_DGRAM忽略
+ * @return: 成功返回socket，失败返回-1并设置mini_errno
+ */
+int unix_listen(const char *name, int abstract, int type, int backlog)
+{
+    struct sockaddr_un addr;
+    socklen_t len = unix_addr_init(&addr, name, abstract);
+    int fd, ret;
+
+    if (len == 0)
+    {
+        mini_errno = EINVAL;
+        return -1;
+    }
+
+    fd = socket(AF_UNIX, type, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    ret = bind(fd, (struct sockaddr *)&addr, len);
+    if (ret < 0 && !abstract && mini_errno == EADDRINUSE && unix_stale_node(name, &addr, len, type))
+    {
+        unlink(name);
+        ret = bind(fd, (struct sockaddr *)&addr, len);
+    }
+
+    if (ret < 0 || ((type & 0xf) != SOCK_DGRAM && listen(fd, backlog) < 0))
+    {
+        int err = mini_errno;
+        close(fd);
+        mini_errno = err;
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * 连接到AF_UNIX地址
+ *
+ * @param name: 路径或抽象名字
+ * @param abstract: 非0表示使用抽象命名空间
+ * @param type: 与监听端一致的socket类型
+ * @return: 成功返回socket，失败返回-1并设置mini_errno
+ */
+int unix_connect(const char *name, int abstract, int type)
+{
+    struct sockaddr_un addr;
+    socklen_t len = unix_addr_init(&addr, name, abstract);
+    int fd;
+
+    if (len == 0)
+    {
+        mini_errno = EINVAL;
+        return -1;
+    }
+
+    fd = socket(AF_UNIX, type, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    if (connect(fd, (struct sockaddr *)&addr, len) < 0)
+    {
+        int err = mini_errno;
+        close(fd);
+        mini_errno = err;
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * 发送数据并附带一组文件描述符
+ *
+ * 流式socket上辅助数据必须依附在至少1字节的普通数据上，
+ * len为0时自动发送1个填充字节。
+ *
+ * @param sockfd: AF_UNIX socket
+ * @param buf: 普通数据，可为NULL
+ * @param len: 普通数据长度
+ * @param fds: 要传递的fd数组
+ * @param nfds: fd个数，不超过UNIX_MAX_FDS
+ * @return: 成功返回发送的普通数据字节数，失败返回-1并设置mini_errno
+ */
+ssize_t unix_send_fds(int sockfd, const void *buf, size_t len, const int *fds, int nfds)
+{
+    size_t cbuf[CMSG_SPACE(sizeof(int) * UNIX_MAX_FDS) / sizeof(size_t)];
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cm;
+    char pad = 0;
+
+    if (nfds < 1 || nfds > UNIX_MAX_FDS)
+    {
+        mini_errno = EINVAL;
+        return -1;
+    }
+
+    iov.iov_base = len > 0 ? (void *)buf : &pad;
+    iov.iov_len = len > 0 ? len : 1;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(cbuf, 0, sizeof(cbuf));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+
+    cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+    memcpy(CMSG_DATA(cm), fds, sizeof(int) * nfds);
+
+    return sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+}
+
+/**
+ * 接收数据和对端传来的文件描述符
+ *
+ * 收到的fd都设置了O_CLOEXEC。超过*nfds的fd会被关闭，避免泄漏。
+ *
+ * @param sockfd: AF_UNIX socket
+ * @param buf: 普通数据缓冲区
+ * @param len: 缓冲区长度
+ * @param fds: 输出fd数组
+ * @param nfds: 输入为fds容量，输出为实际收到的fd个数
+ * @return: 成功返回收到的普通数据字节数，失败返回-1并设置mini_errno
+ */
+ssize_t unix_recv_fds(int sockfd, void *buf, size_t len, int *fds, int *nfds)
+{
+    size_t cbuf[CMSG_SPACE(sizeof(int) * UNIX_MAX_FDS) / sizeof(size_t)];
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cm;
+    int max = *nfds;
+    int count = 0;
+    ssize_t n;
+
+    iov.iov_base = buf;
+    iov.iov_len = len;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+
+    n = recvmsg(sockfd, &msg, MSG_CMSG_CLOEXEC);
+    if (n < 0)
+    {
+        return -1;
+    }
+
+    for (cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm))
+    {
+        int *data;
+        int i, num;
+
+        if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS)
+        {
+            continue;
+        }
+
+        data = (int *)CMSG_DATA(cm);
+        num = (int)((cm->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        for (i = 0; i < num; i++)
+        {
+            if (count < max)
+            {
+                fds[count++] = data[i];
+            }
+            else
+            {
+                close(data[i]);
+            }
+        }
+    }
+
+    if (msg.msg_flags & MSG_CTRUNC)
+    {
+        LOG_ERROR("fd %d: ancillary data truncated, some fds were dropped", sockfd);
+    }
+
+    *nfds = count;
+    return n;
+}
+
+/**
+ * 打开SO_PASSCRED，之后每条接收的消息都附带发送方凭证
+ *
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int unix_enable_passcred(int sockfd)
+{
+    int on = 1;
+    return setsockopt(sockfd, SOL_SOCKET, SO_PASSCRED, &on, sizeof(on));
+}
+
+/**
+ * 发送数据并附带本进程的凭证
+ *
+ * 内核会校验凭证，非特权进程只能发送自己的pid/uid/gid。
+ *
+ * @return: 成功返回发送的字节数，失败返回-1并设置mini_errno
+ */
+ssize_t unix_send_creds(int sockfd, const void *buf, size_t len)
+{
+    size_t cbuf[CMSG_SPACE(sizeof(struct ucred)) / sizeof(size_t)];
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cm;
+    struct ucred cred;
+    char pad = 0;
+
+    cred.pid = getpid();
+    cred.uid = getuid();
+    cred.gid = getgid();
+
+    iov.iov_base = len > 0 ? (void *)buf : &pad;
+    iov.iov_len = len > 0 ? len : 1;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(cbuf, 0, sizeof(cbuf));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+
+    cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_CREDENTIALS;
+    cm->cmsg_len = CMSG_LEN(sizeof(struct ucred));
+    memcpy(CMSG_DATA(cm), &cred, sizeof(cred));
+
+    return sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+}
+
+/**
+ * 接收数据和发送方凭证，接收端需先调用unix_enable_passcred
+ *
+ * @param cred: 输出发送方凭证，消息没有携带凭证时pid为0
+ * @return: 成功返回收到的字节数，失败返回-1并设置mini_errno
+ */
+ssize_t unix_recv_creds(int sockfd, void *buf, size_t len, struct ucred *cred)
+{
+    size_t cbuf[CMSG_SPACE(sizeof(struct ucred)) / sizeof(size_t)];
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cm;
+    ssize_t n;
+
+    iov.iov_base = buf;
+    iov.iov_len = len;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+
+    n = recvmsg(sockfd, &msg, 0);
+    if (n < 0)
+    {
+        return -1;
+    }
+
+    memset(cred, 0, sizeof(*cred));
+    for (cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm))
+    {
+        if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_CREDENTIALS)
+        {
+            memcpy(cred, CMSG_DATA(cm), sizeof(*cred));
+            break;
+        }
+    }
+    return n;
+}
+
+/**
+ * 读取已连接对端在connect/socketpair时的进程凭证
+ *
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int unix_peer_cred(int sockfd, struct ucred *cred)
+{
+    socklen_t len = sizeof(*cred);
+    return getsockopt(sockfd, SOL_SOCKET, SO_PEERCRED, cred, &len);
+}
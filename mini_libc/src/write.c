@@ -1,3 +1,5 @@
+#include "mini_lib.h"
+
 int write(int fd, const void *buf, int count)
 {
     int result;
@@ -14,4 +16,207 @@ int write(int fd, const void *buf, int count)
     );
 
     return result;
-}
\ No newline at end of file
+}
+
+/**
+ * writev - 聚集写
+ *
+ * 一次系统调用把多个缓冲区依次写出，系统调用号为66。
+ * 对普通文件和管道，单次writev的内容不会与其他写者交错。
+ *
+ * @param fd: 文件描述符
+ * @param iov: 缓冲区向量
+ * @param iovcnt: 向量个数
+ * @return: 成功返回写入的总字节数，失败返回-1并设置mini_errno
+ */
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt)
+{
+    register long x8 asm("x8") = 66;  // writev系统调用号
+    register long x0 asm("x0") = fd;
+    register long x1 asm("x1") = (long)iov;
+    register long x2 asm("x2") = iovcnt;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+
+    return x0;
+}
+
+/**
+ * pwrite64 - 定位写
+ *
+ * 写入指定偏移，不使用也不修改文件当前位置，系统调用号为68。
+ *
+ * @param fd: 文件描述符
+ * @param buf: 要写入的数据
+ * @param count: 要写入的字节数
+ * @param offset: 文件内的64位偏移
+ * @return: 成功返回写入的字节数，失败返回-1并设置mini_errno
+ */
+ssize_t pwrite64(int fd, const void *buf, size_t count, off_t offset)
+{
+    register long x8 asm("x8") = 68;  // pwrite64系统调用号
+    register long x0 asm("x0") = fd;
+    register long x1 asm("x1") = (long)buf;
+    register long x2 asm("x2") = count;
+    register long x3 asm("x3") = offset;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2), "r"(x3)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+
+    return x0;
+}
+
+/**
+ * pwritev2 - 带标志位的定位聚集写
+ *
+ * 系统调用号为287。64位平台上偏移量通过pos_l一个寄存器传递，pos_h填0。
+ *
+ * @param fd: 文件描述符
+ * @param iov: 缓冲区向量
+ * @param iovcnt: 向量个数
+ * @param offset: 文件内偏移，-1表示使用并更新文件当前位置
+ * @param flags: RWF_APPEND/RWF_DSYNC/RWF_NOWAIT等标志
+ * @return: 成功返回写入的总字节数，失败返回-1并设置mini_errno
+ */
+ssize_t pwritev2(int fd, const struct iovec *iov, int iovcnt, off_t offset, int flags)
+{
+    register long x8 asm("x8") = 287;  // pwritev2系统调用号
+    register long x0 asm("x0") = fd;
+    register long x1 asm("x1") = (long)iov;
+    register long x2 asm("x2") = iovcnt;
+    register long x3 asm("x3") = offset;  // pos_l
+    register long x4 asm("x4") = 0;       // pos_h
+    register long x5 asm("x5") = flags;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2), "r"(x3), "r"(x4), "r"(x5)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+
+    return x0;
+}
+
+/* 落盘与预分配相关系统调用号 */
+#define __NR_fallocate          47
+#define __NR_fsync              82
+#define __NR_fdatasync          83
+#define __NR_sync_file_range    84
+#define __NR_fadvise64          223
+
+/**
+ * 最多带四个参数的系统调用，失败时设置mini_errno并返回-1
+ */
+static long file_syscall4(long nr, long a0, long a1, long a2, long a3)
+{
+    register long x8 asm("x8") = nr;
+    register long x0 asm("x0") = a0;
+    register long x1 asm("x1") = a1;
+    register long x2 asm("x2") = a2;
+    register long x3 asm("x3") = a3;
+
+    asm volatile(
+        "svc #0"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2), "r"(x3)
+        : "memory", "cc"
+    );
+
+    if (x0 < 0)
+    {
+        mini_errno = -x0;
+        return -1;
+    }
+    return x0;
+}
+
+/**
+ * fsync - 把文件数据和全部元数据写到存储设备
+ *
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int fsync(int fd)
+{
+    return (int)file_syscall4(__NR_fsync, fd, 0, 0, 0);
+}
+
+/**
+ * fdatasync - 把文件数据以及读取数据所必需的元数据(如文件长度)写到存储设备
+ *
+ * 不强制写出修改时间等元数据，文件长度不变时通常比fsync少一次日志提交。
+ *
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int fdatasync(int fd)
+{
+    return (int)file_syscall4(__NR_fdatasync, fd, 0, 0, 0);
+}
+
+/**
+ * sync_file_range - 控制文件区间的回写
+ *
+ * 只作用于数据页，不写元数据也不刷新设备缓存，不能代替fdatasync保证持久化，
+ * 用来提前启动回写，让之后的fdatasync需要等待的脏页更少。
+ *
+ * @param offset: 区间起始偏移
+ * @param nbytes: 区间长度，0表示到文件末尾
+ * @param flags: SYNC_FILE_RANGE_*的组合
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int sync_file_range(int fd, off_t offset, off_t nbytes, unsigned int flags)
+{
+    return (int)file_syscall4(__NR_sync_file_range, fd, offset, nbytes, flags);
+}
+
+/**
+ * fallocate - 为文件区间分配磁盘空间
+ *
+ * @param mode: 0表示分配并在需要时扩展文件长度，FALLOC_FL_KEEP_SIZE只分配不改长度
+ * @return: 成功返回0，失败返回-1并设置mini_errno，文件系统不支持时为EOPNOTSUPP
+ */
+int fallocate(int fd, int mode, off_t offset, off_t len)
+{
+    return (int)file_syscall4(__NR_fallocate, fd, mode, offset, len);
+}
+
+/**
+ * posix_fadvise - 向内核提供文件区间的访问模式建议
+ *
+ * 与POSIX不同，失败时同其他包装函数一样返回-1并设置mini_errno。
+ *
+ * @param len: 区间长度，0表示到文件末尾
+ * @param advice: POSIX_FADV_*建议
+ * @return: 成功返回0，失败返回-1并设置mini_errno
+ */
+int posix_fadvise(int fd, off_t offset, off_t len, int advice)
+{
+    return (int)file_syscall4(__NR_fadvise64, fd, offset, len, advice);
+}
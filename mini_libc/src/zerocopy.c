@@ -0,0 +1,301 @@
+/**
+ * zerocopy.c - MSG_ZEROCOPY零拷贝发送实现
+ *
+ * 普通send会把数据拷贝进socket缓冲区；MSG_ZEROCOPY改为直接引用用户页，
+ * 代价是发送返回后缓冲区仍被内核持有，直到从socket错误队列读到完成通知。
+ *
+ * 内核为socket上每次成功的零拷贝发送分配一个递增的32位序号(从0开始)，
+ * 完成通知以区间[ee_info, ee_data]的形式批量上报。这里用序号低水位加
+ * 位图记录完成情况，调用者通过zc_send返回的序号查询缓冲区能否复用。
+ *
+ * 零拷贝只对大块数据划算：页面固定和通知处理有固定开销，
+ * 而且目标不支持时(如回环)内核会退回拷贝并在通知中打上COPIED标记，
+ * 此时继续零拷贝只会更慢，发送器自动改回普通send。
+ */
+
+#include "mini_lib.h"
+
+/* 小于该长度的发送直接拷贝，零拷贝的固定开销超过拷贝本身 */
+#define ZC_DEFAULT_MIN_SIZE     (16 * 1024)
+
+/**
+ * 初始化零拷贝发送器
+ *
+ * 内核不支持SO_ZEROCOPY时发送器仍可用，只是所有发送都走拷贝路径。
+ *
+ * @param zs: 发送器
+ * @param sock: 已连接的TCP socket(或已connect的UDP socket)
+ * @return: 成功返回0，sock无效时返回-1并设置mini_errno
+ */
+int zc_sender_init(struct zc_sender *zs, int sock)
+{
+    int on = 1;
+
+    memset(zs, 0, sizeof(*zs));
+    zs->sock = sock;
+    zs->min_size = ZC_DEFAULT_MIN_SIZE;
+
+    if (setsockopt(sock, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) < 0)
+    {
+        if (mini_errno == EBADF)
+        {
+            return -1;
+        }
+        LOG_INFO("SO_ZEROCOPY unavailable on fd %d (errno=%d), using copy", sock, mini_errno);
+        return 0;
+    }
+
+    zs->enabled = 1;
+    return 0;
+}
+
+/**
+ * 把[lo, hi]区间的发送标记为完成并推进低水位
+ */
+static void zc_mark_done(struct zc_sender *zs, uint32_t lo, uint32_t hi)
+{
+    uint32_t id = lo;
+
+    for (;;)
+    {
+        // 低水位以下的序号已经完成，重复通知直接忽略
+        if ((int32_t)(id - zs->completed) >= 0)
+        {
+            zs->done_bits[(id % ZC_WINDOW) / 64] |= 1UL << (id % 64);
+        }
+        if (id == hi)
+        {
+            break;
+        }
+        id++;
+    }
+
+    while (zs->done_bits[(zs->completed % ZC_WINDOW) / 64] & (1UL << (zs->completed % 64)))
+    {
+        zs->done_bits[(zs->completed % ZC_WINDOW) / 64] &= ~(1UL << (zs->completed % 64));
+        zs->completed++;
+    }
+}
+
+/**
+ * 处理一条错误队列消息中的零拷贝通知
+ *
+ * @return: 本条通知完成的发送次数，不是零拷贝通知返回0
+ */
+static int zc_handle_notification(struct zc_sender *zs, struct msghdr *msg)
+{
+    struct cmsghdr *cm;
+
+    for (cm = CMSG_FIRSTHDR(msg); cm != NULL; cm = CMSG_NXTHDR(msg, cm))
+    {
+        struct sock_extended_err *serr;
+        uint32_t count;
+
+        if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+              (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)))
+        {
+            continue;
+        }
+
+        serr = (struct sock_extended_err *)CMSG_DATA(cm);
+        if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr->ee_errno != 0)
+        {
+            continue;
+        }
+
+        count = serr->ee_data - serr->ee_info + 1;
+        zc_mark_done(zs, serr->ee_info, serr->ee_data);
+
+        if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+        {
+            // 内核延迟拷贝了数据，说明该路径上零拷贝不生效，后续直接拷贝
+            zs->copied_completions += count;
+            if (zs->enabled)
+            {
+                LOG_INFO("zerocopy on fd %d was copied by kernel, falling back to copy", zs->sock);
+                zs->enabled = 0;
+            }
+        }
+        else
+        {
+            zs->zc_completions += count;
+        }
+        return (int)count;
+    }
+    return 0;
+}
+
+/**
+ * 非阻塞地读取错误队列中所有已到达的完成通知
+ *
+ * @param zs: 发送器
+ * @return: 本次完成的发送次数，失败返回-1并设置mini_errno
+ */
+int zc_reap(struct zc_sender *zs)
+{
+    int total = 0;
+
+    for (;;)
+    {
+        size_t cbuf[CMSG_SPACE(sizeof(struct sock_extended_err)) / sizeof(size_t) + 8];
+        struct msghdr msg;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = cbuf;
+        msg.msg_controllen = sizeof(cbuf);
+
+        if (recvmsg(zs->sock, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+        {
+            if (mini_errno == EAGAIN)
+            {
+                return total;
+            }
+            if (mini_errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        total += zc_handle_notification(zs, &msg);
+    }
+}
+
+/**
+ * 发送数据，尽量使用零拷贝
+ *
+ * 走零拷贝时*id为本次发送的序号，buf在zc_buffer_reusable(id)返回1之前
+ * 不能修改或释放；走拷贝路径时*id为ZC_ID_NONE，buf可立即复用。
+ *
+ * @param zs: 发送器
+ * @param buf: 待发送数据
+ * @param len: 数据长度
+ * @param flags: 额外的send标志(如MSG_DONTWAIT)
+ * @param id: 输出本次发送的序号
+ * @return: 成功返回发送的字节数，失败返回-1并设置mini_errno
+ */
+ssize_t zc_send(struct zc_sender *zs, const void *buf, size_t len, int flags, uint32_t *id)
+{
+    ssize_t n;
+
+    *id = ZC_ID_NONE;
+
+    if (zs->enabled && len >= zs->min_size)
+    {
+        // 在途发送太多时先回收通知，位图装不下就本次拷贝
+        if (zs->next_id - zs->completed >= ZC_WINDOW)
+        {
+            zc_reap(zs);
+        }
+
+        if (zs->next_id - zs->completed < ZC_WINDOW)
+        {
+            n = send(zs->sock, buf, len, flags | MSG_ZEROCOPY);
+            if (n > 0)
+            {
+                *id = zs->next_id++;
+                return n;
+            }
+            // ENOBUFS: 固定页面超过了optmem限制，回收通知后本次改为拷贝
+            if (n < 0 && mini_errno != ENOBUFS)
+            {
+                return -1;
+            }
+            zc_reap(zs);
+        }
+    }
+
+    return send(zs->sock, buf, len, flags);
+}
+
+/**
+ * 查询某次发送使用的缓冲区是否可以复用
+ *
+ * 只看已经读取的通知，调用前可先zc_reap()。
+ *
+ * @return: 可复用返回1，否则返回0
+ */
+int zc_buffer_reusable(struct zc_sender *zs, uint32_t id)
+{
+    if (id == ZC_ID_NONE || (int32_t)(id - zs->completed) < 0)
+    {
+        return 1;
+    }
+    if ((int32_t)(id - zs->next_id) >= 0)
+    {
+        // 从未发出过的序号
+        return 1;
+    }
+    return (zs->done_bits[(id % ZC_WINDOW) / 64] >> (id % 64)) & 1;
+}
+
+/**
+ * 等待某次发送完成
+ *
+ * @param zs: 发送器
+ * @param id: zc_send返回的序号
+ * @param timeout_ms: 每轮等待的超时毫秒数，-1表示一直等待
+ * @return: 完成返回0，超时返回-1且mini_errno为ETIMEDOUT，其他错误返回-1
+ */
+int zc_wait(struct zc_sender *zs, uint32_t id, int timeout_ms)
+{
+    short last_revents = 0;
+
+    for (;;)
+    {
+        struct pollfd pfd;
+        int ret = zc_reap(zs);
+
+        if (ret < 0)
+        {
+            return -1;
+        }
+        if (zc_buffer_reusable(zs, id))
+        {
+            return 0;
+        }
+        // 对端已关闭且没有新的通知，不会再有完成了
+        if (ret == 0 && (last_revents & POLLHUP))
+        {
+            mini_errno = EPIPE;
+            return -1;
+        }
+
+        // 错误队列非空时socket报告POLLERR，不需要在events中声明
+        pfd.fd = zs->sock;
+        pfd.events = 0;
+        pfd.revents = 0;
+        ret = poll(&pfd, 1, timeout_ms);
+        if (ret < 0)
+        {
+            if (mini_errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        if (ret == 0)
+        {
+            mini_errno = ETIMEDOUT;
+            return -1;
+        }
+        last_revents = pfd.revents;
+    }
+}
+
+/**
+ * 等待所有在途的零拷贝发送完成，关闭socket或释放缓冲区前调用
+ *
+ * @return: 全部完成返回0，失败返回-1并设置mini_errno
+ */
+int zc_flush(struct zc_sender *zs, int timeout_ms)
+{
+    // 通知可能乱序到达，按低水位逐个等待
+    while (zs->completed != zs->next_id)
+    {
+        if (zc_wait(zs, zs->completed, timeout_ms) < 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
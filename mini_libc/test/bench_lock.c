@@ -0,0 +1,232 @@
+/**
+ * bench_lock.c - 锁扩展性测试
+ *
+ * 模拟读多写少的路由表：每次操作95%概率加读锁查表，5%概率加写锁更新一项。
+ * 线程数从1倍增到指定上限，比较总吞吐：
+ * 1. pthread_mutex: 读者之间也互斥
+ * 2. pthread_rwlock 读者优先
+ * 3. pthread_rwlock 写者优先
+ * 4. pthread_spin: 票号自旋锁，读写都互斥
+ * 5. mcs_lock: MCS队列锁，读写都互斥
+ *
+ * 前三种与后两种的对比主要看互斥锁在多核竞争下的扩展性。线程数超过核心数时
+ * 自旋锁的持有者可能被抢占，其余线程空等一整个时间片，此时结果只反映调度。
+ *
+ * 用法: bench_lock [最大线程数(1-64)] [每线程操作数]
+ */
+
+#include "mini_lib.h"
+#include "mini_atomic.h"
+
+#define BENCH_MAX_THREADS   64
+#define BENCH_TABLE_SIZE    256
+#define BENCH_READ_PERCENT  95
+
+enum bench_lock_kind
+{
+    BENCH_MUTEX,
+    BENCH_RWLOCK_READER,
+    BENCH_RWLOCK_WRITER,
+    BENCH_SPIN,
+    BENCH_MCS,
+};
+
+static const char *g_kind_names[] = { "mutex", "rwlock(reader)", "rwlock(writer)", "spin(ticket)", "mcs" };
+
+static struct
+{
+    int kind;
+    long ops;
+    volatile int ready;
+    volatile int go;
+    pthread_mutex_t mutex;
+    pthread_rwlock_t rwlock;
+    pthread_spinlock_t spin;
+    struct mcs_lock mcs;
+    long table[BENCH_TABLE_SIZE];
+} g_bench;
+
+static long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static long parse_long(const char *s)
+{
+    long v = 0;
+    while (*s >= '0' && *s <= '9')
+    {
+        v = v * 10 + (*s - '0');
+        s++;
+    }
+    return v;
+}
+
+/* 读写锁以外的锁读写都互斥，MCS需要等待者自己的节点 */
+static void bench_lock(int write, struct mcs_node *node)
+{
+    switch (g_bench.kind)
+    {
+    case BENCH_MUTEX:
+        pthread_mutex_lock(&g_bench.mutex);
+        break;
+    case BENCH_SPIN:
+        pthread_spin_lock(&g_bench.spin);
+        break;
+    case BENCH_MCS:
+        mcs_lock_acquire(&g_bench.mcs, node);
+        break;
+    default:
+        if (write)
+        {
+            pthread_rwlock_wrlock(&g_bench.rwlock);
+        }
+        else
+        {
+            pthread_rwlock_rdlock(&g_bench.rwlock);
+        }
+        break;
+    }
+}
+
+static void bench_unlock(struct mcs_node *node)
+{
+    switch (g_bench.kind)
+    {
+    case BENCH_MUTEX:
+        pthread_mutex_unlock(&g_bench.mutex);
+        break;
+    case BENCH_SPIN:
+        pthread_spin_unlock(&g_bench.spin);
+        break;
+    case BENCH_MCS:
+        mcs_lock_release(&g_bench.mcs, node);
+        break;
+    default:
+        pthread_rwlock_unlock(&g_bench.rwlock);
+        break;
+    }
+}
+
+static void *bench_worker(void *arg)
+{
+    unsigned int x = (unsigned int)(long)arg * 2654435761U + 1;
+    struct mcs_node node;
+    long sum = 0;
+    long i;
+
+    // 所有线程就绪后同时开始
+    mini_atomic_fetch_add(&g_bench.ready, 1, MINI_ATOMIC_RELAXED);
+    mini_atomic_wait_32((volatile uint32_t *)&g_bench.go, 0);
+
+    for (i = 0; i < g_bench.ops; i++)
+    {
+        unsigned int slot;
+
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        slot = x % BENCH_TABLE_SIZE;
+
+        if (x % 100 < BENCH_READ_PERCENT)
+        {
+            // 查表：读相邻几项
+            bench_lock(0, &node);
+            sum += g_bench.table[slot] + g_bench.table[(slot + 1) % BENCH_TABLE_SIZE] +
+                   g_bench.table[(slot + 2) % BENCH_TABLE_SIZE];
+            bench_unlock(&node);
+        }
+        else
+        {
+            bench_lock(1, &node);
+            g_bench.table[slot] = sum;
+            bench_unlock(&node);
+        }
+    }
+    return (void *)sum;
+}
+
+/**
+ * 用nthreads个线程运行一轮
+ *
+ * @return: 每秒操作数
+ */
+static long bench_run(int kind, int nthreads, long ops)
+{
+    pthread_t threads[BENCH_MAX_THREADS];
+    pthread_rwlockattr_t attr;
+    long start, us;
+    int i;
+
+    g_bench.kind = kind;
+    g_bench.ops = ops;
+    g_bench.ready = 0;
+    g_bench.go = 0;
+    pthread_mutex_init(&g_bench.mutex, NULL);
+    pthread_rwlockattr_init(&attr);
+    pthread_rwlockattr_setkind_np(&attr, kind == BENCH_RWLOCK_WRITER ?
+                                  PTHREAD_RWLOCK_PREFER_WRITER_NP : PTHREAD_RWLOCK_PREFER_READER_NP);
+    pthread_rwlock_init(&g_bench.rwlock, &attr);
+    pthread_spin_init(&g_bench.spin, PTHREAD_PROCESS_PRIVATE);
+    mcs_lock_init(&g_bench.mcs);
+
+    for (i = 0; i < nthreads; i++)
+    {
+        if (pthread_create(&threads[i], NULL, bench_worker, (void *)(long)(i + 1)) != 0)
+        {
+            printf("pthread_create failed\n");
+            nthreads = i;
+            break;
+        }
+    }
+    while (mini_atomic_load(&g_bench.ready, MINI_ATOMIC_ACQUIRE) < nthreads)
+    {
+        sched_yield();
+    }
+
+    start = now_ns();
+    mini_atomic_store(&g_bench.go, 1, MINI_ATOMIC_RELEASE);
+    for (i = 0; i < nthreads; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    us = (now_ns() - start) / 1000;
+    if (us <= 0)
+    {
+        us = 1;
+    }
+    return ops * nthreads * 1000000L / us;
+}
+
+int main(int argc, char *argv[])
+{
+    int max_threads = 8;
+    long ops = 200000;
+    int kind, n;
+
+    if (argc > 1)
+    {
+        max_threads = (int)parse_long(argv[1]);
+    }
+    if (argc > 2)
+    {
+        ops = parse_long(argv[2]);
+    }
+    if (max_threads <= 0 || max_threads > BENCH_MAX_THREADS || ops <= 0)
+    {
+        printf("Usage: %s [max_threads(1-%d)] [ops_per_thread]\n", argv[0], BENCH_MAX_THREADS);
+        return -1;
+    }
+
+    printf("lock benchmark: %d%% reads, %ld ops/thread\n", BENCH_READ_PERCENT, ops);
+    for (n = 1; n <= max_threads; n *= 2)
+    {
+        for (kind = BENCH_MUTEX; kind <= BENCH_MCS; kind++)
+        {
+            printf("%d threads %s: %ld ops/s\n", n, g_kind_names[kind], bench_run(kind, n, ops));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,709 @@
+/**
+ * bench_net.c - 回环TCP网络性能测试与负载生成器
+ *
+ * 在同一进程中启动echo服务器线程和客户端负载线程，通过127.0.0.1通信：
+ * - rr模式: 每个连接同一时刻只有一个请求在途(请求/响应)
+ * - echo模式: 每个连接流水线发送多个请求(默认16个)，测吞吐
+ *
+ * 每个请求的延迟记录在HDR风格的对数-线性直方图中，
+ * 结束时输出p50/p99/p999和每秒请求数。
+ *
+ * 同一份源码定义BENCH_USE_GLIBC后链接glibc，生成bench_net_glibc作为基线，
+ * 两者的差异即为socket路径实现上的差异。
+ *
+ * 用法: bench_net [-m rr|echo] [-c 连接数] [-s 消息字节数] [-d 流水线深度]
+ *                 [-t 秒数] [-w 服务器线程数] [-T 客户端线程数] [-p 端口]
+ */
+
+#ifdef BENCH_USE_GLIBC
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define bench_errno     errno
+#define BENCH_LIBC      "glibc"
+#else
+#include "mini_lib.h"
+
+#define bench_errno     mini_errno
+#define BENCH_LIBC      "mini_libc"
+#endif
+
+static long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+#define BENCH_MAX_CONNS     4096
+#define BENCH_MAX_THREADS   64
+#define BENCH_MAX_FD        (BENCH_MAX_CONNS * 2 + 256)
+#define BENCH_MAX_MSG       16384
+#define BENCH_MAX_DEPTH     64
+#define BENCH_SERVER_BUF    (BENCH_MAX_MSG * 2)
+#define BENCH_EVENTS        256
+
+/*
+ * HDR风格直方图：小于2^HIST_SUB_BITS的值精确记录，
+ * 更大的值按最高位分组，每组再等分为2^HIST_SUB_BITS个子桶，相对误差小于1%
+ */
+#define HIST_SUB_BITS       7
+#define HIST_SUB            (1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS       40      /* 最大记录约1100秒(纳秒) */
+#define HIST_BUCKETS        ((HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_SUB)
+
+struct histogram
+{
+    long counts[HIST_BUCKETS];
+    long total;
+    long min;
+    long max;
+};
+
+static void hist_init(struct histogram *h)
+{
+    memset(h, 0, sizeof(*h));
+    h->min = -1;
+}
+
+static int hist_index(long v)
+{
+    int msb, shift, idx;
+
+    if (v < HIST_SUB)
+    {
+        return v < 0 ? 0 : (int)v;
+    }
+    msb = 63 - __builtin_clzl((unsigned long)v);
+    shift = msb - HIST_SUB_BITS;
+    idx = (shift + 1) * HIST_SUB + (int)((v >> shift) - HIST_SUB);
+    return idx < HIST_BUCKETS ? idx : HIST_BUCKETS - 1;
+}
+
+/* 桶的代表值取桶的中点 */
+static long hist_value(int idx)
+{
+    int shift;
+
+    if (idx < HIST_SUB)
+    {
+        return idx;
+    }
+    shift = idx / HIST_SUB - 1;
+    return ((long)(HIST_SUB + idx % HIST_SUB) << shift) + ((1L << shift) >> 1);
+}
+
+static void hist_record(struct histogram *h, long v)
+{
+    h->counts[hist_index(v)]++;
+    h->total++;
+    if (h->min < 0 || v < h->min)
+    {
+        h->min = v;
+    }
+    if (v > h->max)
+    {
+        h->max = v;
+    }
+}
+
+static void hist_merge(struct histogram *dst, const struct histogram *src)
+{
+    int i;
+
+    for (i = 0; i < HIST_BUCKETS; i++)
+    {
+        dst->counts[i] += src->counts[i];
+    }
+    dst->total += src->total;
+    if (src->total > 0 && (dst->min < 0 || src->min < dst->min))
+    {
+        dst->min = src->min;
+    }
+    if (src->max > dst->max)
+    {
+        dst->max = src->max;
+    }
+}
+
+/* 返回第per_10k/10000分位的值，如5000为p50，9990为p999 */
+static long hist_percentile(const struct histogram *h, long per_10k)
+{
+    long target = (h->total * per_10k + 9999) / 10000;
+    long seen = 0;
+    int i;
+
+    if (target < 1)
+    {
+        target = 1;
+    }
+    for (i = 0; i < HIST_BUCKETS; i++)
+    {
+        seen += h->counts[i];
+        if (seen >= target)
+        {
+            long v = hist_value(i);
+            return v > h->max ? h->max : v;
+        }
+    }
+    return h->max;
+}
+
+/* 测试参数 */
+struct bench_config
+{
+    int rr;                 /* 1: 请求/响应模式 0: 流水线echo模式 */
+    int conns;
+    int msg_size;
+    int depth;
+    int seconds;
+    int server_threads;
+    int client_threads;
+    int port;
+};
+
+static struct bench_config g_cfg;
+
+/* ---------------- 服务器 ---------------- */
+
+/* 服务器端每个连接待发送的数据，发送缓冲区满时暂存 */
+struct server_conn
+{
+    int pending_off;
+    int pending_len;
+};
+
+static struct server_conn g_server_conns[BENCH_MAX_FD];
+static char *g_server_bufs;         /* 每个fd一块BENCH_SERVER_BUF大小的缓冲区 */
+static volatile int g_stop;
+
+static int bench_listen(int port)
+{
+    struct sockaddr_in addr;
+    int on = 1;
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+
+    if (fd < 0)
+    {
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 4096) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void server_set_events(int epfd, int fd, unsigned int events)
+{
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+static void server_close(int epfd, int fd)
+{
+    epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+}
+
+/* 发送暂存数据，全部发完返回1，仍有剩余返回0，出错返回-1 */
+static int server_flush(int fd)
+{
+    struct server_conn *c = &g_server_conns[fd];
+    char *buf = g_server_bufs + (long)fd * BENCH_SERVER_BUF;
+
+    while (c->pending_len > 0)
+    {
+        ssize_t n = send(fd, buf + c->pending_off, c->pending_len, MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            return bench_errno == EAGAIN ? 0 : -1;
+        }
+        c->pending_off += n;
+        c->pending_len -= n;
+    }
+    return 1;
+}
+
+static void server_on_readable(int epfd, int fd)
+{
+    struct server_conn *c = &g_server_conns[fd];
+    char *buf = g_server_bufs + (long)fd * BENCH_SERVER_BUF;
+    ssize_t n = recv(fd, buf, BENCH_SERVER_BUF, 0);
+
+    if (n == 0 || (n < 0 && bench_errno != EAGAIN))
+    {
+        server_close(epfd, fd);
+        return;
+    }
+    if (n < 0)
+    {
+        return;
+    }
+
+    c->pending_off = 0;
+    c->pending_len = (int)n;
+    int ret = server_flush(fd);
+    if (ret < 0)
+    {
+        server_close(epfd, fd);
+    }
+    else if (ret == 0)
+    {
+        // 发送缓冲区满，暂停读，等可写后再继续
+        server_set_events(epfd, fd, EPOLLOUT);
+    }
+}
+
+static void *server_thread(void *arg)
+{
+    struct epoll_event events[BENCH_EVENTS];
+    int listen_fd = (int)(long)arg;
+    int epfd = epoll_create1(0);
+    int i;
+
+    if (epfd < 0)
+    {
+        printf("server: epoll_create1 failed, errno=%d\n", bench_errno);
+        return NULL;
+    }
+
+    memset(&events[0], 0, sizeof(events[0]));
+    events[0].events = EPOLLIN;
+    events[0].data.fd = listen_fd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &events[0]);
+
+    while (!g_stop)
+    {
+        int n = epoll_pwait(epfd, events, BENCH_EVENTS, 100, NULL);
+
+        for (i = 0; i < n; i++)
+        {
+            int fd = events[i].data.fd;
+
+            if (fd == listen_fd)
+            {
+                int conn;
+                while ((conn = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK)) >= 0)
+                {
+                    struct epoll_event ev;
+                    int on = 1;
+
+                    if (conn >= BENCH_MAX_FD)
+                    {
+                        close(conn);
+                        continue;
+                    }
+                    setsockopt(conn, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+                    g_server_conns[conn].pending_len = 0;
+                    memset(&ev, 0, sizeof(ev));
+                    ev.events = EPOLLIN;
+                    ev.data.fd = conn;
+                    epoll_ctl(epfd, EPOLL_CTL_ADD, conn, &ev);
+                }
+                continue;
+            }
+
+            if (events[i].events & EPOLLOUT)
+            {
+                int ret = server_flush(fd);
+                if (ret < 0)
+                {
+                    server_close(epfd, fd);
+                }
+                else if (ret > 0)
+                {
+                    server_set_events(epfd, fd, EPOLLIN);
+                }
+            }
+            else if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+            {
+                server_on_readable(epfd, fd);
+            }
+        }
+    }
+
+    close(epfd);
+    close(listen_fd);
+    return NULL;
+}
+
+/* ---------------- 客户端 ---------------- */
+
+struct client_conn
+{
+    int fd;
+    int tx_pending;         /* 还没发出的字节数 */
+    int rx_bytes;           /* 当前响应已收到的字节数 */
+    int inflight;           /* 在途请求数 */
+    int head;               /* 最早在途请求的时间戳下标 */
+    long start_ns[BENCH_MAX_DEPTH];
+};
+
+struct client_state
+{
+    int id;
+    int first_conn;
+    int nconns;
+    long completed;
+    long errors;
+    struct histogram hist;
+};
+
+static struct client_conn g_client_conns[BENCH_MAX_CONNS];
+static struct client_state g_clients[BENCH_MAX_THREADS];
+static char g_tx_data[BENCH_MAX_MSG * BENCH_MAX_DEPTH];
+static volatile long g_deadline_ns;
+
+static int client_connect(int port)
+{
+    struct sockaddr_in addr;
+    int on = 1;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (fd < 0)
+    {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+/* 尽量发出tx_pending字节，返回-1表示连接出错 */
+static int client_flush(struct client_conn *c)
+{
+    while (c->tx_pending > 0)
+    {
+        ssize_t n = send(c->fd, g_tx_data, c->tx_pending, MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            return bench_errno == EAGAIN ? 0 : -1;
+        }
+        c->tx_pending -= n;
+    }
+    return 0;
+}
+
+/* 排队一个新请求并记录开始时间 */
+static void client_issue(struct client_conn *c, long now)
+{
+    c->start_ns[(c->head + c->inflight) % BENCH_MAX_DEPTH] = now;
+    c->inflight++;
+    c->tx_pending += g_cfg.msg_size;
+}
+
+static void client_update_events(int epfd, struct client_conn *c, long idx)
+{
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | (c->tx_pending > 0 ? EPOLLOUT : 0);
+    ev.data.u64 = idx;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+static void *client_thread(void *arg)
+{
+    struct client_state *st = (struct client_state *)arg;
+    struct epoll_event events[BENCH_EVENTS];
+    static char rx_bufs[BENCH_MAX_THREADS][BENCH_MAX_MSG * 4];
+    char *rx_buf = rx_bufs[st->id];
+    int epfd = epoll_create1(0);
+    long now = now_ns();
+    int i;
+
+    for (i = st->first_conn; i < st->first_conn + st->nconns; i++)
+    {
+        struct client_conn *c = &g_client_conns[i];
+        int k;
+
+        memset(&events[0], 0, sizeof(events[0]));
+        events[0].events = EPOLLIN;
+        events[0].data.u64 = i;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &events[0]);
+
+        for (k = 0; k < g_cfg.depth; k++)
+        {
+            client_issue(c, now);
+        }
+        if (client_flush(c) < 0)
+        {
+            st->errors++;
+        }
+        client_update_events(epfd, c, i);
+    }
+
+    while (1)
+    {
+        int n = epoll_pwait(epfd, events, BENCH_EVENTS, 100, NULL);
+        int active = 0;
+
+        now = now_ns();
+        for (i = 0; i < n; i++)
+        {
+            long idx = (long)events[i].data.u64;
+            struct client_conn *c = &g_client_conns[idx];
+            int had_pending = c->tx_pending > 0;
+
+            if (events[i].events & EPOLLIN)
+            {
+                ssize_t r;
+                while ((r = recv(c->fd, rx_buf, BENCH_MAX_MSG * 4, 0)) > 0)
+                {
+                    c->rx_bytes += (int)r;
+                    while (c->rx_bytes >= g_cfg.msg_size && c->inflight > 0)
+                    {
+                        c->rx_bytes -= g_cfg.msg_size;
+                        hist_record(&st->hist, now - c->start_ns[c->head]);
+                        c->head = (c->head + 1) % BENCH_MAX_DEPTH;
+                        c->inflight--;
+                        st->completed++;
+                        if (now < g_deadline_ns)
+                        {
+                            client_issue(c, now);
+                        }
+                    }
+                }
+                if (r == 0 || (r < 0 && bench_errno != EAGAIN))
+                {
+                    st->errors++;
+                    epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+                    c->inflight = 0;
+                    c->tx_pending = 0;
+                    continue;
+                }
+            }
+
+            if (client_flush(c) < 0)
+            {
+                st->errors++;
+            }
+            if (had_pending != (c->tx_pending > 0))
+            {
+                client_update_events(epfd, c, idx);
+            }
+        }
+
+        // 截止时间后不再发新请求，等在途请求全部返回
+        if (now >= g_deadline_ns)
+        {
+            for (i = st->first_conn; i < st->first_conn + st->nconns; i++)
+            {
+                active += g_client_conns[i].inflight;
+            }
+            if (active == 0 || now >= g_deadline_ns + 1000000000L)
+            {
+                break;
+            }
+        }
+    }
+
+    close(epfd);
+    return NULL;
+}
+
+/* ---------------- 主程序 ---------------- */
+
+static int parse_int(const char *s)
+{
+    int v = 0;
+    while (*s >= '0' && *s <= '9')
+    {
+        v = v * 10 + (*s - '0');
+        s++;
+    }
+    return v;
+}
+
+static void print_usage(const char *program)
+{
+    printf("Usage: %s [-m rr|echo] [-c conns] [-s msg_size] [-d depth]\n", program);
+    printf("          [-t seconds] [-w server_threads] [-T client_threads] [-p port]\n");
+}
+
+static int parse_args(int argc, char *argv[])
+{
+    int i;
+
+    g_cfg.rr = 1;
+    g_cfg.conns = 64;
+    g_cfg.msg_size = 64;
+    g_cfg.depth = 0;
+    g_cfg.seconds = 5;
+    g_cfg.server_threads = 1;
+    g_cfg.client_threads = 1;
+    g_cfg.port = 9200;
+
+    for (i = 1; i + 1 < argc; i += 2)
+    {
+        const char *opt = argv[i];
+        const char *val = argv[i + 1];
+
+        if (opt[0] != '-' || opt[1] == '\0' || opt[2] != '\0')
+        {
+            return -1;
+        }
+        switch (opt[1])
+        {
+            case 'm': g_cfg.rr = strcmp(val, "echo") != 0; break;
+            case 'c': g_cfg.conns = parse_int(val); break;
+            case 's': g_cfg.msg_size = parse_int(val); break;
+            case 'd': g_cfg.depth = parse_int(val); break;
+            case 't': g_cfg.seconds = parse_int(val); break;
+            case 'w': g_cfg.server_threads = parse_int(val); break;
+            case 'T': g_cfg.client_threads = parse_int(val); break;
+            case 'p': g_cfg.port = parse_int(val); break;
+            default: return -1;
+        }
+    }
+    if (i != argc)
+    {
+        return -1;
+    }
+
+    if (g_cfg.depth == 0)
+    {
+        g_cfg.depth = g_cfg.rr ? 1 : 16;
+    }
+    if (g_cfg.conns < 1 || g_cfg.conns > BENCH_MAX_CONNS ||
+        g_cfg.msg_size < 1 || g_cfg.msg_size > BENCH_MAX_MSG ||
+        g_cfg.depth < 1 || g_cfg.depth > BENCH_MAX_DEPTH ||
+        g_cfg.seconds < 1 ||
+        g_cfg.server_threads < 1 || g_cfg.server_threads > BENCH_MAX_THREADS ||
+        g_cfg.client_threads < 1 || g_cfg.client_threads > BENCH_MAX_THREADS ||
+        g_cfg.client_threads > g_cfg.conns)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    static struct histogram total;
+    pthread_t servers[BENCH_MAX_THREADS];
+    pthread_t clients[BENCH_MAX_THREADS];
+    long start, elapsed, completed = 0, errors = 0;
+    int i;
+
+    if (parse_args(argc, argv) < 0)
+    {
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    g_server_bufs = mmap(NULL, (long)BENCH_MAX_FD * BENCH_SERVER_BUF, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (g_server_bufs == MAP_FAILED)
+    {
+        printf("mmap failed, errno=%d\n", bench_errno);
+        return -1;
+    }
+    memset(g_tx_data, 'n', sizeof(g_tx_data));
+
+    // 监听socket全部建好后再启动服务器线程，连接才能均匀分布到各个SO_REUSEPORT socket
+    for (i = 0; i < g_cfg.server_threads; i++)
+    {
+        int listen_fd = bench_listen(g_cfg.port);
+        if (listen_fd < 0)
+        {
+            printf("listen on port %d failed, errno=%d\n", g_cfg.port, bench_errno);
+            return -1;
+        }
+        pthread_create(&servers[i], NULL, server_thread, (void *)(long)listen_fd);
+    }
+
+    for (i = 0; i < g_cfg.conns; i++)
+    {
+        g_client_conns[i].fd = client_connect(g_cfg.port);
+        if (g_client_conns[i].fd < 0 || g_client_conns[i].fd >= BENCH_MAX_FD)
+        {
+            printf("connect failed, errno=%d\n", bench_errno);
+            g_stop = 1;
+            return -1;
+        }
+    }
+
+    printf("%s %s: %d conns, %d bytes, depth %d, %d server threads, %d client threads, %d s\n",
+           BENCH_LIBC, g_cfg.rr ? "rr" : "echo", g_cfg.conns, g_cfg.msg_size, g_cfg.depth,
+           g_cfg.server_threads, g_cfg.client_threads, g_cfg.seconds);
+
+    start = now_ns();
+    g_deadline_ns = start + g_cfg.seconds * 1000000000L;
+    for (i = 0; i < g_cfg.client_threads; i++)
+    {
+        struct client_state *st = &g_clients[i];
+        int per = g_cfg.conns / g_cfg.client_threads;
+
+        st->id = i;
+        st->first_conn = i * per;
+        st->nconns = (i == g_cfg.client_threads - 1) ? g_cfg.conns - st->first_conn : per;
+        hist_init(&st->hist);
+        pthread_create(&clients[i], NULL, client_thread, st);
+    }
+
+    hist_init(&total);
+    for (i = 0; i < g_cfg.client_threads; i++)
+    {
+        pthread_join(clients[i], NULL);
+        hist_merge(&total, &g_clients[i].hist);
+        completed += g_clients[i].completed;
+        errors += g_clients[i].errors;
+    }
+    elapsed = now_ns() - start;
+
+    g_stop = 1;
+    for (i = 0; i < g_cfg.conns; i++)
+    {
+        close(g_client_conns[i].fd);
+    }
+    for (i = 0; i < g_cfg.server_threads; i++)
+    {
+        pthread_join(servers[i], NULL);
+    }
+
+    printf("requests: %ld, errors: %ld, elapsed: %ld ms\n", completed, errors, elapsed / 1000000);
+    printf("throughput: %ld req/s, %ld KB/s\n",
+           completed * 1000000000L / elapsed,
+           completed * g_cfg.msg_size / 1024 * 1000000000L / elapsed);
+    printf("latency(ns): min %ld, p50 %ld, p99 %ld, p999 %ld, max %ld\n",
+           total.min, hist_percentile(&total, 5000), hist_percentile(&total, 9900),
+           hist_percentile(&total, 9990), total.max);
+
+    munmap(g_server_bufs, (long)BENCH_MAX_FD * BENCH_SERVER_BUF);
+    return 0;
+}
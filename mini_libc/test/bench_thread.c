@@ -0,0 +1,166 @@
+/**
+ * bench_thread.c - 线程创建/回收性能测试
+ *
+ * 反复pthread_create+pthread_join一个空线程，比较：
+ * 1. 打开栈缓存：join后的栈映射被下一个线程直接复用
+ * 2. 关闭栈缓存：每个线程都要mmap、mprotect保护页、join后munmap
+ * 另外测一次较大栈(1MB)的情况，映射越大缺页和页表开销越明显。
+ * 最后对比同样数量的空任务交给线程池执行(thread_pool_spawn+thread_pool_sync)，
+ * 分别由主线程逐个提交，以及由工作线程以fork-join方式递归提交。
+ *
+ * 用法: bench_thread [线程数]
+ */
+
+#include "mini_lib.h"
+
+static long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static long parse_long(const char *s)
+{
+    long v = 0;
+    while (*s >= '0' && *s <= '9')
+    {
+        v = v * 10 + (*s - '0');
+        s++;
+    }
+    return v;
+}
+
+static void *empty_thread(void *arg)
+{
+    // 碰一下栈，保证栈页真的被访问过
+    volatile char buf[256];
+    buf[0] = (char)(long)arg;
+    return (void *)(long)buf[0];
+}
+
+static struct thread_pool g_pool;
+
+static void empty_task(void *arg)
+{
+    volatile char buf[256];
+    buf[0] = (char)(long)arg;
+}
+
+struct pool_split
+{
+    long count;
+};
+
+/* 二分递归提交，count个叶子任务 */
+static void split_task(void *arg)
+{
+    struct pool_split *s = (struct pool_split *)arg;
+    struct pool_split left, right;
+    struct pool_task task;
+
+    if (s->count <= 1)
+    {
+        empty_task(arg);
+        return;
+    }
+    left.count = s->count / 2;
+    right.count = s->count - left.count;
+    thread_pool_spawn(&g_pool, &task, split_task, &right);
+    split_task(&left);
+    thread_pool_sync(&g_pool, &task);
+}
+
+static void bench_pool(long count)
+{
+    struct pool_split root;
+    struct pool_task task;
+    long start, ns;
+    long i;
+
+    if (thread_pool_init(&g_pool, 0) < 0)
+    {
+        printf("thread_pool_init failed, errno=%d\n", mini_errno);
+        return;
+    }
+
+    start = now_ns();
+    for (i = 0; i < count; i++)
+    {
+        thread_pool_spawn(&g_pool, &task, empty_task, (void *)i);
+        thread_pool_sync(&g_pool, &task);
+    }
+    ns = now_ns() - start;
+    printf("pool external: %ld tasks in %ld us, %ld ns/task\n", count, ns / 1000, ns / count);
+
+    root.count = count;
+    start = now_ns();
+    thread_pool_spawn(&g_pool, &task, split_task, &root);
+    thread_pool_sync(&g_pool, &task);
+    ns = now_ns() - start;
+    printf("pool fork-join: %ld tasks in %ld us, %ld ns/task\n", count, ns / 1000, ns / count);
+
+    thread_pool_destroy(&g_pool);
+}
+
+/**
+ * 顺序创建并等待count个线程
+ */
+static void bench_create_join(const char *name, long count, const pthread_attr_t *attr)
+{
+    long start, ns;
+    long i;
+
+    start = now_ns();
+    for (i = 0; i < count; i++)
+    {
+        pthread_t t;
+        if (pthread_create(&t, attr, empty_thread, (void *)i) != 0)
+        {
+            printf("%s: pthread_create failed at %ld, errno=%d\n", name, i, mini_errno);
+            return;
+        }
+        pthread_join(t, NULL);
+    }
+    ns = now_ns() - start;
+    if (ns <= 0)
+    {
+        ns = 1;
+    }
+    printf("%s: %ld threads in %ld us, %ld ns/thread\n", name, count, ns / 1000, ns / count);
+}
+
+int main(int argc, char *argv[])
+{
+    long count = 20000;
+    pthread_attr_t big;
+    int limit;
+
+    if (argc > 1)
+    {
+        count = parse_long(argv[1]);
+    }
+    if (count <= 0)
+    {
+        printf("Usage: %s [threads]\n", argv[0]);
+        return -1;
+    }
+
+    pthread_attr_init(&big);
+    pthread_attr_setstacksize(&big, 1024 * 1024);
+
+    printf("thread create/join benchmark: %ld threads\n", count);
+
+    bench_create_join("cached   64KB", count, NULL);
+    bench_create_join("cached    1MB", count, &big);
+
+    limit = pthread_stack_cache_limit(0);
+    bench_create_join("uncached 64KB", count, NULL);
+    bench_create_join("uncached  1MB", count, &big);
+    pthread_stack_cache_limit(limit);
+
+    bench_pool(count);
+
+    pthread_attr_destroy(&big);
+    return 0;
+}
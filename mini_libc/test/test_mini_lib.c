@@ -7,9 +7,18 @@
  * -p: 进程(fork)测试
  * -s: socket服务器测试
  * -c: socket客户端测试
+ * -g: 日志测试
+ * -u: io_uring测试
+ * -e: epoll事件循环服务器测试
+ * -z: 零拷贝文件发送测试
+ * -x: MSG_ZEROCOPY发送测试
+ * -r: SO_REUSEPORT多线程服务器测试
+ * -k: AF_UNIX socket与fd传递测试
+ * -v: vDSO时间接口与周期计数器测试
  */
 
 #include "mini_lib.h"
+#include "mini_atomic.h"
 
 /**
  * 打印使用说明
@@ -25,6 +34,23 @@ static void print_usage(const char* program)
     printf("  -c: Socket client test\n");
     printf("  -t: Thread test\n");
     printf("  -l: 互斥锁测试\n");
+    printf("  -g: 日志测试\n");
+    printf("  -u <filename>: io_uring测试\n");
+    printf("  -e: epoll事件循环服务器测试\n");
+    printf("  -z <filename>: 零拷贝文件发送测试(配合-c)\n");
+    printf("  -x: MSG_ZEROCOPY发送测试(回环)\n");
+    printf("  -r [workers]: SO_REUSEPORT多线程echo服务器测试\n");
+    printf("  -k: AF_UNIX socket与memfd传递测试\n");
+    printf("  -v: vDSO时间接口与周期计数器测试\n");
+    printf("  -b: 缓冲读取器与文件映射测试\n");
+    printf("  -o <filename>: O_DIRECT直接I/O测试\n");
+    printf("  -w <filename>: 预分配追加日志与group commit测试\n");
+    printf("  -d: 线程局部存储(TLS)测试\n");
+    printf("  -a: 原子操作(LSE/LL-SC)测试\n");
+    printf("  -y: 读写锁测试\n");
+    printf("  -n: 条件变量测试\n");
+    printf("  -q: 票号自旋锁与MCS队列锁测试\n");
+    printf("  -j: 工作窃取线程池测试\n");
 }
 
 /**
@@ -42,8 +68,51 @@ static void test_file(const char* filename)
         write(fd, "hello world", 12);
 
         // 测试lseek，打印文件长度
-        int len = lseek(fd, 0, SEEK_END);
-        printf("file length: %d\n", len);
+        off_t len = lseek(fd, 0, SEEK_END);
+        printf("file length: %ld\n", len);
+
+        // 测试writev：一次系统调用写出多个缓冲区
+        struct iovec iov[2];
+        iov[0].iov_base = "vectored ";
+        iov[0].iov_len = 9;
+        iov[1].iov_base = "write\n";
+        iov[1].iov_len = 6;
+        printf("writev: %ld\n", (long)writev(fd, iov, 2));
+
+        // 测试pwrite64/pread64：定位读写不改变文件位置。
+        // O_APPEND下pwrite会忽略偏移追加到末尾，所以换一个不带O_APPEND的fd
+        close(fd);
+        fd = open(filename, O_RDWR, 0644);
+        printf("reopen without O_APPEND, fd = %d\n", fd);
+        if (fd < 0)
+        {
+            printf("=== 文件操作测试完成 ===\n\n");
+            return;
+        }
+
+        off_t pos = lseek(fd, 0, SEEK_CUR);
+        char buf[16];
+        memset(buf, 0, sizeof(buf));
+        if (pwrite64(fd, "HELLO", 5, 0) == 5 && pread64(fd, buf, 5, 0) == 5 &&
+            strncmp(buf, "HELLO", 5) == 0 && lseek(fd, 0, SEEK_CUR) == pos)
+        {
+            printf("pwrite64/pread64: %s, OK\n", buf);
+        }
+        else
+        {
+            printf("pwrite64/pread64 FAILED: read back '%s', errno=%d\n", buf, mini_errno);
+        }
+
+        // 测试preadv2(RWF_NOWAIT)：数据刚写入，应能从页缓存直接读到
+        memset(buf, 0, sizeof(buf));
+        iov[0].iov_base = buf;
+        iov[0].iov_len = 5;
+        ssize_t n = preadv2(fd, iov, 1, 0, RWF_NOWAIT);
+        printf("preadv2(RWF_NOWAIT): %ld, errno=%d\n", (long)n, n < 0 ? mini_errno : 0);
+
+        // 测试64位偏移：定位到4GB之后
+        off_t big = lseek(fd, 5L << 30, SEEK_SET);
+        printf("lseek to 5GB: %ld\n", big);
 
         close(fd);
         printf("file closed\n");
@@ -273,6 +342,50 @@ static void* thread_worker(void* arg)
     return (void*)(long)thread_num;  // 返回线程号作为返回值
 }
 
+/**
+ * 使用大栈的工作线程，局部数组超过默认64KB栈
+ */
+#define BIG_STACK_SIZE  (512 * 1024)
+static void* big_stack_worker(void* arg)
+{
+    volatile char buf[256 * 1024];
+    long sum = 0;
+
+    for (int i = 0; i < (int)sizeof(buf); i += 4096)
+    {
+        buf[i] = (char)i;
+        sum += buf[i] != 0;
+    }
+    return (void*)sum;
+}
+
+/**
+ * pthread_exit测试：从嵌套调用中直接结束线程
+ */
+static void exit_from_nested(pthread_t *self)
+{
+    *self = pthread_self();
+    pthread_exit((void*)42);
+}
+
+static void* exit_worker(void* arg)
+{
+    exit_from_nested((pthread_t*)arg);
+    return (void*)-1;   // 不会执行到这里
+}
+
+/**
+ * 分离线程：结束时自行回收栈，完成计数供主线程等待
+ */
+#define DETACHED_NUM 32
+static volatile int g_detached_done;
+
+static void* detached_worker(void* arg)
+{
+    mini_atomic_fetch_add(&g_detached_done, 1, MINI_ATOMIC_RELEASE);
+    return NULL;
+}
+
 /**
  * 线程功能测试
  */
@@ -303,6 +416,61 @@ static void test_thread(void)
         pthread_join(threads[i], &ret_val);
         printf("Thread %d: 返回值 = %ld\n", i + 1, (long)ret_val);
     }
+
+    // 属性指定的大栈，第二轮复用第一轮放回缓存的栈映射
+    pthread_attr_t attr;
+    size_t stack_size = 0;
+    pthread_attr_init(&attr);
+    if (pthread_attr_setstacksize(&attr, 1024) != EINVAL)
+    {
+        printf("pthread_attr_setstacksize: 未拒绝过小的栈\n");
+    }
+    pthread_attr_setstacksize(&attr, BIG_STACK_SIZE);
+    pthread_attr_getstacksize(&attr, &stack_size);
+    for (int round = 0; round < 2; round++)
+    {
+        pthread_t big;
+        void *ret_val = NULL;
+        if (pthread_create(&big, &attr, big_stack_worker, NULL) != 0)
+        {
+            printf("大栈线程创建失败\n");
+            break;
+        }
+        pthread_join(big, &ret_val);
+        printf("大栈线程(%ld字节) 第%d轮: 返回值 = %ld\n", (long)stack_size, round + 1, (long)ret_val);
+    }
+    pthread_attr_destroy(&attr);
+
+    // pthread_exit的返回值交给join，pthread_self与创建时得到的标识符相同
+    pthread_t exiter, exiter_self = 0;
+    void *exit_val = NULL;
+    pthread_create(&exiter, NULL, exit_worker, &exiter_self);
+    pthread_join(exiter, &exit_val);
+    printf("pthread_exit线程: 返回值 = %ld, pthread_self %s\n",
+           (long)exit_val, exiter_self == exiter ? "一致" : "不一致");
+
+    // 分离线程，一半创建时分离，一半创建后pthread_detach
+    g_detached_done = 0;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (int i = 0; i < DETACHED_NUM; i++)
+    {
+        pthread_t d;
+        if (i % 2 == 0)
+        {
+            pthread_create(&d, &attr, detached_worker, NULL);
+        }
+        else if (pthread_create(&d, NULL, detached_worker, NULL) == 0)
+        {
+            pthread_detach(d);
+        }
+    }
+    pthread_attr_destroy(&attr);
+    while (mini_atomic_load(&g_detached_done, MINI_ATOMIC_ACQUIRE) < DETACHED_NUM)
+    {
+        sched_yield();
+    }
+    printf("分离线程: %d/%d 完成\n", g_detached_done, DETACHED_NUM);
     
     printf("=== 线程功能测试完成 ===\n\n");
 }
@@ -406,53 +574,1848 @@ static void test_mutex(void)
     {
         printf("非持有者解锁测试成功 (返回值: %d)\n", ret);
     }
+
+    // 无竞争时加锁/解锁不进入内核
+    printf("\n[测试4] 无竞争加锁/解锁耗时:\n");
+    #define MUTEX_UNCONTENDED_LOOPS 1000000
+    pthread_mutex_init(&mutex, NULL);
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < MUTEX_UNCONTENDED_LOOPS; i++)
+    {
+        pthread_mutex_lock(&mutex);
+        pthread_mutex_unlock(&mutex);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    long ns = (t1.tv_sec - t0.tv_sec) * 1000000000L + (t1.tv_nsec - t0.tv_nsec);
+    printf("%d次加锁+解锁: %ld ns/次\n", MUTEX_UNCONTENDED_LOOPS, ns / MUTEX_UNCONTENDED_LOOPS);
+
+    // 以-DMINI_LOCK_PROFILE编译时输出上面各把锁的竞争统计
+    printf("\n[测试5] 竞争统计:\n");
+    pthread_mutex_profile_dump();
     
     printf("=== 互斥锁测试完成 ===\n\n");
 }
 
-int main(int argc, char *argv[])
+/**
+ * 日志功能测试
+ */
+static void test_log(void)
 {
-    if (argc < 2) 
+    printf("\n=== 开始日志测试 ===\n");
+
+    LOG_DEBUG("debug message, value=%d", 1);
+    LOG_INFO("info message, value=%d", 2);
+    LOG_ERROR("error message, value=%d", 3);
+
+    // 调整default模块级别后DEBUG/INFO不再输出
+    set_log_level(LOG_LEVEL_ERROR);
+    printf("set_log_level(ERROR) 后:\n");
+    LOG_DEBUG("should not be printed");
+    LOG_INFO("should not be printed");
+    LOG_ERROR("error still printed");
+
+    // 单独设置模块级别
+    if (log_set_module_level("default", LOG_LEVEL_DEBUG) == 0)
     {
-        print_usage(argv[0]);
-        return -1;
+        printf("log_set_module_level(default, DEBUG) 后:\n");
+        LOG_DEBUG("debug printed again");
+    }
+    if (log_set_module_level("no_such_module", LOG_LEVEL_INFO) != 0)
+    {
+        printf("不存在的模块设置失败（预期）\n");
     }
+    log_set_module_level("default", -1);
 
-    // 根据第一个参数选择测试模式
-    switch (argv[1][1])  // 跳过'-'
+    // 限流：热点循环中每秒最多输出3条，其余被汇总
+    printf("限流测试(每秒3条):\n");
+    for (int i = 0; i < 100000; i++)
     {
-        case 'f':  // 文件操作测试
-            if (argc < 3) 
+        LOG_ERROR_RATELIMIT(3, 1000, "hot loop error %d", i);
+    }
+
+    // 跨窗口：上个窗口被抑制的条数在新窗口第一条放行时汇总打印
+    printf("限流跨窗口测试(每50ms 2条):\n");
+    static struct log_site rl_site = {
+        &__LOG_MODULE_VAR, __FILE__, NULL, __func__, __LINE__, LOG_LEVEL_ERROR
+    };
+    static struct log_ratelimit rl;
+    int passed = 0;
+    for (int i = 0; i < 10; i++)
+    {
+        passed += log_ratelimit_pass(&rl_site, &rl, 2, 50);
+    }
+    unsigned int pending = rl.suppressed;
+
+    // 等满一个窗口长度，保证下一次调用落在新窗口
+    uint64_t deadline = cycles_read() + cycles_freq() / 1000 * 50;
+    while (cycles_read() < deadline)
+    {
+        __asm__ volatile("yield");
+    }
+    int pass_next = log_ratelimit_pass(&rl_site, &rl, 2, 50);
+    printf("窗口内放行 %d 条, 抑制 %d 条; 新窗口放行=%d, 剩余抑制计数=%d (期望 2, 8, 1, 0)\n",
+           passed, (int)pending, pass_next, (int)rl.suppressed);
+
+    // 采样：平均每1000条输出1条
+    printf("采样测试(1/1000):\n");
+    for (int i = 0; i < 10000; i++)
+    {
+        LOG_ERROR_SAMPLED(1000, "sampled error %d", i);
+    }
+
+    printf("=== 日志测试完成 ===\n\n");
+}
+
+/**
+ * io_uring功能测试
+ */
+#define URING_BATCH 8
+static void test_io_uring(const char *filename)
+{
+    printf("\n=== 开始io_uring测试 ===\n");
+
+    struct io_uring ring;
+    int ret = io_uring_queue_init(32, &ring, 0);
+    if (ret < 0)
+    {
+        printf("io_uring_queue_init failed: %d\n", ret);
+        return;
+    }
+
+    // 通过io_uring打开文件
+    struct io_uring_cqe *cqe;
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+    io_uring_prep_openat(sqe, AT_FDCWD, filename, O_CREAT | O_TRUNC | O_RDWR, 0644);
+    io_uring_submit_and_wait(&ring, 1);
+    io_uring_wait_cqe(&ring, &cqe);
+    int fd = cqe->res;
+    io_uring_cqe_seen(&ring, cqe);
+    printf("openat via io_uring, fd = %d\n", fd);
+    if (fd < 0)
+    {
+        io_uring_queue_exit(&ring);
+        return;
+    }
+
+    // 注册一块缓冲区，一次提交多个固定缓冲区写
+    static char wbuf[URING_BATCH * 16];
+    static char rbuf[URING_BATCH * 16];
+    struct iovec iov[2];
+    iov[0].iov_base = wbuf;
+    iov[0].iov_len = sizeof(wbuf);
+    iov[1].iov_base = rbuf;
+    iov[1].iov_len = sizeof(rbuf);
+    ret = io_uring_register_buffers(&ring, iov, 2);
+    printf("register buffers: %d\n", ret);
+
+    for (int i = 0; i < URING_BATCH; i++)
+    {
+        char *chunk = wbuf + i * 16;
+        memset(chunk, 'a' + i, 15);
+        chunk[15] = '\n';
+
+        sqe = io_uring_get_sqe(&ring);
+        io_uring_prep_write_fixed(sqe, fd, chunk, 16, i * 16, 0);
+        io_uring_sqe_set_data(sqe, (void *)(long)i);
+    }
+    ret = io_uring_submit_and_wait(&ring, URING_BATCH);
+    printf("submitted %d writes in one syscall\n", ret);
+
+    int written = 0;
+    for (int i = 0; i < URING_BATCH; i++)
+    {
+        io_uring_wait_cqe(&ring, &cqe);
+        if (cqe->res > 0)
+        {
+            written += cqe->res;
+        }
+        io_uring_cqe_seen(&ring, cqe);
+    }
+    printf("written %d bytes\n", written);
+
+    // 读回并校验
+    sqe = io_uring_get_sqe(&ring);
+    io_uring_prep_read_fixed(sqe, fd, rbuf, sizeof(rbuf), 0, 1);
+    io_uring_submit_and_wait(&ring, 1);
+    io_uring_wait_cqe(&ring, &cqe);
+    printf("read back %d bytes, match = %d\n", cqe->res,
+           cqe->res == (int)sizeof(wbuf) && strncmp(rbuf, wbuf, sizeof(wbuf)) == 0);
+    io_uring_cqe_seen(&ring, cqe);
+
+    io_uring_unregister_buffers(&ring);
+    close(fd);
+    io_uring_queue_exit(&ring);
+
+    printf("=== io_uring测试完成 ===\n\n");
+}
+
+/**
+ * 事件循环测试 - 连接可读回调，收到数据后回显
+ */
+static void echo_on_readable(struct event_loop *loop, int fd, uint32_t events, void *arg)
+{
+    int *conn_count = (int *)arg;
+    char buf[512];
+
+    // 边沿触发：一直读到EAGAIN
+    while (1)
+    {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n > 0)
+        {
+            send(fd, buf, n, 0);
+            continue;
+        }
+        if (n < 0 && mini_errno == EAGAIN)
+        {
+            return;
+        }
+
+        // 对端关闭或出错
+        event_loop_del_fd(loop, fd);
+        close(fd);
+        (*conn_count)--;
+        return;
+    }
+}
+
+/**
+ * 事件循环测试 - 新连接回调
+ */
+static void echo_on_accept(struct event_loop *loop, int conn_fd, void *arg)
+{
+    int *conn_count = (int *)arg;
+
+    if (event_loop_add_fd(loop, conn_fd, EPOLLIN | EPOLLRDHUP | EPOLLET, echo_on_readable, arg) < 0)
+    {
+        close(conn_fd);
+        return;
+    }
+    (*conn_count)++;
+}
+
+/**
+ * 事件循环测试 - 周期定时器，运行指定秒数后停止
+ */
+static void echo_on_timer(struct event_loop *loop, int timer_fd, uint64_t expirations, void *arg)
+{
+    static int seconds = 0;
+    int *conn_count = (int *)arg;
+
+    seconds += (int)expirations;
+    printf("Server: %d 秒, 当前连接数 %d\n", seconds, *conn_count);
+    if (seconds >= 10)
+    {
+        event_loop_stop(loop);
+    }
+}
+
+/**
+ * epoll事件循环服务器测试：同时服务多个客户端，10秒后退出
+ */
+static void test_event_loop(void)
+{
+    printf("\n=== 开始epoll事件循环服务器测试 ===\n");
+
+    int server_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server_fd < 0)
+    {
+        printf("Server: socket create failed\n");
+        return;
+    }
+
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = INADDR_ANY;
+    server_addr.sin_port = htons(8080);
+    if (bind(server_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0 ||
+        listen(server_fd, 128) < 0)
+    {
+        printf("Server: bind/listen failed, errno=%d\n", mini_errno);
+        close(server_fd);
+        return;
+    }
+    printf("Server: listening on port 8080\n");
+
+    struct event_loop *loop = event_loop_create(0);
+    if (!loop)
+    {
+        printf("event_loop_create failed\n");
+        close(server_fd);
+        return;
+    }
+
+    int conn_count = 0;
+    event_loop_add_listener(loop, server_fd, echo_on_accept, &conn_count);
+    event_loop_add_timer(loop, 1000, 1000, echo_on_timer, &conn_count);
+    event_loop_run(loop);
+
+    event_loop_destroy(loop);
+    close(server_fd);
+
+    printf("=== epoll事件循环服务器测试完成 ===\n\n");
+}
+
+/**
+ * 零拷贝文件发送测试：把文件通过sendfile/splice发送给第一个连接的客户端
+ */
+static void test_sendfile(const char *filename)
+{
+    printf("\n=== 开始零拷贝文件发送测试 ===\n");
+
+    int file_fd = open(filename, O_RDONLY, 0);
+    if (file_fd < 0)
+    {
+        printf("open %s failed\n", filename);
+        return;
+    }
+    off_t size = lseek(file_fd, 0, SEEK_END);
+
+    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = INADDR_ANY;
+    server_addr.sin_port = htons(8080);
+    if (server_fd < 0 ||
+        bind(server_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0 ||
+        listen(server_fd, 1) < 0)
+    {
+        printf("Server: socket/bind/listen failed\n");
+        close(file_fd);
+        return;
+    }
+    printf("Server: listening on port 8080, file size %ld\n", size);
+
+    int client_fd = accept(server_fd, NULL, NULL);
+    if (client_fd >= 0)
+    {
+        // 先读掉客户端的请求
+        char buf[128];
+        recv(client_fd, buf, sizeof(buf), 0);
+
+        struct file_stream fs;
+        file_stream_init(&fs, client_fd, file_fd, 0, size);
+        int ret = file_stream_send(&fs);
+        printf("Server: file_stream_send ret=%d, sent %ld bytes\n", ret, (long)fs.sent);
+        file_stream_close(&fs);
+        close(client_fd);
+    }
+
+    close(server_fd);
+    close(file_fd);
+
+    printf("=== 零拷贝文件发送测试完成 ===\n\n");
+}
+
+#define ZC_TEST_BUFS        4
+#define ZC_TEST_BUF_SIZE    (256 * 1024)
+#define ZC_TEST_TOTAL       (64L * 1024 * 1024)
+
+/**
+ * 读掉接收端当前所有数据，返回读到的字节数
+ */
+static long zc_test_drain(int fd, char *buf, size_t len)
+{
+    long total = 0;
+    ssize_t n;
+
+    while ((n = recvfrom(fd, buf, len, MSG_DONTWAIT, NULL, NULL)) > 0)
+    {
+        total += n;
+    }
+    return total;
+}
+
+/**
+ * MSG_ZEROCOPY发送测试：在回环连接上轮流使用几块缓冲区发送，
+ * 复用缓冲区前等待它的完成通知
+ */
+static void test_zerocopy(void)
+{
+    printf("\n=== 开始MSG_ZEROCOPY发送测试 ===\n");
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(8081);
+
+    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    int tx_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (server_fd < 0 || tx_fd < 0 ||
+        bind(server_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(server_fd, 1) < 0 ||
+        connect(tx_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        printf("socket setup failed, errno=%d\n", mini_errno);
+        return;
+    }
+    int rx_fd = accept(server_fd, NULL, NULL);
+    set_nonblocking(tx_fd);
+
+    char *bufs = mmap(NULL, ZC_TEST_BUFS * ZC_TEST_BUF_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    char *rx_buf = mmap(NULL, ZC_TEST_BUF_SIZE, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (rx_fd < 0 || bufs == MAP_FAILED || rx_buf == MAP_FAILED)
+    {
+        printf("accept/mmap failed, errno=%d\n", mini_errno);
+        return;
+    }
+
+    struct zc_sender zs;
+    uint32_t ids[ZC_TEST_BUFS];
+    size_t off[ZC_TEST_BUFS];
+    int i;
+    zc_sender_init(&zs, tx_fd);
+    printf("SO_ZEROCOPY enabled: %d\n", zs.enabled);
+    for (i = 0; i < ZC_TEST_BUFS; i++)
+    {
+        ids[i] = ZC_ID_NONE;
+        off[i] = ZC_TEST_BUF_SIZE;
+    }
+
+    long sent = 0, received = 0, zc_sends = 0, copy_sends = 0;
+    int cur = 0;
+    while (sent < ZC_TEST_TOTAL)
+    {
+        char *buf = bufs + cur * ZC_TEST_BUF_SIZE;
+
+        // 整块缓冲区发完后才换下一块；复用前必须等内核释放
+        if (off[cur] == ZC_TEST_BUF_SIZE)
+        {
+            while (!zc_buffer_reusable(&zs, ids[cur]))
             {
-                printf("Error: Missing filename for file test\n");
-                print_usage(argv[0]);
-                return -1;
+                received += zc_test_drain(rx_fd, rx_buf, ZC_TEST_BUF_SIZE);
+                zc_reap(&zs);
             }
-            test_file(argv[2]);
-            break;
-            
-        case 'm':  // 内存操作测试
-            test_memory();
-            break;
-            
-        case 'p':  // 进程(fork)测试
-            test_fork();
-            break;
-            
-        case 's':  // socket服务器测试
-            test_socket_server();
-            break;
-            
-        case 'c':  // socket客户端测试
-            test_socket_client();
-            break;
-            
-        case 't':  // 线程测试
-            test_thread();
+            memset(buf, 'a' + cur, ZC_TEST_BUF_SIZE);
+            off[cur] = 0;
+        }
+
+        uint32_t id;
+        ssize_t n = zc_send(&zs, buf + off[cur], ZC_TEST_BUF_SIZE - off[cur], 0, &id);
+        if (n < 0 && mini_errno != EAGAIN)
+        {
+            printf("zc_send failed, errno=%d\n", mini_errno);
             break;
-            
-        case 'l':  // 互斥锁测试
-            test_mutex();
+        }
+        if (n > 0)
+        {
+            // 同一块缓冲区分多次发送时，最后一次的序号覆盖前面的
+            if (id != ZC_ID_NONE)
+            {
+                ids[cur] = id;
+                zc_sends++;
+            }
+            else
+            {
+                copy_sends++;
+            }
+            off[cur] += n;
+            sent += n;
+            if (off[cur] == ZC_TEST_BUF_SIZE)
+            {
+                cur = (cur + 1) % ZC_TEST_BUFS;
+            }
+        }
+        received += zc_test_drain(rx_fd, rx_buf, ZC_TEST_BUF_SIZE);
+    }
+
+    while (received < sent)
+    {
+        received += zc_test_drain(rx_fd, rx_buf, ZC_TEST_BUF_SIZE);
+    }
+    if (zc_flush(&zs, 1000) < 0)
+    {
+        printf("zc_flush failed, errno=%d\n", mini_errno);
+    }
+
+    printf("sent %ld bytes, received %ld bytes\n", sent, received);
+    printf("zerocopy sends %ld, copy sends %ld\n", zc_sends, copy_sends);
+    printf("completions: zerocopy %ld, copied by kernel %ld\n",
+           (long)zs.zc_completions, (long)zs.copied_completions);
+
+    munmap(bufs, ZC_TEST_BUFS * ZC_TEST_BUF_SIZE);
+    munmap(rx_buf, ZC_TEST_BUF_SIZE);
+    close(tx_fd);
+    close(rx_fd);
+    close(server_fd);
+
+    printf("=== MSG_ZEROCOPY发送测试完成 ===\n\n");
+}
+
+/**
+ * 把十进制字符串转换为整数，遇到非数字字符结束
+ */
+static int parse_int(const char *s)
+{
+    int v = 0;
+    while (*s >= '0' && *s <= '9')
+    {
+        v = v * 10 + (*s - '0');
+        s++;
+    }
+    return v;
+}
+
+/* 多线程服务器测试的共享状态，计数器在多个worker间原子更新 */
+struct reuseport_test
+{
+    struct server srv;
+    volatile int conn_count;
+    volatile long accepted;
+};
+
+/**
+ * 多线程服务器测试 - 连接可读回调，收到数据后回显
+ */
+static void reuseport_on_readable(struct event_loop *loop, int fd, uint32_t events, void *arg)
+{
+    struct reuseport_test *t = (struct reuseport_test *)arg;
+    char buf[512];
+
+    while (1)
+    {
+        ssize_t n = recvfrom(fd, buf, sizeof(buf), 0, NULL, NULL);
+        if (n > 0)
+        {
+            send(fd, buf, n, 0);
+            continue;
+        }
+        if (n < 0 && mini_errno == EAGAIN)
+        {
+            return;
+        }
+
+        event_loop_del_fd(loop, fd);
+        close(fd);
+        mini_atomic_fetch_sub(&t->conn_count, 1, MINI_ATOMIC_RELAXED);
+        return;
+    }
+}
+
+/**
+ * 多线程服务器测试 - 新连接回调，在接收该连接的worker线程中执行
+ */
+static void reuseport_on_accept(struct event_loop *loop, int conn_fd, void *arg)
+{
+    struct reuseport_test *t = (struct reuseport_test *)arg;
+
+    if (event_loop_add_fd(loop, conn_fd, EPOLLIN | EPOLLRDHUP | EPOLLET, reuseport_on_readable, arg) < 0)
+    {
+        close(conn_fd);
+        return;
+    }
+    mini_atomic_fetch_add(&t->conn_count, 1, MINI_ATOMIC_RELAXED);
+    mini_atomic_fetch_add(&t->accepted, 1, MINI_ATOMIC_RELAXED);
+}
+
+/**
+ * 多线程服务器测试 - worker 0上的周期定时器，运行10秒后停止整个服务器
+ */
+static void reuseport_on_timer(struct event_loop *loop, int timer_fd, uint64_t expirations, void *arg)
+{
+    static int seconds = 0;
+    struct reuseport_test *t = (struct reuseport_test *)arg;
+
+    seconds += (int)expirations;
+    printf("Server: %d 秒, 当前连接数 %d, 累计接受 %ld\n", seconds, t->conn_count, t->accepted);
+    if (seconds >= 10)
+    {
+        server_stop(&t->srv);
+    }
+}
+
+static void reuseport_on_worker_start(struct event_loop *loop, int worker_id, void *arg)
+{
+    if (worker_id == 0)
+    {
+        event_loop_add_timer(loop, 1000, 1000, reuseport_on_timer, arg);
+    }
+}
+
+static void server_quick_on_accept(struct event_loop *loop, int conn_fd, void *arg)
+{
+    close(conn_fd);
+}
+
+/**
+ * 启动后立即停止：worker线程可能还没进入event_loop_run，stop不能丢失，
+ * 否则server_wait中的pthread_join会一直挂起
+ */
+static void test_server_quick_stop(void)
+{
+    #define SERVER_QUICK_ROUNDS 20
+    static struct server srv;
+    struct server_config cfg;
+    int done = 0;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.port = 8081;
+    cfg.workers = 4;
+    cfg.on_accept = server_quick_on_accept;
+
+    for (int i = 0; i < SERVER_QUICK_ROUNDS; i++)
+    {
+        if (server_start(&srv, &cfg) < 0)
+        {
+            printf("server_start failed, errno=%d\n", mini_errno);
+            break;
+        }
+        server_stop(&srv);
+        server_wait(&srv);
+        done++;
+    }
+    printf("启动后立即停止: 完成 %d 轮 (期望 %d)\n", done, SERVER_QUICK_ROUNDS);
+}
+
+/**
+ * SO_REUSEPORT多线程服务器测试：每个CPU一个worker，10秒后退出
+ */
+static void test_reuseport_server(int workers)
+{
+    printf("\n=== 开始SO_REUSEPORT多线程服务器测试 ===\n");
+
+    test_server_quick_stop();
+
+    static struct reuseport_test t;
+    struct server_config cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.port = 8080;
+    cfg.workers = workers;
+    cfg.pin_cpus = 1;
+    cfg.tcp_nodelay = 1;
+    cfg.on_accept = reuseport_on_accept;
+    cfg.on_worker_start = reuseport_on_worker_start;
+    cfg.arg = &t;
+
+    if (server_start(&t.srv, &cfg) < 0)
+    {
+        printf("server_start failed, errno=%d\n", mini_errno);
+        return;
+    }
+    printf("Server: listening on port 8080, %d workers, %d cpus\n", t.srv.nworkers, get_nprocs());
+    server_wait(&t.srv);
+
+    printf("=== SO_REUSEPORT多线程服务器测试完成 ===\n\n");
+}
+
+#define UNIX_TEST_SHM_SIZE  (1 << 20)
+
+/**
+ * AF_UNIX测试：抽象命名空间的流式连接、对端凭证、路径名上残留节点的清理，
+ * 以及父子进程间通过SCM_RIGHTS传递memfd共享内存
+ */
+static void test_unix_socket(void)
+{
+    printf("\n=== 开始AF_UNIX socket测试 ===\n");
+
+    // 1. 抽象命名空间的监听/连接
+    int listen_fd = unix_listen("mini_libc_test", 1, SOCK_STREAM, 1);
+    int cli_fd = unix_connect("mini_libc_test", 1, SOCK_STREAM);
+    int srv_fd = listen_fd >= 0 ? accept(listen_fd, NULL, NULL) : -1;
+    if (listen_fd < 0 || cli_fd < 0 || srv_fd < 0)
+    {
+        printf("abstract socket setup failed, errno=%d\n", mini_errno);
+        return;
+    }
+
+    char buf[64];
+    struct ucred cred;
+    send(cli_fd, "ping", 4, 0);
+    ssize_t n = recvfrom(srv_fd, buf, sizeof(buf) - 1, 0, NULL, NULL);
+    buf[n > 0 ? n : 0] = '\0';
+    unix_peer_cred(srv_fd, &cred);
+    printf("abstract: received \"%s\", peer pid %d (self %d)\n", buf, cred.pid, getpid());
+    close(cli_fd);
+    close(srv_fd);
+    close(listen_fd);
+
+    // 路径名：普通文件不会被当成残留节点删除；关闭后留下的socket节点会被清理
+    #define UNIX_TEST_PATH "mini_libc_unix_test.sock"
+    int file_fd = open(UNIX_TEST_PATH, O_CREAT | O_RDWR, 0644);
+    close(file_fd);
+    listen_fd = unix_listen(UNIX_TEST_PATH, 0, SOCK_STREAM, 1);
+    struct stat st;
+    printf("path: listen on regular file -> %d, errno=%d, file kept=%d (期望 -1, %d, 1)\n",
+           listen_fd, listen_fd < 0 ? mini_errno : 0,
+           lstat(UNIX_TEST_PATH, &st) == 0 && S_ISREG(st.st_mode), EADDRINUSE);
+    unlink(UNIX_TEST_PATH);
+
+    listen_fd = unix_listen(UNIX_TEST_PATH, 0, SOCK_STREAM, 1);
+    close(listen_fd);
+    listen_fd = unix_listen(UNIX_TEST_PATH, 0, SOCK_STREAM, 1);
+    printf("path: relisten over stale socket node -> %s\n", listen_fd >= 0 ? "OK" : "FAILED");
+    close(listen_fd);
+    unlink(UNIX_TEST_PATH);
+
+    // 2. socketpair + fork，父进程把memfd发给子进程，双方通过共享映射交换数据
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0)
+    {
+        printf("socketpair failed, errno=%d\n", mini_errno);
+        return;
+    }
+    unix_enable_passcred(sv[0]);
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        printf("fork failed\n");
+        return;
+    }
+
+    if (pid == 0)
+    {
+        // 子进程：收fd，映射后读出父进程写的内容并写回应答
+        int fd;
+        int nfds = 1;
+        close(sv[0]);
+        if (unix_recv_fds(sv[1], buf, sizeof(buf), &fd, &nfds) < 0 || nfds != 1)
+        {
+            printf("child: unix_recv_fds failed, errno=%d\n", mini_errno);
+            close(sv[1]);
+            return;
+        }
+        char *shm = mmap(NULL, UNIX_TEST_SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (shm == MAP_FAILED)
+        {
+            printf("child: mmap failed, errno=%d\n", mini_errno);
+            close(sv[1]);
+            return;
+        }
+        printf("child: shared memory says \"%s\"\n", shm);
+        memcpy(shm + UNIX_TEST_SHM_SIZE / 2, "hello from child", sizeof("hello from child"));
+        unix_send_creds(sv[1], "done", 4);
+        munmap(shm, UNIX_TEST_SHM_SIZE);
+        close(fd);
+        close(sv[1]);
+        return;
+    }
+
+    close(sv[1]);
+    int mfd = memfd_create("unix_test", MFD_CLOEXEC);
+    char *shm = MAP_FAILED;
+    if (mfd >= 0 && ftruncate(mfd, UNIX_TEST_SHM_SIZE) == 0)
+    {
+        shm = mmap(NULL, UNIX_TEST_SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, mfd, 0);
+    }
+    if (shm == MAP_FAILED)
+    {
+        printf("memfd setup failed, errno=%d\n", mini_errno);
+        close(sv[0]);
+        waitpid(pid, NULL, 0);
+        return;
+    }
+
+    memcpy(shm, "hello from parent", sizeof("hello from parent"));
+    unix_send_fds(sv[0], "memfd", 5, &mfd, 1);
+
+    n = unix_recv_creds(sv[0], buf, sizeof(buf), &cred);
+    printf("parent: got %ld bytes from pid %d (child %d), uid %d\n",
+           (long)n, cred.pid, pid, (int)cred.uid);
+    printf("parent: shared memory says \"%s\"\n", shm + UNIX_TEST_SHM_SIZE / 2);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    munmap(shm, UNIX_TEST_SHM_SIZE);
+    close(mfd);
+    close(sv[0]);
+
+    printf("=== AF_UNIX socket测试完成 ===\n\n");
+}
+
+#define TIME_TEST_LOOPS     1000000
+
+/**
+ * 时间接口测试：检查vDSO绑定情况，测量各种取时间方式的单次开销
+ */
+static void test_time(void)
+{
+    printf("\n=== 开始vDSO时间接口测试 ===\n");
+
+    printf("AT_SYSINFO_EHDR = %ld, AT_PAGESZ = %ld\n",
+           (long)getauxval(AT_SYSINFO_EHDR), (long)getauxval(AT_PAGESZ));
+    printf("__kernel_clock_gettime = %ld\n",
+           (long)vdso_sym("LINUX_2.6.39", "__kernel_clock_gettime"));
+
+    struct timespec ts, res;
+    struct timeval tv;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    gettimeofday(&tv, NULL);
+    clock_getres(CLOCK_MONOTONIC, &res);
+    printf("realtime %ld s, gettimeofday %ld s, monotonic resolution %ld ns\n",
+           ts.tv_sec, tv.tv_sec, res.tv_nsec);
+
+    uint64_t freq = cycles_calibrate();
+    printf("counter frequency %ld Hz (CNTFRQ_EL0 %ld Hz)\n", (long)freq, (long)cycles_freq());
+
+    int i;
+    uint64_t start = cycles_read_ordered();
+    for (i = 0; i < TIME_TEST_LOOPS; i++)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+    }
+    uint64_t elapsed = cycles_read_ordered() - start;
+    printf("clock_gettime: %ld ns/call\n", (long)(cycles_to_ns(elapsed) / TIME_TEST_LOOPS));
+
+    start = cycles_read_ordered();
+    for (i = 0; i < TIME_TEST_LOOPS; i++)
+    {
+        cycles_read();
+    }
+    elapsed = cycles_read_ordered() - start;
+    printf("cycles_read: %ld ns/call\n", (long)(cycles_to_ns(elapsed) / TIME_TEST_LOOPS));
+
+    printf("=== vDSO时间接口测试完成 ===\n\n");
+}
+
+#define BUFIO_TEST_FILE     "/tmp/mini_libc_bufio_test.txt"
+#define BUFIO_TEST_LINES    10000
+#define BUFIO_LONG_LINE     10000
+
+/**
+ * 带缓冲读取器与文件映射测试：用4KB小缓冲区读取含超长行的文件，
+ * 分别按行、按定长记录、按映射逐行扫描，核对行数和字节数
+ */
+static void test_bufio(void)
+{
+    printf("\n=== 开始缓冲读取与文件映射测试 ===\n");
+
+    int fd = open(BUFIO_TEST_FILE, O_CREAT | O_TRUNC | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        printf("open %s failed, errno=%d\n", BUFIO_TEST_FILE, -fd);
+        return;
+    }
+
+    // 生成测试文件：普通行中间夹一行超过缓冲区大小的长行
+    char line[64];
+    long total = 0;
+    int i;
+    for (i = 0; i < BUFIO_TEST_LINES; i++)
+    {
+        int len = snprintf(line, sizeof(line), "line %d\n", i);
+        write(fd, line, len);
+        total += len;
+        if (i == BUFIO_TEST_LINES / 2)
+        {
+            char *long_line = malloc(BUFIO_LONG_LINE + 1);
+            memset(long_line, 'x', BUFIO_LONG_LINE);
+            long_line[BUFIO_LONG_LINE] = '\n';
+            write(fd, long_line, BUFIO_LONG_LINE + 1);
+            total += BUFIO_LONG_LINE + 1;
+            free(long_line);
+        }
+    }
+    printf("wrote %d lines, %ld bytes\n", BUFIO_TEST_LINES + 1, total);
+
+    // 1. 按行读取
+    struct buf_reader r;
+    char *buf = NULL;
+    size_t cap = 0;
+    long lines = 0, bytes = 0, longest = 0;
+    ssize_t n;
+    lseek(fd, 0, SEEK_SET);
+    buf_reader_init(&r, fd, 4096);
+    while ((n = buf_getline(&r, &buf, &cap)) > 0)
+    {
+        lines++;
+        bytes += n;
+        longest = n > longest ? n : longest;
+    }
+    printf("buf_getline: %ld lines, %ld bytes, longest %ld, %s\n",
+           lines, bytes, longest, n == 0 ? "eof" : "error");
+    free(buf);
+    buf_reader_destroy(&r);
+
+    // 2. 按16字节定长记录读取，最后不足一条的部分单独读出
+    long records = 0;
+    char tail[16];
+    lseek(fd, 0, SEEK_SET);
+    buf_reader_init(&r, fd, 4096);
+    while (buf_next_record(&r, 16) != NULL)
+    {
+        records++;
+    }
+    n = buf_read_record(&r, tail, sizeof(tail));
+    printf("buf_next_record: %ld records + %ld tail bytes = %ld bytes\n",
+           records, (long)n, records * 16 + n);
+    buf_reader_destroy(&r);
+    close(fd);
+
+    // 3. 映射整个文件，用memchr逐行扫描
+    struct mapped_file mf;
+    if (mapped_file_open(&mf, BUFIO_TEST_FILE, MAPPED_FILE_SEQUENTIAL | MAPPED_FILE_WILLNEED) < 0)
+    {
+        printf("mapped_file_open failed, errno=%d\n", mini_errno);
+        unlink(BUFIO_TEST_FILE);
+        return;
+    }
+    const char *p = mf.data;
+    const char *end = mf.data + mf.len;
+    lines = 0;
+    while (p < end)
+    {
+        const char *nl = memchr(p, '\n', end - p);
+        lines++;
+        p = nl ? nl + 1 : end;
+    }
+    printf("mapped_file: %ld lines, %ld bytes\n", lines, (long)mf.len);
+    mapped_file_close(&mf);
+    unlink(BUFIO_TEST_FILE);
+
+    printf("=== 缓冲读取与文件映射测试完成 ===\n\n");
+}
+
+#define DIO_TEST_BUFS       4
+#define DIO_TEST_BUF_SIZE   (1024 * 1024)
+#define DIO_TEST_ROUNDS     16
+
+/**
+ * 按文件偏移生成的测试数据，便于读回后逐字节校验
+ */
+static void dio_test_fill(char *buf, size_t len, long offset)
+{
+    size_t i;
+    for (i = 0; i < len; i++)
+    {
+        buf[i] = (char)((offset + i) * 7 + ((offset + i) >> 12));
+    }
+}
+
+/**
+ * 直接I/O测试：对齐缓冲区整块写、非对齐数据写、O_APPEND续写，
+ * 再从非对齐偏移读回校验
+ */
+static void test_direct_io(const char *filename)
+{
+    printf("\n=== 开始O_DIRECT直接I/O测试 ===\n");
+
+    struct dio_pool pool;
+    struct dio_file f;
+    struct timespec t0, t1;
+    long offset = 0;
+    int i;
+
+    if (dio_pool_init(&pool, DIO_TEST_BUF_SIZE, DIO_TEST_BUFS) < 0 ||
+        dio_open(&f, filename, O_CREAT | O_TRUNC | O_WRONLY, 0644, 0) < 0)
+    {
+        printf("setup failed, errno=%d\n", mini_errno);
+        return;
+    }
+    printf("%s opened, O_DIRECT %s\n", filename, f.direct ? "on" : "unsupported, buffered");
+
+    // 1. 池中的对齐缓冲区直接写出，不经过中转
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < DIO_TEST_ROUNDS; i++)
+    {
+        char *buf = dio_pool_get(&pool);
+        dio_test_fill(buf, DIO_TEST_BUF_SIZE, offset);
+        if (dio_write(&f, buf, DIO_TEST_BUF_SIZE) < 0)
+        {
+            printf("dio_write failed, errno=%d\n", mini_errno);
+        }
+        offset += DIO_TEST_BUF_SIZE;
+        dio_pool_put(&pool, buf);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    long us = (t1.tv_sec - t0.tv_sec) * 1000000L + (t1.tv_nsec - t0.tv_nsec) / 1000;
+    printf("aligned writes: %ld MB in %ld us, %ld MB/s\n",
+           offset >> 20, us, us > 0 ? (offset >> 20) * 1000000L / us : 0);
+
+    // 2. 不对齐的小块写，由中转缓冲区攒成整块，尾部在关闭时走缓冲写
+    char small[1000];
+    for (i = 0; i < 10; i++)
+    {
+        dio_test_fill(small, sizeof(small) - 1, offset);
+        dio_write(&f, small, sizeof(small) - 1);
+        offset += sizeof(small) - 1;
+    }
+    if (dio_close(&f) < 0)
+    {
+        printf("dio_close failed, errno=%d\n", mini_errno);
+    }
+
+    // 3. O_APPEND续写，文件末尾的非对齐块被读回后重写
+    if (dio_open(&f, filename, O_WRONLY | O_APPEND, 0644, 0) == 0)
+    {
+        dio_test_fill(small, 777, offset);
+        dio_write(&f, small, 777);
+        offset += 777;
+        dio_close(&f);
+    }
+
+    // 4. 从非对齐偏移读回并校验
+    char *expect = dio_pool_get(&pool);
+    char *got = dio_pool_get(&pool);
+    long bad = 0, checked = 0;
+    if (dio_open(&f, filename, O_RDONLY, 0, 0) == 0)
+    {
+        long pos = 12345;
+        ssize_t n;
+        while ((n = dio_pread(&f, got + 3, DIO_TEST_BUF_SIZE - 3, pos)) > 0)
+        {
+            dio_test_fill(expect, n, pos);
+            for (i = 0; i < n; i++)
+            {
+                bad += expect[i] != got[3 + i];
+            }
+            checked += n;
+            pos += n;
+        }
+        dio_close(&f);
+    }
+    printf("file size %ld (expect %ld), verified %ld bytes, %ld mismatches\n",
+           checked + 12345, offset, checked, bad);
+    dio_pool_put(&pool, expect);
+    dio_pool_put(&pool, got);
+
+    dio_pool_destroy(&pool);
+    unlink(filename);
+
+    printf("=== O_DIRECT直接I/O测试完成 ===\n\n");
+}
+
+#define WAL_TEST_THREADS    4
+#define WAL_TEST_RECORDS    2000
+#define WAL_TEST_RECORD     128
+
+static struct append_log g_wal;
+static long g_wal_max_us[WAL_TEST_THREADS];
+
+/**
+ * 每条记录追加后立即等待落盘，模拟逐条提交的事务
+ */
+static void *wal_worker(void *arg)
+{
+    int id = *(int *)arg;
+    char rec[WAL_TEST_RECORD];
+    int i;
+
+    memset(rec, 'a' + id, sizeof(rec));
+    rec[sizeof(rec) - 1] = '\n';
+    for (i = 0; i < WAL_TEST_RECORDS; i++)
+    {
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        off_t lsn = append_log_append(&g_wal, rec, sizeof(rec));
+        if (lsn < 0 || append_log_sync(&g_wal, lsn) < 0)
+        {
+            printf("thread %d: append/sync failed, errno=%d\n", id, mini_errno);
+            break;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        long us = (t1.tv_sec - t0.tv_sec) * 1000000L + (t1.tv_nsec - t0.tv_nsec) / 1000;
+        if (us > g_wal_max_us[id])
+        {
+            g_wal_max_us[id] = us;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * 追加日志测试：多线程逐条提交，group commit把fdatasync次数压到远少于提交次数
+ */
+static void test_append_log(const char *filename)
+{
+    printf("\n=== 开始追加日志测试 ===\n");
+
+    struct append_log_config cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.prealloc_size = 4 << 20;
+    cfg.writeback_size = 256 << 10;
+    cfg.drop_cache = 1;
+
+    unlink(filename);
+    if (append_log_open(&g_wal, filename, &cfg) < 0)
+    {
+        printf("append_log_open %s failed, errno=%d\n", filename, mini_errno);
+        return;
+    }
+
+    pthread_t threads[WAL_TEST_THREADS];
+    int ids[WAL_TEST_THREADS];
+    struct timespec t0, t1;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < WAL_TEST_THREADS; i++)
+    {
+        ids[i] = i;
+        pthread_create(&threads[i], NULL, wal_worker, &ids[i]);
+    }
+    for (i = 0; i < WAL_TEST_THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    long us = (t1.tv_sec - t0.tv_sec) * 1000000L + (t1.tv_nsec - t0.tv_nsec) / 1000;
+    long max_us = 0;
+    for (i = 0; i < WAL_TEST_THREADS; i++)
+    {
+        max_us = g_wal_max_us[i] > max_us ? g_wal_max_us[i] : max_us;
+    }
+    printf("%ld commits, %ld fdatasync, %ld bytes in %ld us, max commit latency %ld us\n",
+           (long)g_wal.commits, (long)g_wal.syncs, (long)g_wal.written, us, max_us);
+
+    off_t size = g_wal.written;
+    append_log_close(&g_wal);
+
+    // 重新打开应从上次的结尾继续追加
+    if (append_log_open(&g_wal, filename, NULL) == 0)
+    {
+        printf("reopen: size %ld (expect %ld)\n", (long)g_wal.written, (long)size);
+        append_log_close(&g_wal);
+    }
+    unlink(filename);
+
+    printf("=== 追加日志测试完成 ===\n\n");
+}
+
+#define TLS_TEST_THREADS    4
+#define TLS_TEST_LOOPS      1000
+
+static __thread long g_tls_counter = 1000;
+static __thread char g_tls_name[16];
+
+/**
+ * 每个线程看到自己的__thread变量初值，修改互不影响
+ */
+static void *tls_worker(void *arg)
+{
+    int id = *(int *)arg;
+    long initial = g_tls_counter;
+    char c;
+    int i;
+
+    for (i = 0; i < TLS_TEST_LOOPS * id; i++)
+    {
+        g_tls_counter++;
+    }
+    snprintf(g_tls_name, sizeof(g_tls_name), "worker-%d", id);
+
+    // 失败的系统调用只设置本线程的mini_errno
+    read(-1, &c, 1);
+    printf("%s: counter %ld -> %ld, errno %d, tid %d (gettid %d)\n",
+           g_tls_name, initial, g_tls_counter, mini_errno, mini_thread_self()->tid, gettid());
+    return NULL;
+}
+
+/**
+ * TLS测试：__thread变量、每线程mini_errno和线程描述符
+ */
+static void test_tls(void)
+{
+    printf("\n=== 开始线程局部存储测试 ===\n");
+
+    pthread_t threads[TLS_TEST_THREADS];
+    int ids[TLS_TEST_THREADS];
+    int i;
+
+    g_tls_counter = 1;
+    memcpy(g_tls_name, "main", sizeof("main"));
+    mini_errno = 0;
+
+    for (i = 0; i < TLS_TEST_THREADS; i++)
+    {
+        ids[i] = i + 1;
+        pthread_create(&threads[i], NULL, tls_worker, &ids[i]);
+    }
+    for (i = 0; i < TLS_TEST_THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    struct mini_thread *self = mini_thread_self();
+    printf("%s: counter %ld, errno %d, tid %d (gettid %d), self %s\n",
+           g_tls_name, g_tls_counter, mini_errno, self->tid, gettid(),
+           self->self == self ? "ok" : "broken");
+
+    printf("=== 线程局部存储测试完成 ===\n\n");
+}
+
+/**
+ * 原子操作测试：多线程对各位宽的计数器做读-改-写，结果应与串行相同
+ */
+#define ATOMIC_TEST_THREADS 4
+#define ATOMIC_TEST_LOOPS   100000
+
+static struct
+{
+    volatile uint8_t  c8;
+    volatile uint16_t c16;
+    volatile uint32_t c32;
+    volatile uint64_t c64;
+    volatile uint64_t bits;
+    volatile uint32_t cas32;
+    volatile mini_uint128_t c128 __attribute__((aligned(16)));
+} g_atomic_test;
+
+static void* atomic_worker(void* arg)
+{
+    int id = *(int *)arg;
+
+    for (int i = 0; i < ATOMIC_TEST_LOOPS; i++)
+    {
+        mini_atomic_fetch_add_8(&g_atomic_test.c8, 1, MINI_ATOMIC_RELAXED);
+        mini_atomic_fetch_add_16(&g_atomic_test.c16, 1, MINI_ATOMIC_ACQUIRE);
+        mini_atomic_fetch_add(&g_atomic_test.c32, 1, MINI_ATOMIC_RELEASE);
+        mini_atomic_fetch_add(&g_atomic_test.c64, 3, MINI_ATOMIC_SEQ_CST);
+
+        uint32_t old = mini_atomic_load(&g_atomic_test.cas32, MINI_ATOMIC_RELAXED);
+        while (!mini_atomic_cas(&g_atomic_test.cas32, &old, old + 1, MINI_ATOMIC_ACQ_REL))
+        {
+        }
+
+        // 128位计数器的高低两半同时加1，读到的两半必须相等
+        mini_uint128_t one = ((mini_uint128_t)1 << 64) | 1;
+        mini_atomic_fetch_add_128(&g_atomic_test.c128, one, MINI_ATOMIC_SEQ_CST);
+    }
+
+    // 每个线程置位并清除自己的位，最后只剩置位
+    mini_atomic_fetch_or(&g_atomic_test.bits, 3UL << (id * 2), MINI_ATOMIC_RELAXED);
+    mini_atomic_fetch_and(&g_atomic_test.bits, ~(2UL << (id * 2)), MINI_ATOMIC_RELAXED);
+    return NULL;
+}
+
+static void test_atomic(void)
+{
+    printf("\n=== 开始原子操作测试 ===\n");
+
+    pthread_t threads[ATOMIC_TEST_THREADS];
+    int ids[ATOMIC_TEST_THREADS];
+    long total = (long)ATOMIC_TEST_THREADS * ATOMIC_TEST_LOOPS;
+
+    printf("LSE原子指令: %s\n", (getauxval(AT_HWCAP) & HWCAP_ATOMICS) ? "支持" : "不支持，使用LL/SC");
+
+    memset((void *)&g_atomic_test, 0, sizeof(g_atomic_test));
+    for (int i = 0; i < ATOMIC_TEST_THREADS; i++)
+    {
+        ids[i] = i;
+        pthread_create(&threads[i], NULL, atomic_worker, &ids[i]);
+    }
+    for (int i = 0; i < ATOMIC_TEST_THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    mini_uint128_t c128 = mini_atomic_load_128(&g_atomic_test.c128, MINI_ATOMIC_ACQUIRE);
+    printf("8位: %d (期望 %d)\n", (int)g_atomic_test.c8, (int)(total & 0xff));
+    printf("16位: %d (期望 %d)\n", (int)g_atomic_test.c16, (int)(total & 0xffff));
+    printf("32位: %ld (期望 %ld)\n", (long)g_atomic_test.c32, total);
+    printf("64位: %ld (期望 %ld)\n", (long)g_atomic_test.c64, total * 3);
+    printf("CAS: %ld (期望 %ld)\n", (long)g_atomic_test.cas32, total);
+    printf("128位: 低 %ld 高 %ld (期望均为 %ld)\n", (long)(uint64_t)c128, (long)(uint64_t)(c128 >> 64), total);
+    printf("or/and: %x (期望 %x)\n", (unsigned long)g_atomic_test.bits, 0x55UL);
+
+    printf("=== 原子操作测试完成 ===\n\n");
+}
+
+/**
+ * 读写锁测试：读者检查期间没有写者，写者检查独占
+ */
+#define RWLOCK_TEST_THREADS 8
+#define RWLOCK_TEST_LOOPS   20000
+
+static struct
+{
+    pthread_rwlock_t lock;
+    volatile int readers;
+    volatile int writers;
+    volatile int errors;
+    long data[8];
+} g_rwlock_test;
+
+static void* rwlock_worker(void* arg)
+{
+    unsigned int x = (unsigned int)(long)arg * 2654435761U + 1;
+
+    for (int i = 0; i < RWLOCK_TEST_LOOPS; i++)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        if (x % 100 < 95)
+        {
+            pthread_rwlock_rdlock(&g_rwlock_test.lock);
+            mini_atomic_fetch_add(&g_rwlock_test.readers, 1, MINI_ATOMIC_SEQ_CST);
+            if (mini_atomic_load(&g_rwlock_test.writers, MINI_ATOMIC_SEQ_CST) != 0 ||
+                g_rwlock_test.data[0] != g_rwlock_test.data[7])
+            {
+                mini_atomic_fetch_add(&g_rwlock_test.errors, 1, MINI_ATOMIC_RELAXED);
+            }
+            mini_atomic_fetch_sub(&g_rwlock_test.readers, 1, MINI_ATOMIC_SEQ_CST);
+            pthread_rwlock_unlock(&g_rwlock_test.lock);
+        }
+        else
+        {
+            pthread_rwlock_wrlock(&g_rwlock_test.lock);
+            if (mini_atomic_fetch_add(&g_rwlock_test.writers, 1, MINI_ATOMIC_SEQ_CST) != 0 ||
+                mini_atomic_load(&g_rwlock_test.readers, MINI_ATOMIC_SEQ_CST) != 0)
+            {
+                mini_atomic_fetch_add(&g_rwlock_test.errors, 1, MINI_ATOMIC_RELAXED);
+            }
+            for (int k = 0; k < 8; k++)
+            {
+                g_rwlock_test.data[k]++;
+            }
+            if (x % 7 == 0)
+            {
+                sched_yield();  // 拉长持有时间，让读者和其他写者进入futex等待
+            }
+            mini_atomic_fetch_sub(&g_rwlock_test.writers, 1, MINI_ATOMIC_SEQ_CST);
+            pthread_rwlock_unlock(&g_rwlock_test.lock);
+        }
+    }
+    return NULL;
+}
+
+static void test_rwlock(void)
+{
+    printf("\n=== 开始读写锁测试 ===\n");
+
+    pthread_rwlockattr_t attr;
+    pthread_t threads[RWLOCK_TEST_THREADS];
+
+    // 单线程语义
+    pthread_rwlock_init(&g_rwlock_test.lock, NULL);
+    pthread_rwlock_rdlock(&g_rwlock_test.lock);
+    printf("持有读锁时: tryrdlock=%d trywrlock=%d (期望 0 %d)\n",
+           pthread_rwlock_tryrdlock(&g_rwlock_test.lock),
+           pthread_rwlock_trywrlock(&g_rwlock_test.lock), EBUSY);
+    pthread_rwlock_unlock(&g_rwlock_test.lock);
+    pthread_rwlock_unlock(&g_rwlock_test.lock);
+    pthread_rwlock_wrlock(&g_rwlock_test.lock);
+    printf("持有写锁时: tryrdlock=%d wrlock=%d (期望 %d %d)\n",
+           pthread_rwlock_tryrdlock(&g_rwlock_test.lock),
+           pthread_rwlock_wrlock(&g_rwlock_test.lock), EBUSY, EDEADLK);
+    pthread_rwlock_unlock(&g_rwlock_test.lock);
+    printf("全部释放后: state=%x\n", (unsigned long)g_rwlock_test.lock.state);
+
+    // 多线程，两种偏好各一轮
+    for (int pref = PTHREAD_RWLOCK_PREFER_READER_NP; pref <= PTHREAD_RWLOCK_PREFER_WRITER_NP; pref++)
+    {
+        pthread_rwlockattr_init(&attr);
+        pthread_rwlockattr_setkind_np(&attr, pref);
+        pthread_rwlock_init(&g_rwlock_test.lock, &attr);
+        g_rwlock_test.errors = 0;
+
+        for (int i = 0; i < RWLOCK_TEST_THREADS; i++)
+        {
+            pthread_create(&threads[i], NULL, rwlock_worker, (void*)(long)(i + 1));
+        }
+        for (int i = 0; i < RWLOCK_TEST_THREADS; i++)
+        {
+            pthread_join(threads[i], NULL);
+        }
+        printf("%s: 错误 %d, 写入 %ld 次, state=%x\n",
+               pref == PTHREAD_RWLOCK_PREFER_READER_NP ? "读者优先" : "写者优先",
+               g_rwlock_test.errors, g_rwlock_test.data[0], (unsigned long)g_rwlock_test.lock.state);
+        pthread_rwlockattr_destroy(&attr);
+    }
+
+    printf("=== 读写锁测试完成 ===\n\n");
+}
+
+/**
+ * 条件变量测试：有界队列的生产者/消费者、broadcast实现的屏障、超时等待
+ */
+#define COND_TEST_PRODUCERS 4
+#define COND_TEST_CONSUMERS 4
+#define COND_TEST_ITEMS     50000
+#define COND_TEST_QUEUE     16
+#define COND_TEST_BARRIER   8
+#define COND_TEST_ROUNDS    2000
+
+static struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    pthread_cond_t barrier;
+    int queue[COND_TEST_QUEUE];
+    int head;
+    int tail;
+    int count;
+    int consumed;
+    long sum;
+    int arrived;
+    int generation;
+} g_cond_test;
+
+static void* cond_producer(void* arg)
+{
+    for (int i = 0; i < COND_TEST_ITEMS; i++)
+    {
+        pthread_mutex_lock(&g_cond_test.lock);
+        while (g_cond_test.count == COND_TEST_QUEUE)
+        {
+            pthread_cond_wait(&g_cond_test.not_full, &g_cond_test.lock);
+        }
+        g_cond_test.queue[g_cond_test.tail] = i;
+        g_cond_test.tail = (g_cond_test.tail + 1) % COND_TEST_QUEUE;
+        g_cond_test.count++;
+        pthread_cond_signal(&g_cond_test.not_empty);
+        pthread_mutex_unlock(&g_cond_test.lock);
+    }
+    return NULL;
+}
+
+static void* cond_consumer(void* arg)
+{
+    for (;;)
+    {
+        pthread_mutex_lock(&g_cond_test.lock);
+        while (g_cond_test.count == 0 &&
+               g_cond_test.consumed < COND_TEST_PRODUCERS * COND_TEST_ITEMS)
+        {
+            pthread_cond_wait(&g_cond_test.not_empty, &g_cond_test.lock);
+        }
+        if (g_cond_test.count == 0)
+        {
+            pthread_mutex_unlock(&g_cond_test.lock);
+            return NULL;
+        }
+        g_cond_test.sum += g_cond_test.queue[g_cond_test.head];
+        g_cond_test.head = (g_cond_test.head + 1) % COND_TEST_QUEUE;
+        g_cond_test.count--;
+        if (++g_cond_test.consumed == COND_TEST_PRODUCERS * COND_TEST_ITEMS)
+        {
+            // 全部取完，让其余消费者退出
+            pthread_cond_broadcast(&g_cond_test.not_empty);
+        }
+        pthread_cond_signal(&g_cond_test.not_full);
+        pthread_mutex_unlock(&g_cond_test.lock);
+    }
+}
+
+static void* cond_barrier_worker(void* arg)
+{
+    for (int r = 0; r < COND_TEST_ROUNDS; r++)
+    {
+        pthread_mutex_lock(&g_cond_test.lock);
+        int gen = g_cond_test.generation;
+        if (++g_cond_test.arrived == COND_TEST_BARRIER)
+        {
+            g_cond_test.arrived = 0;
+            g_cond_test.generation++;
+            pthread_cond_broadcast(&g_cond_test.barrier);
+        }
+        else
+        {
+            while (g_cond_test.generation == gen)
+            {
+                pthread_cond_wait(&g_cond_test.barrier, &g_cond_test.lock);
+            }
+        }
+        pthread_mutex_unlock(&g_cond_test.lock);
+    }
+    return NULL;
+}
+
+static void test_cond(void)
+{
+    printf("\n=== 开始条件变量测试 ===\n");
+
+    pthread_t threads[COND_TEST_PRODUCERS + COND_TEST_CONSUMERS];
+    struct timespec deadline, now;
+    int ret;
+
+    pthread_mutex_init(&g_cond_test.lock, NULL);
+    pthread_cond_init(&g_cond_test.not_empty, NULL);
+    pthread_cond_init(&g_cond_test.not_full, NULL);
+    pthread_cond_init(&g_cond_test.barrier, NULL);
+
+    // 生产者/消费者
+    for (int i = 0; i < COND_TEST_PRODUCERS; i++)
+    {
+        pthread_create(&threads[i], NULL, cond_producer, NULL);
+    }
+    for (int i = 0; i < COND_TEST_CONSUMERS; i++)
+    {
+        pthread_create(&threads[COND_TEST_PRODUCERS + i], NULL, cond_consumer, NULL);
+    }
+    for (int i = 0; i < COND_TEST_PRODUCERS + COND_TEST_CONSUMERS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    printf("生产者/消费者: 取出 %d 项, 和 %ld (期望 %d, %ld)\n",
+           g_cond_test.consumed, g_cond_test.sum, COND_TEST_PRODUCERS * COND_TEST_ITEMS,
+           (long)COND_TEST_PRODUCERS * COND_TEST_ITEMS * (COND_TEST_ITEMS - 1) / 2);
+
+    // broadcast屏障：每轮最后到达的线程唤醒其余线程
+    for (int i = 0; i < COND_TEST_BARRIER; i++)
+    {
+        pthread_create(&threads[i], NULL, cond_barrier_worker, NULL);
+    }
+    for (int i = 0; i < COND_TEST_BARRIER; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    printf("屏障: 完成 %d 轮 (期望 %d), 互斥锁状态 %d\n",
+           g_cond_test.generation, COND_TEST_ROUNDS, g_cond_test.lock.lock);
+
+    // 超时等待，返回时重新持有互斥锁
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += 50000000;
+    if (deadline.tv_nsec >= 1000000000)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    pthread_mutex_lock(&g_cond_test.lock);
+    ret = pthread_cond_timedwait(&g_cond_test.barrier, &g_cond_test.lock, &deadline);
+    clock_gettime(CLOCK_REALTIME, &now);
+    printf("timedwait: 返回 %d (期望 %d), 持有锁 %d, 超过截止时间 %ld us\n",
+           ret, ETIMEDOUT, g_cond_test.lock.owner == gettid(),
+           ((now.tv_sec - deadline.tv_sec) * 1000000000L + (now.tv_nsec - deadline.tv_nsec)) / 1000);
+    pthread_mutex_unlock(&g_cond_test.lock);
+
+    pthread_cond_destroy(&g_cond_test.barrier);
+    pthread_cond_destroy(&g_cond_test.not_full);
+    pthread_cond_destroy(&g_cond_test.not_empty);
+
+    printf("=== 条件变量测试完成 ===\n\n");
+}
+
+/**
+ * 自旋锁测试：多线程在锁内做非原子的读-改-写，计数不丢失说明互斥成立
+ */
+#define SPIN_TEST_THREADS   8
+#define SPIN_TEST_LOOPS     100000
+
+static struct
+{
+    pthread_spinlock_t spin;
+    struct mcs_lock mcs;
+    volatile long counter;
+} g_spin_test;
+
+static void* spin_worker(void* arg)
+{
+    for (int i = 0; i < SPIN_TEST_LOOPS; i++)
+    {
+        pthread_spin_lock(&g_spin_test.spin);
+        g_spin_test.counter = g_spin_test.counter + 1;
+        pthread_spin_unlock(&g_spin_test.spin);
+    }
+    return NULL;
+}
+
+static void* mcs_worker(void* arg)
+{
+    struct mcs_node node;
+
+    for (int i = 0; i < SPIN_TEST_LOOPS; i++)
+    {
+        mcs_lock_acquire(&g_spin_test.mcs, &node);
+        g_spin_test.counter = g_spin_test.counter + 1;
+        mcs_lock_release(&g_spin_test.mcs, &node);
+    }
+    return NULL;
+}
+
+static void test_spinlock(void)
+{
+    printf("\n=== 开始自旋锁测试 ===\n");
+
+    pthread_t threads[SPIN_TEST_THREADS];
+    struct mcs_node node, other;
+
+    pthread_spin_init(&g_spin_test.spin, PTHREAD_PROCESS_PRIVATE);
+    mcs_lock_init(&g_spin_test.mcs);
+
+    // 单线程语义
+    pthread_spin_lock(&g_spin_test.spin);
+    printf("票号锁持有时: trylock=%d (期望 %d)\n", pthread_spin_trylock(&g_spin_test.spin), EBUSY);
+    pthread_spin_unlock(&g_spin_test.spin);
+    printf("票号锁释放后: trylock=%d (期望 0)\n", pthread_spin_trylock(&g_spin_test.spin));
+    pthread_spin_unlock(&g_spin_test.spin);
+
+    mcs_lock_acquire(&g_spin_test.mcs, &node);
+    printf("MCS锁持有时: tryacquire=%d (期望 %d)\n", mcs_lock_tryacquire(&g_spin_test.mcs, &other), EBUSY);
+    mcs_lock_release(&g_spin_test.mcs, &node);
+    printf("MCS锁释放后: tryacquire=%d (期望 0)\n", mcs_lock_tryacquire(&g_spin_test.mcs, &other));
+    mcs_lock_release(&g_spin_test.mcs, &other);
+
+    // 多线程计数
+    g_spin_test.counter = 0;
+    for (int i = 0; i < SPIN_TEST_THREADS; i++)
+    {
+        pthread_create(&threads[i], NULL, spin_worker, NULL);
+    }
+    for (int i = 0; i < SPIN_TEST_THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    printf("票号锁: 计数 %ld (期望 %ld), ticket=%x\n", g_spin_test.counter,
+           (long)SPIN_TEST_THREADS * SPIN_TEST_LOOPS, (unsigned long)g_spin_test.spin.ticket);
+
+    g_spin_test.counter = 0;
+    for (int i = 0; i < SPIN_TEST_THREADS; i++)
+    {
+        pthread_create(&threads[i], NULL, mcs_worker, NULL);
+    }
+    for (int i = 0; i < SPIN_TEST_THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    printf("MCS锁: 计数 %ld (期望 %ld), 队尾为空 %d\n", g_spin_test.counter,
+           (long)SPIN_TEST_THREADS * SPIN_TEST_LOOPS, g_spin_test.mcs.tail == NULL);
+
+    pthread_spin_destroy(&g_spin_test.spin);
+
+    printf("=== 自旋锁测试完成 ===\n\n");
+}
+
+/**
+ * 线程池测试：parallel_for覆盖每个下标恰好一次，parallel_reduce结果正确，
+ * 嵌套spawn/sync计算斐波那契数
+ */
+#define POOL_TEST_WORKERS   4
+#define POOL_TEST_SIZE      100003
+
+static struct
+{
+    struct thread_pool pool;
+    volatile char hits[POOL_TEST_SIZE];
+} g_pool_test;
+
+struct pool_fib
+{
+    long n;
+    long result;
+};
+
+static void pool_mark(void* arg, long begin, long end)
+{
+    for (long i = begin; i < end; i++)
+    {
+        g_pool_test.hits[i]++;
+    }
+}
+
+static long pool_sum(void* arg, long begin, long end)
+{
+    long sum = 0;
+    for (long i = begin; i < end; i++)
+    {
+        sum += i;
+    }
+    return sum;
+}
+
+static long pool_add(void* arg, long a, long b)
+{
+    return a + b;
+}
+
+static void pool_fib(void* arg)
+{
+    struct pool_fib *f = (struct pool_fib *)arg;
+    struct pool_fib a, b;
+    struct pool_task task;
+
+    if (f->n < 2)
+    {
+        f->result = f->n;
+        return;
+    }
+    a.n = f->n - 1;
+    b.n = f->n - 2;
+    thread_pool_spawn(&g_pool_test.pool, &task, pool_fib, &a);
+    pool_fib(&b);
+    thread_pool_sync(&g_pool_test.pool, &task);
+    f->result = a.result + b.result;
+}
+
+static void test_thread_pool(void)
+{
+    printf("\n=== 开始线程池测试 ===\n");
+
+    struct pool_fib fib;
+    struct pool_task task;
+    struct timespec t0, t1;
+    long sum, ns;
+    int bad = 0;
+
+    if (thread_pool_init(&g_pool_test.pool, POOL_TEST_WORKERS) < 0)
+    {
+        printf("thread_pool_init失败, errno=%d\n", mini_errno);
+        return;
+    }
+
+    parallel_for(&g_pool_test.pool, 0, POOL_TEST_SIZE, 0, pool_mark, NULL);
+    for (long i = 0; i < POOL_TEST_SIZE; i++)
+    {
+        if (g_pool_test.hits[i] != 1)
+        {
+            bad++;
+        }
+    }
+    printf("parallel_for: %d 个下标未恰好执行一次 (期望 0)\n", bad);
+
+    sum = parallel_reduce(&g_pool_test.pool, 0, POOL_TEST_SIZE, 0, 0, pool_sum, pool_add, NULL);
+    printf("parallel_reduce: %ld (期望 %ld)\n", sum, (long)POOL_TEST_SIZE * (POOL_TEST_SIZE - 1) / 2);
+    printf("空区间: %ld (期望 -1)\n",
+           parallel_reduce(&g_pool_test.pool, 5, 5, 0, -1, pool_sum, pool_add, NULL));
+
+    // fib(20)共21891个任务，全部由工作线程互相窃取完成
+    fib.n = 20;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    thread_pool_spawn(&g_pool_test.pool, &task, pool_fib, &fib);
+    thread_pool_sync(&g_pool_test.pool, &task);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    ns = (t1.tv_sec - t0.tv_sec) * 1000000000L + (t1.tv_nsec - t0.tv_nsec);
+    printf("fib(20) = %ld (期望 6765), %ld ns/任务\n", fib.result, ns / 21891);
+
+    thread_pool_destroy(&g_pool_test.pool);
+
+    printf("=== 线程池测试完成 ===\n\n");
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) 
+    {
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    // 根据第一个参数选择测试模式
+    switch (argv[1][1])  // 跳过'-'
+    {
+        case 'f':  // 文件操作测试
+            if (argc < 3) 
+            {
+                printf("Error: Missing filename for file test\n");
+                print_usage(argv[0]);
+                return -1;
+            }
+            test_file(argv[2]);
+            break;
+            
+        case 'm':  // 内存操作测试
+            test_memory();
+            break;
+            
+        case 'p':  // 进程(fork)测试
+            test_fork();
+            break;
+            
+        case 's':  // socket服务器测试
+            test_socket_server();
+            break;
+            
+        case 'c':  // socket客户端测试
+            test_socket_client();
+            break;
+            
+        case 't':  // 线程测试
+            test_thread();
+            break;
+            
+        case 'l':  // 互斥锁测试
+            test_mutex();
+            break;
+            
+        case 'g':  // 日志测试
+            test_log();
+            break;
+            
+        case 'u':  // io_uring测试
+            if (argc < 3) 
+            {
+                printf("Error: Missing filename for io_uring test\n");
+                print_usage(argv[0]);
+                return -1;
+            }
+            test_io_uring(argv[2]);
+            break;
+            
+        case 'e':  // epoll事件循环服务器测试
+            test_event_loop();
+            break;
+            
+        case 'z':  // 零拷贝文件发送测试
+            if (argc < 3) 
+            {
+                printf("Error: Missing filename for sendfile test\n");
+                print_usage(argv[0]);
+                return -1;
+            }
+            test_sendfile(argv[2]);
+            break;
+            
+        case 'x':  // MSG_ZEROCOPY发送测试
+            test_zerocopy();
+            break;
+            
+        case 'r':  // SO_REUSEPORT多线程服务器测试
+            test_reuseport_server(argc > 2 ? parse_int(argv[2]) : 0);
+            break;
+            
+        case 'k':  // AF_UNIX socket测试
+            test_unix_socket();
+            break;
+            
+        case 'v':  // vDSO时间接口测试
+            test_time();
+            break;
+
+        case 'b':  // 缓冲读取器与文件映射测试
+            test_bufio();
+            break;
+
+        case 'o':  // O_DIRECT直接I/O测试
+            if (argc < 3)
+            {
+                printf("Error: Missing filename for direct I/O test\n");
+                print_usage(argv[0]);
+                return -1;
+            }
+            test_direct_io(argv[2]);
+            break;
+
+        case 'w':  // 追加日志测试
+            if (argc < 3)
+            {
+                printf("Error: Missing filename for append log test\n");
+                print_usage(argv[0]);
+                return -1;
+            }
+            test_append_log(argv[2]);
+            break;
+
+        case 'd':  // 线程局部存储测试
+            test_tls();
+            break;
+
+        case 'a':  // 原子操作测试
+            test_atomic();
+            break;
+
+        case 'y':  // 读写锁测试
+            test_rwlock();
+            break;
+
+        case 'n':  // 条件变量测试
+            test_cond();
+            break;
+
+        case 'q':  // 票号自旋锁与MCS队列锁测试
+            test_spinlock();
+            break;
+
+        case 'j':  // 工作窃取线程池测试
+            test_thread_pool();
             break;
             
         default: